@@ -21,60 +21,202 @@
 #ifndef _ZIM_TOOL_PROGRESS_H_
 #define _ZIM_TOOL_PROGRESS_H_
 
+#include <atomic>
 #include <chrono>
+#include <condition_variable>
+#include <cstdint>
 #include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <functional>
+#include <mutex>
+#include <sstream>
+#include <thread>
 
-using TimePoint = std::chrono::system_clock::time_point;
-
-class ProgressBar //Class for implementing a progress bar(used in redundancy, url and MIME checks).
+/* Progress of a long task (used by zimcheck, zimdump and zimwriterfs).
+ *
+ * report() only updates atomic counters, so it can be called by many
+ * workers in a hot loop. The progress is printed by a reporter thread
+ * every `time_interval` seconds, with the rate (items/s and MB/s) and the
+ * estimated remaining time: as a line rewritten on the standard output,
+ * or as JSON lines on the standard error (to be read by another program).
+ * The callback, if any, is called by the same thread at the same interval.
+ */
+class ProgressBar
 {
+public:
+    enum class Format { TEXT, JSON };
+
 private:
+    typedef std::chrono::steady_clock Clock;
+
     double time_interval; // The time interval a report will be printed.
-    TimePoint last_report_time; // Last time a report has been printed.
-    int max_no;     //Maximum no of times report() will be called.
-    int counter;    //Number of times report() has been called(at a particular time).
-    bool report_progress; //Boolean value to store wether report should display any characters.
+    std::atomic<uint64_t> max_no;  // Number of items to process, 0 if unknown.
+    std::atomic<uint64_t> counter; // Items processed.
+    std::atomic<uint64_t> bytes;   // Bytes processed.
+    bool report_progress; // Whether the reporter thread prints the progress.
+    Format format;
+    std::function<void(uint64_t, uint64_t)> callback; //Called with the counter and the maximum by the reporter thread.
+    uint64_t callback_done; // The last counter given to the callback.
+
+    Clock::time_point start_time;
+    std::thread reporter;
+    std::mutex mutex;
+    std::condition_variable wakeup;
+    bool stopping;
+
+    // Whether the reporter thread is run.
+    bool isReporting() const {
+        return report_progress || callback;
+    }
+
+    bool isDone() const {
+        const uint64_t max = max_no;
+        return max && counter >= max;
+    }
+
+    void print(bool last, uint64_t max, uint64_t done)
+    {
+        const uint64_t done_bytes = bytes;
+        const std::chrono::duration<double> elapsed = Clock::now() - start_time;
+        const double seconds = std::max(elapsed.count(), 1e-3);
+        const double rate = done / seconds;
+        const double byte_rate = done_bytes / seconds;
+        const bool known_eta = max && rate > 0;
+        const double eta = known_eta ? (max - done) / rate : 0;
+
+        std::ostringstream line;
+        if (format == Format::JSON) {
+            line << "{\"type\":\"progress\",\"done\":" << done;
+            if (max)
+                line << ",\"total\":" << max;
+            line << ",\"seconds\":" << seconds << ",\"items_per_second\":" << rate
+                 << ",\"bytes_per_second\":" << byte_rate;
+            if (known_eta)
+                line << ",\"eta_seconds\":" << eta;
+            line << "}\n";
+            std::cerr << line.str() << std::flush;
+            return;
+        }
+        line << "\r" << done;
+        if (max)
+            line << "/" << max;
+        line << std::fixed << std::setprecision(0) << " (" << rate << " items/s";
+        if (done_bytes)
+            line << ", " << std::setprecision(1) << byte_rate / (1024 * 1024) << " MB/s";
+        if (known_eta && !last) {
+            const uint64_t s = uint64_t(eta);
+            line << ", ETA " << s / 3600 << ":" << std::setfill('0') << std::setw(2) << s / 60 % 60
+                 << ":" << std::setw(2) << s % 60;
+        }
+        line << ")   ";
+        if (last)
+            line << "\n";
+        std::cout << line.str() << std::flush;
+    }
+
+    // Report at each interval, and a last time once the task is done or
+    // finish() is called (even if it happens before the first wait). The
+    // progress is printed and the callback called without holding `mutex`,
+    // so that report() never waits for them.
+    void run()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        bool last = false;
+        while (!last) {
+            wakeup.wait_for(lock, std::chrono::duration<double>(time_interval),
+                            [this]() { return stopping || isDone(); });
+            last = stopping || isDone();
+            const uint64_t max = max_no;
+            const uint64_t done = max ? std::min<uint64_t>(counter, max) : uint64_t(counter);
+            lock.unlock();
+            if (report_progress)
+                print(last, max, done);
+            if (callback && done > callback_done) {
+                callback_done = done;
+                callback(done, max);
+            }
+            lock.lock();
+        }
+    }
 
 public:
     ProgressBar(double time_interval)
       : time_interval(time_interval),
         max_no(0),
         counter(0),
-        report_progress(false)
+        bytes(0),
+        report_progress(false),
+        format(Format::TEXT),
+        callback_done(0),
+        stopping(false)
     { }
 
-    void reset(int max_n)
+    ~ProgressBar()
+    {
+        finish();
+    }
+
+    ProgressBar(const ProgressBar&) = delete;
+    ProgressBar& operator=(const ProgressBar&) = delete;
+
+    // Start a task of `max_n` items (0 if unknown). Not thread safe.
+    void reset(uint64_t max_n)
     {
+        finish();
         max_no = max_n;
-        counter=0;
-        last_report_time=TimePoint();
-        time_interval=1;
+        counter = 0;
+        bytes = 0;
+        callback_done = 0;
+        start_time = Clock::now();
+        if (isReporting()) {
+            stopping = false;
+            reporter = std::thread(&ProgressBar::run, this);
+        }
     }
 
-    void report()
+    // `increment` more items (of `size` bytes) were processed. Thread safe
+    // and lock-free (but for waking the reporter thread up on the last item).
+    void report(uint64_t increment=1, uint64_t size=0)
     {
-        if(counter >= max_no)
+        const uint64_t max = max_no;
+        const uint64_t previous = counter.fetch_add(increment);
+        if (max && previous >= max)
             return;
+        bytes += size;
 
-        counter++;
+        if (isReporting() && max && previous + increment >= max) {
+            std::lock_guard<std::mutex> lock(mutex);
+            wakeup.notify_all();
+        }
+    }
 
-        if(!report_progress)
+    // Stop the reporter thread, once the last progress is printed. Called
+    // when the task is done (needed if its size is unknown or if it is
+    // stopped before the end).
+    void finish()
+    {
+        if (!reporter.joinable())
             return;
-
-        auto now = std::chrono::system_clock::now();
-        std::chrono::duration<double> duration = now-last_report_time;
-        if (duration.count() > time_interval) {
-            std::cout << "\r" << counter << "/" << max_no << std::flush;
-            last_report_time = now;
-        }
-        if(counter == max_no)
         {
-            std::cout << "\r" << counter << "/" << max_no << std::endl;
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+            wakeup.notify_all();
         }
+        reporter.join();
     }
 
-    void set_progress_report(bool report=true) {
+    void set_progress_report(bool report=true, Format report_format=Format::TEXT) {
         report_progress = report;
+        format = report_format;
+    }
+
+    // Call `report_callback` with the counter and the maximum every
+    // `time_interval` seconds (if the counter changed), and with the last
+    // counter when the task is done. Called by the reporter thread, with an
+    // increasing counter. Not thread safe.
+    void set_callback(std::function<void(uint64_t, uint64_t)> report_callback) {
+        callback = report_callback;
     }
 };
 
@@ -34,6 +34,11 @@
 #include <algorithm>
 #include <regex>
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define LINK_SCANNER_X86
+#endif
+
 #ifdef _WIN32
 #define SEPARATOR "\\"
 #else
@@ -215,49 +220,222 @@ void stripTitleInvalidChars(std::string& str)
   replaceStringInPlace(str, "\u202C", "");
 }
 
-std::vector<html_link> generic_getLinks(const std::string& page)
+namespace
 {
-    const char* p = page.c_str();
-    const char* linkStart;
-    std::vector<html_link> links;
-    std::string attr;
-
-    while (*p) {
-        if (strncmp(p, " href", 5) == 0) {
-            attr = "href";
-            p += 5;
-        } else if (strncmp(p, " src", 4) == 0) {
-            attr = "src";
-            p += 4;
-        } else {
-            p += 1;
-            continue;
-        }
 
-        while (*p == ' ')
-            p += 1 ;
-        if (*(p++) != '=')
-            continue;
-        while (*p == ' ')
-            p += 1;
-        char delimiter = *p++;
-        if (delimiter != '\'' && delimiter != '"')
-            continue;
+bool isHtmlSpace(char c)
+{
+  return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\f';
+}
 
-        linkStart = p;
-        // [TODO] Handle escape char
-        while(*p != delimiter)
-            p++;
-        const std::string link(linkStart, p);
-        links.push_back(html_link(attr, link));
-        p += 1;
+/* A '=' at `eq` is a candidate link: check that it follows a " href" or
+ * " src" attribute (the attribute starting at or after `begin`) and is
+ * followed by a quoted value. If so, add the link and return the position
+ * after its closing quote, else return nullptr.
+ */
+const char* parseLink(const char* page, const char* begin, const char* eq, const char* end,
+                      std::vector<LinkSpan>& links)
+{
+  const char* p = eq;
+  while (p > begin && isHtmlSpace(p[-1]))
+    p--;
+  bool isSrc;
+  if (p - begin >= 5 && memcmp(p - 4, "href", 4) == 0 && isHtmlSpace(p[-5])) {
+    isSrc = false;
+  } else if (p - begin >= 4 && memcmp(p - 3, "src", 3) == 0 && isHtmlSpace(p[-4])) {
+    isSrc = true;
+  } else {
+    return nullptr;
+  }
+
+  p = eq + 1;
+  while (p < end && isHtmlSpace(*p))
+    p++;
+  if (p == end || (*p != '"' && *p != '\''))
+    return nullptr;
+  const char* linkStart = p + 1;
+  // [TODO] Handle escape char
+  const char* linkEnd = static_cast<const char*>(memchr(linkStart, *p, end - linkStart));
+  if (!linkEnd)
+    return nullptr;
+  links.push_back(LinkSpan{isSrc, size_t(linkStart - page), size_t(linkEnd - linkStart)});
+  return linkEnd + 1;
+}
+
+// The scanners look for the '=' of the attributes and parse the links from
+// there: '=' is much rarer in html than the first letters of the attributes.
+// They differ by how many bytes they compare at once.
+
+// Scan [p, end), the last link found ending at `begin`.
+void scanLinksFrom(const char* page, const char* begin, const char* p, const char* end,
+                   std::vector<LinkSpan>& links)
+{
+  while (p < end && (p = static_cast<const char*>(memchr(p, '=', end - p)))) {
+    const char* next = parseLink(page, begin, p, end, links);
+    if (next) {
+      begin = p = next;
+    } else {
+      p++;
+    }
+  }
+}
+
+#ifdef LINK_SCANNER_X86
+// Parse the candidates of `mask` (a bit per byte from `block`, the bytes
+// being '='). Return the position to scan from.
+inline const char* parseCandidates(const char* page, const char*& begin, const char* block,
+                                   uint32_t mask, const char* end, std::vector<LinkSpan>& links)
+{
+  while (mask) {
+    const char* eq = block + __builtin_ctz(mask);
+    mask &= mask - 1;
+    const char* next = parseLink(page, begin, eq, end, links);
+    if (next) {
+      // Resume after the link (which may end in a next block).
+      begin = next;
+      return next;
+    }
+  }
+  return nullptr;
+}
+#endif
+
+} // unnamed namespace
+
+namespace detail
+{
+
+void scanLinksScalar(const char* page, size_t size, std::vector<LinkSpan>& links)
+{
+  scanLinksFrom(page, page, page, page + size, links);
+}
+
+#ifdef LINK_SCANNER_X86
+__attribute__((target("sse2")))
+void scanLinksSse2(const char* page, size_t size, std::vector<LinkSpan>& links)
+{
+  const char* const end = page + size;
+  const char* begin = page;
+  const char* p = page;
+  const __m128i equals = _mm_set1_epi8('=');
+  while (end - p >= 16) {
+    const __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+    const uint32_t mask = _mm_movemask_epi8(_mm_cmpeq_epi8(block, equals));
+    const char* next = parseCandidates(page, begin, p, mask, end, links);
+    p = next ? next : p + 16;
+  }
+  scanLinksFrom(page, begin, p, end, links);
+}
+
+__attribute__((target("avx2")))
+void scanLinksAvx2(const char* page, size_t size, std::vector<LinkSpan>& links)
+{
+  const char* const end = page + size;
+  const char* begin = page;
+  const char* p = page;
+  const __m256i equals = _mm256_set1_epi8('=');
+  while (end - p >= 32) {
+    const __m256i block = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+    const uint32_t mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(block, equals));
+    const char* next = parseCandidates(page, begin, p, mask, end, links);
+    p = next ? next : p + 32;
+  }
+  scanLinksFrom(page, begin, p, end, links);
+}
+
+bool linkScannerSupportsSse2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse2");
+}
+
+bool linkScannerSupportsAvx2()
+{
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("avx2");
+}
+#else
+// Not built for this architecture: never selected.
+void scanLinksSse2(const char* page, size_t size, std::vector<LinkSpan>& links)
+{
+  scanLinksScalar(page, size, links);
+}
+
+void scanLinksAvx2(const char* page, size_t size, std::vector<LinkSpan>& links)
+{
+  scanLinksScalar(page, size, links);
+}
+
+bool linkScannerSupportsSse2() { return false; }
+bool linkScannerSupportsAvx2() { return false; }
+#endif
+
+} // namespace detail
+
+namespace
+{
+
+detail::LinkScanner selectLinkScanner()
+{
+  if (detail::linkScannerSupportsAvx2())
+    return detail::scanLinksAvx2;
+  if (detail::linkScannerSupportsSse2())
+    return detail::scanLinksSse2;
+  return detail::scanLinksScalar;
+}
+
+} // unnamed namespace
+
+void getLinkSpans(const char* page, size_t size, std::vector<LinkSpan>& links)
+{
+  static const detail::LinkScanner scanLinks = selectLinkScanner();
+  scanLinks(page, size, links);
+}
+
+std::vector<html_link> generic_getLinks(const std::string& page)
+{
+    static const std::string href("href");
+    static const std::string src("src");
+    std::vector<LinkSpan> spans;
+    getLinkSpans(page.data(), page.size(), spans);
+    std::vector<html_link> links;
+    links.reserve(spans.size());
+    for (const auto& span : spans) {
+        links.push_back(html_link(span.isSrc ? src : href, page.substr(span.offset, span.size)));
     }
     return links;
 }
 
+void getLinkTable(const std::string& page, LinkTable& table, std::vector<LinkSpan>& spans)
+{
+    spans.clear();
+    getLinkSpans(page.data(), page.size(), spans);
+    size_t textSize = 0;
+    for (const auto& span : spans) {
+        textSize += span.size;
+    }
+    table.clear();
+    table.reserve(spans.size(), textSize);
+    for (const auto& span : spans) {
+        table.add(span.isSrc ? LinkAttribute::SRC : LinkAttribute::HREF,
+                  page.data() + span.offset, span.size);
+    }
+}
+
+void getLinkTable(const std::string& page, LinkTable& table)
+{
+    std::vector<LinkSpan> spans;
+    getLinkTable(page, table, spans);
+}
+
 bool isOutofBounds(const std::string& input, std::string base)
 {
-    if (input.empty()) return false;
+    return isOutofBounds(input.data(), input.size(), std::move(base));
+}
+
+bool isOutofBounds(const char* input, size_t size, std::string base)
+{
+    if (size == 0) return false;
 
     if (!base.length() || base.back() != '/')
         base.push_back('/');
@@ -268,10 +446,13 @@ bool isOutofBounds(const std::string& input, std::string base)
 
     //count nr of substrings ../
     int nrsteps = 0;
-    std::string::size_type pos = 0;
-    while((pos = input.find("../", pos)) != std::string::npos) {
-        nrsteps++;
-        pos += 3;
+    for (size_t pos = 0; pos + 3 <= size; ) {
+        if (memcmp(input + pos, "../", 3) == 0) {
+            nrsteps++;
+            pos += 3;
+        } else {
+            pos++;
+        }
     }
 
     return nrsteps >= (nr + std::count(base.cbegin(), base.cend(), '/'));
@@ -290,15 +471,123 @@ int adler32(const std::string& buf)
     return (s2 << 16) | s1;
 }
 
+namespace
+{
+
+inline uint64_t rotl64(uint64_t x, int r)
+{
+    return (x << r) | (x >> (64 - r));
+}
+
+inline uint64_t fmix64(uint64_t k)
+{
+    k ^= k >> 33;
+    k *= 0xff51afd7ed558ccdULL;
+    k ^= k >> 33;
+    k *= 0xc4ceb9fe1a85ec53ULL;
+    k ^= k >> 33;
+    return k;
+}
+
+inline uint64_t getblock64(const unsigned char* p)
+{
+    uint64_t k;
+    memcpy(&k, p, sizeof(k));
+    return k;
+}
+
+} // unnamed namespace
+
+// MurmurHash3_x64_128 by Austin Appleby (public domain).
+// Blocks are read in host order, the hash is the reference one on little endian hosts.
+Hash128 hash128(const char* buf, size_t size, uint64_t seed)
+{
+    const unsigned char* data = reinterpret_cast<const unsigned char*>(buf);
+    const size_t nblocks = size / 16;
+    const uint64_t c1 = 0x87c37b91114253d5ULL;
+    const uint64_t c2 = 0x4cf5ad432745937fULL;
+
+    uint64_t h1 = seed;
+    uint64_t h2 = seed;
+
+    for (size_t i = 0; i < nblocks; i++) {
+        uint64_t k1 = getblock64(data + i*16);
+        uint64_t k2 = getblock64(data + i*16 + 8);
+
+        k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+        h1 = rotl64(h1, 27); h1 += h2; h1 = h1*5 + 0x52dce729;
+
+        k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+        h2 = rotl64(h2, 31); h2 += h1; h2 = h2*5 + 0x38495ab5;
+    }
+
+    const unsigned char* tail = data + nblocks*16;
+    uint64_t k1 = 0;
+    uint64_t k2 = 0;
+    switch (size & 15) {
+      case 15: k2 ^= uint64_t(tail[14]) << 48; // fall through
+      case 14: k2 ^= uint64_t(tail[13]) << 40; // fall through
+      case 13: k2 ^= uint64_t(tail[12]) << 32; // fall through
+      case 12: k2 ^= uint64_t(tail[11]) << 24; // fall through
+      case 11: k2 ^= uint64_t(tail[10]) << 16; // fall through
+      case 10: k2 ^= uint64_t(tail[ 9]) << 8;  // fall through
+      case  9: k2 ^= uint64_t(tail[ 8]);
+               k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+               // fall through
+      case  8: k1 ^= uint64_t(tail[ 7]) << 56; // fall through
+      case  7: k1 ^= uint64_t(tail[ 6]) << 48; // fall through
+      case  6: k1 ^= uint64_t(tail[ 5]) << 40; // fall through
+      case  5: k1 ^= uint64_t(tail[ 4]) << 32; // fall through
+      case  4: k1 ^= uint64_t(tail[ 3]) << 24; // fall through
+      case  3: k1 ^= uint64_t(tail[ 2]) << 16; // fall through
+      case  2: k1 ^= uint64_t(tail[ 1]) << 8;  // fall through
+      case  1: k1 ^= uint64_t(tail[ 0]);
+               k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+    }
+
+    h1 ^= size;
+    h2 ^= size;
+
+    h1 += h2;
+    h2 += h1;
+
+    h1 = fmix64(h1);
+    h2 = fmix64(h2);
+
+    h1 += h2;
+    h2 += h1;
+
+    return Hash128{h1, h2};
+}
+
 std::string normalize_link(const std::string& input, const std::string& baseUrl)
+{
+    return normalize_link(input.c_str(), strlen(input.c_str()), baseUrl);
+}
+
+namespace
+{
+
+int hexValue(char c)
+{
+    if ('0' <= c && c <= '9') return c - '0';
+    if ('a' <= c && c <= 'f') return c - 'a' + 10;
+    if ('A' <= c && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // unnamed namespace
+
+std::string normalize_link(const char* input, size_t size, const std::string& baseUrl)
 {
     std::string output;
-    output.reserve(baseUrl.size() + input.size() + 1);
+    output.reserve(baseUrl.size() + size + 1);
 
     bool in_query = false;
     bool check_rel = false;
-    const char* p = input.c_str();
-    if ( *(p) == '/') {
+    const char* p = input;
+    const char* const end = input + size;
+    if ( p != end && *(p) == '/') {
       // This is an absolute url.
       p++;
     } else {
@@ -310,10 +599,10 @@ std::string normalize_link(const std::string& input, const std::string& baseUrl)
     }
 
     //URL Decoding.
-    while (*p)
+    while (p != end)
     {
         if ( !in_query && check_rel ) {
-            if (strncmp(p, "../", 3) == 0) {
+            if (end - p >= 3 && strncmp(p, "../", 3) == 0) {
                 // We must go "up"
                 // Remove the '/' at the end of output.
                 output.resize(output.size()-1);
@@ -325,7 +614,7 @@ std::string normalize_link(const std::string& input, const std::string& baseUrl)
                 check_rel = false;
                 continue;
             }
-            if (strncmp(p, "./", 2) == 0) {
+            if (end - p >= 2 && strncmp(p, "./", 2) == 0) {
                 // We must simply skip this part
                 // Simply move after the ".".
                 p += 2;
@@ -338,10 +627,13 @@ std::string normalize_link(const std::string& input, const std::string& baseUrl)
             break;
         if ( *p == '%')
         {
-            char ch;
-            sscanf(p+1, "%2hhx", &ch);
-            output += ch;
-            p += 3;
+            // Up to two hex digits.
+            int ch = 0;
+            p++;
+            for (int i = 0; i < 2 && p != end && hexValue(*p) >= 0; i++) {
+                ch = ch * 16 + hexValue(*(p++));
+            }
+            output += char(ch);
             continue;
         }
         if ( *p == '?' ) {
@@ -364,45 +656,80 @@ std::string normalize_link(const std::string& input, const std::string& baseUrl)
 namespace
 {
 
-UriKind specialUriSchemeKind(const std::string& s)
+constexpr char asciiToLower(char c)
 {
-    static const std::map<std::string, UriKind> uriSchemes = {
-        { "javascript", UriKind::JAVASCRIPT },
-        { "mailto",     UriKind::MAILTO     },
-        { "tel",        UriKind::TEL        },
-        { "geo",        UriKind::GEO        },
-        { "data",       UriKind::DATA       },
-        { "xmpp",       UriKind::XMPP       },
-        { "news",       UriKind::NEWS       },
-        { "urn",        UriKind::URN        }
-    };
+    return ('A' <= c && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
 
-    const auto it = uriSchemes.find(s);
-    return it != uriSchemes.end() ? it->second : UriKind::OTHER;
+// Whether the `size` chars at `s` are `scheme` (in lower case), ignoring the case.
+constexpr bool isScheme(const char* s, size_t size, const char* scheme)
+{
+    return size == 0
+        ? *scheme == '\0'
+        : *scheme != '\0' && asciiToLower(*s) == *scheme && isScheme(s + 1, size - 1, scheme + 1);
 }
 
-void asciitolower(std::string& s)
+constexpr UriKind specialUriSchemeKind(const char* s, size_t size)
 {
-    std::transform(s.begin(), s.end(), s.begin(), [](unsigned char c){
-        return ('A' <= c && c <= 'Z') ? c - ('Z' - 'z') : c;
-    });
+    return isScheme(s, size, "javascript") ? UriKind::JAVASCRIPT
+         : isScheme(s, size, "mailto")     ? UriKind::MAILTO
+         : isScheme(s, size, "tel")        ? UriKind::TEL
+         : isScheme(s, size, "geo")        ? UriKind::GEO
+         : isScheme(s, size, "data")       ? UriKind::DATA
+         : isScheme(s, size, "xmpp")       ? UriKind::XMPP
+         : isScheme(s, size, "news")       ? UriKind::NEWS
+         : isScheme(s, size, "urn")        ? UriKind::URN
+         : UriKind::OTHER;
 }
 
+static_assert(specialUriSchemeKind("MailTo", 6) == UriKind::MAILTO, "");
+static_assert(specialUriSchemeKind("telnet", 6) == UriKind::OTHER, "");
+static_assert(specialUriSchemeKind("te", 2) == UriKind::OTHER, "");
+
 } // unnamed namespace
 
 UriKind html_link::detectUriKind(const std::string& input_string)
 {
-    const auto k = input_string.find_first_of(":/?#");
-    if ( k == std::string::npos || input_string[k] != ':' )
+    return detectUriKind(input_string.data(), input_string.size());
+}
+
+UriKind html_link::detectUriKind(const char* link, size_t size)
+{
+    size_t k = 0;
+    while ( k < size && link[k] != ':' && link[k] != '/' && link[k] != '?' && link[k] != '#' )
+        k++;
+    if ( k == size || link[k] != ':' )
         return UriKind::OTHER;
 
-    if ( k + 2 < input_string.size()
-         && input_string[k+1] == '/'
-         && input_string[k+2] == '/' )
+    if ( k + 2 < size
+         && link[k+1] == '/'
+         && link[k+2] == '/' )
         return UriKind::GENERIC_URI;
 
-    std::string scheme = input_string.substr(0, k);
-    asciitolower(scheme);
-    return specialUriSchemeKind(scheme);
+    return specialUriSchemeKind(link, k);
+}
+
+void LinkTable::reserve(size_t linkCount, size_t textSize)
+{
+    links.reserve(linkCount);
+    text.reserve(textSize);
+}
+
+void LinkTable::clear()
+{
+    links.clear();
+    text.clear();
+}
+
+void LinkTable::add(LinkAttribute attribute, const char* link, size_t size)
+{
+    links.push_back(Link{uint32_t(text.size()), uint32_t(size),
+                         html_link::detectUriKind(link, size), attribute});
+    text.append(link, size);
+}
+
+const char* LinkTable::attributeName(LinkAttribute attribute)
+{
+    return attribute == LinkAttribute::SRC ? "src" : "href";
 }
 
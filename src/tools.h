@@ -26,6 +26,7 @@
 #include <vector>
 #include <stdexcept>
 #include <sstream>
+#include <cstdint>
 
 #include <zim/writer/contentProvider.h>
 #include <zim/writer/item.h>
@@ -100,6 +101,8 @@ public:
     }
 
     static UriKind detectUriKind(const std::string& input_string);
+    // Same, without copying the link.
+    static UriKind detectUriKind(const char* link, size_t size);
 };
 
 // Few helper class to help copy a item from a archive to another one.
@@ -177,18 +180,121 @@ void replaceStringInPlace(std::string& subject,
                           const std::string& replace);
 void stripTitleInvalidChars(std::string& str);
 
+// A link found in a html page: the value of a href or src attribute.
+struct LinkSpan
+{
+    bool isSrc;     // A src attribute, else a href one.
+    size_t offset;  // Of the link in the page.
+    size_t size;
+};
+
+// Append the links of the html `page` to `links`, without copying them.
+// The page is scanned with SSE2/AVX2 instructions if the cpu has them.
+void getLinkSpans(const char* page, size_t size, std::vector<LinkSpan>& links);
+
+// The scanners of getLinkSpans, exposed for the tests. They all find the same
+// links; the SSE2/AVX2 ones may only be called if the matching
+// linkScannerSupports function returns true.
+namespace detail
+{
+typedef void (*LinkScanner)(const char* page, size_t size, std::vector<LinkSpan>& links);
+
+void scanLinksScalar(const char* page, size_t size, std::vector<LinkSpan>& links);
+void scanLinksSse2(const char* page, size_t size, std::vector<LinkSpan>& links);
+void scanLinksAvx2(const char* page, size_t size, std::vector<LinkSpan>& links);
+
+bool linkScannerSupportsSse2();
+bool linkScannerSupportsAvx2();
+} // namespace detail
+
 //Returns a vector of the links in a particular page. includes links under 'href' and 'src'
 std::vector<html_link> generic_getLinks(const std::string& page);
 
+enum class LinkAttribute : uint8_t
+{
+    HREF,
+    SRC
+};
+
+/* The links of a html page, classified once when they are added.
+ * Their texts are stored one after the other in a single buffer and each
+ * link is a small record pointing into it, so a page costs two allocations
+ * whatever its number of links.
+ */
+class LinkTable
+{
+public:
+    struct Link
+    {
+        uint32_t offset; // Of the text of the link in the table.
+        uint32_t size;
+        UriKind kind;
+        LinkAttribute attribute;
+
+        bool isExternalUrl() const
+        {
+            return kind != UriKind::OTHER && kind != UriKind::DATA;
+        }
+
+        bool isInternalUrl() const
+        {
+            return kind == UriKind::OTHER;
+        }
+    };
+
+    void reserve(size_t linkCount, size_t textSize);
+    // Remove the links, keeping the memory for the next page.
+    void clear();
+    void add(LinkAttribute attribute, const char* link, size_t size);
+
+    size_t size() const { return links.size(); }
+    bool empty() const { return links.empty(); }
+    const Link& operator[](size_t i) const { return links[i]; }
+    std::vector<Link>::const_iterator begin() const { return links.begin(); }
+    std::vector<Link>::const_iterator end() const { return links.end(); }
+
+    const char* data(const Link& link) const { return text.data() + link.offset; }
+    std::string str(const Link& link) const { return text.substr(link.offset, link.size); }
+
+    static const char* attributeName(LinkAttribute attribute);
+
+private:
+    std::string text;
+    std::vector<Link> links;
+};
+
+// Set `table` to the links of the html `page`.
+// `spans` is a buffer reused from one page to the other (its content is lost).
+void getLinkTable(const std::string& page, LinkTable& table, std::vector<LinkSpan>& spans);
+void getLinkTable(const std::string& page, LinkTable& table);
+
 // checks if a relative path is out of bounds (relative to base)
 bool isOutofBounds(const std::string& input, std::string base);
+bool isOutofBounds(const char* input, size_t size, std::string base);
 
-//Adler32 Hash Function. Used to hash the BLOB data obtained from each article, for redundancy checks.
-//Please note that the adler32 hash function has a high number of collisions, and that the hash match is not taken as final.
+//Adler32 Hash Function.
+//Please note that the adler32 hash function has a high number of collisions, use hash128 to compare contents.
 int adler32(const std::string& buf);
 
+struct Hash128
+{
+    uint64_t low;
+    uint64_t high;
+
+    bool operator==(const Hash128& other) const {
+        return low == other.low && high == other.high;
+    }
+    bool operator!=(const Hash128& other) const {
+        return !(*this == other);
+    }
+};
+
+//128 bits non-cryptographic hash function (MurmurHash3). Used to detect redundant content in a single pass.
+Hash128 hash128(const char* data, size_t size, uint64_t seed = 0);
+
 //Removes extra spaces from URLs. Usually done by the browser, so web authors sometimes tend to ignore it.
 //Converts the %20 to space.Essential for comparing URLs.
 std::string normalize_link(const std::string& input, const std::string& baseUrl);
+std::string normalize_link(const char* input, size_t size, const std::string& baseUrl);
 
 #endif  // OPENZIM_TOOLS_H
@@ -0,0 +1,249 @@
+#include "checker.h"
+#include "clustercache.h"
+#include "checkpoint.h"
+#include "threadpool.h"
+#include "sampling.h"
+#include "timings.h"
+
+#include <algorithm>
+#include <exception>
+#include <iostream>
+
+#include <zim/archive.h>
+
+namespace
+{
+
+// The checks run on the opened archive (all but the integrity one).
+void check_archive(const zim::Archive& archive, const CheckOptions& options,
+                   ErrorLogger& error, ProgressBar& progress, ThreadPool* pool,
+                   Timings* timings)
+{
+    //Test 1: Internal Checksum
+    if(options.checksum) {
+        if ( options.integrity ) {
+            error.info() << "[INFO] Avoiding redundant checksum test"
+                      << " (already performed by the integrity check)."
+                      << std::endl;
+        } else {
+            PhaseTimer timer(timings, Phase::CHECKSUM, archive.getFilesize());
+            test_checksum(archive, error);
+        }
+    }
+    if(error.isCancelled())
+        return;
+
+    //Test 2: Metadata Entries:
+    //The file is searched for the compulsory metadata entries.
+    if(options.metadata) {
+        PhaseTimer timer(timings, Phase::METADATA);
+        test_metadata(archive, error);
+    }
+    if(error.isCancelled())
+        return;
+
+    //Test 3: Test for Favicon.
+    if(options.favicon) {
+        PhaseTimer timer(timings, Phase::FAVICON);
+        test_favicon(archive, error);
+    }
+    if(error.isCancelled())
+        return;
+
+
+    //Test 4: Main Page Entry
+    if(options.main_page) {
+        PhaseTimer timer(timings, Phase::MAIN_PAGE);
+        test_mainpage(archive, error);
+    }
+    if(error.isCancelled())
+        return;
+
+    //Test 5: Redirections
+    if(options.redirect_check) {
+        PhaseTimer timer(timings, Phase::REDIRECTS, 0, archive.getEntryCount());
+        test_redirects(archive, error, options.max_redirect_chain);
+    }
+    if(error.isCancelled())
+        return;
+
+    //Test 6: Title index
+    if(options.title_index_check) {
+        PhaseTimer timer(timings, Phase::TITLE_INDEX, 0, archive.getEntryCount());
+        test_title_index(archive, error, options.thread_count, pool);
+    }
+    if(error.isCancelled())
+        return;
+
+    /* Now we want to avoid to loop on the tests but on the article.
+     *
+     * If we loop of the tests we will have :
+     *
+     * for (test: tests) {
+     *     for(article: articles) {
+     *          data = article->getData();
+     *          ...
+     *     }
+     * }
+     *
+     * And so we will get several the data of an article (and so decompression and so).
+     * By looping on the articles first, we have :
+     *
+     * for (article: articles) {
+     *     data = article->getData() {
+     *     for (test: tests) {
+     *         ...
+     *     }
+     * }
+     */
+
+    if ( options.redundant_data || options.url_check || options.url_check_external || options.empty_check
+      || options.mime_check || options.unreachable_check || options.near_duplicates
+      || options.cluster_stats ) {
+      std::unique_ptr<ClusterCache> cluster_cache;
+      if (!options.cache_filename.empty())
+        cluster_cache.reset(new ClusterCache(options.cache_filename));
+      std::unique_ptr<Checkpoint> checkpoint;
+      if (!options.checkpoint_filename.empty())
+        checkpoint.reset(new Checkpoint(options.checkpoint_filename, options.resume, options.checkpoint_overhead));
+      const Sampling sampling{options.sample_percent, options.seed};
+      ArticleCheckOptions article_options;
+      article_options.redundant_data = options.redundant_data;
+      article_options.url_check = options.url_check;
+      article_options.url_check_external = options.url_check_external;
+      article_options.empty_check = options.empty_check;
+      article_options.mime_check = options.mime_check;
+      article_options.unreachable_check = options.unreachable_check;
+      article_options.near_duplicates = options.near_duplicates;
+      article_options.cluster_stats = options.cluster_stats;
+      article_options.thread_count = options.thread_count;
+      article_options.max_memory = options.max_memory;
+      test_articles(archive, error, progress, article_options,
+                    cluster_cache.get(), checkpoint.get(), pool,
+                    options.sample_percent > 0 ? &sampling : nullptr, timings);
+      if (cluster_cache)
+        cluster_cache->commit();
+    }
+}
+
+// Give the findings of the main ErrorLogger to a callback.
+class CallbackSink : public ReportSink
+{
+  public:
+    explicit CallbackSink(const ZimChecker::FindingCallback& callback)
+      : callback(callback)
+    {}
+
+    void addFinding(TestType type, const std::string& message) override {
+        callback(type, message);
+    }
+    void finish(const ErrorLogger&) override {}
+
+  private:
+    const ZimChecker::FindingCallback& callback;
+};
+
+} // unnamed namespace
+
+void CheckOptions::selectAll()
+{
+    checksum = integrity = metadata = favicon = main_page = redundant_data =
+      url_check = url_check_external = mime_check = empty_check =
+      redirect_check = title_index_check = true;
+}
+
+void run_checks(const std::string& filename, const CheckOptions& options,
+                ErrorLogger& error, ProgressBar& progress, ThreadPool* pool,
+                Timings* timings)
+{
+    error.setOutput(options.output);
+    if (options.max_memory)
+        error.setMaxMsgMemory(options.max_memory / 8);
+
+    //Test 0: Low-level ZIM-file structure integrity checks
+    if(options.integrity) {
+        PhaseTimer timer(timings, Phase::INTEGRITY);
+        test_integrity(filename, error, options.thread_count, pool);
+    }
+    if(error.isCancelled())
+        return;
+
+    // Does it make sense to do the other checks if the integrity
+    // check fails?
+    PhaseTimer openTimer(timings, Phase::OPEN);
+    zim::Archive archive( filename );
+    openTimer.stop();
+    if (timings && options.integrity)
+        timings->addBytes(Phase::INTEGRITY, archive.getFilesize());
+
+    check_archive(archive, options, error, progress, pool, timings);
+}
+
+void run_checks(const zim::Archive& archive, const CheckOptions& options,
+                ErrorLogger& error, ProgressBar& progress, ThreadPool* pool,
+                Timings* timings)
+{
+    error.setOutput(options.output);
+    if (options.max_memory)
+        error.setMaxMsgMemory(options.max_memory / 8);
+
+    // The integrity check reads the file again, the archive is only opened.
+    if(options.integrity) {
+        PhaseTimer timer(timings, Phase::INTEGRITY, archive.getFilesize());
+        test_integrity(archive.getFilename(), error, options.thread_count, pool);
+    }
+    if(error.isCancelled())
+        return;
+
+    check_archive(archive, options, error, progress, pool, timings);
+}
+
+ZimChecker::ZimChecker(const CheckOptions& options)
+  : options(options),
+    maxReportMsgs(0),
+    // The thread calling check() runs the checks too.
+    pool(new ThreadPool(std::max(options.thread_count, 1U) - 1)),
+    report(new ErrorLogger)
+{}
+
+ZimChecker::~ZimChecker() = default;
+
+template<typename Source>
+StatusCode ZimChecker::runCheck(const Source& source)
+{
+    cancellation.reset();
+    error.clear();
+    report.reset(new ErrorLogger);
+    report->setMaxReportMsgs(maxReportMsgs);
+    // The cancellation token also stops the checks on cancel().
+    report->setFailFast(&cancellation, options.fail_fast);
+    CallbackSink sink(findingCallback);
+    if (findingCallback) {
+        report->setReportSink(&sink);
+    }
+    ProgressBar progress(options.progress_interval);
+    if (progressCallback) {
+        progress.set_callback([this](uint64_t done, uint64_t total) { progressCallback(done, total); });
+    }
+
+    StatusCode status;
+    try {
+        run_checks(source, options, *report, progress, pool.get(), nullptr);
+        status = report->overalStatus() ? PASS : FAIL;
+    } catch (const std::exception& e) {
+        error = e.what();
+        status = EXCEPTION;
+    }
+    report->setReportSink(nullptr);
+    return status;
+}
+
+StatusCode ZimChecker::check(const zim::Archive& archive)
+{
+    return runCheck(archive);
+}
+
+StatusCode ZimChecker::check(const std::string& filename)
+{
+    return runCheck(filename);
+}
@@ -0,0 +1,133 @@
+#ifndef _ZIM_TOOL_CHECKER_H_
+#define _ZIM_TOOL_CHECKER_H_
+
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <set>
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "checks.h"
+
+namespace zim {
+  class Archive;
+}
+
+class ThreadPool;
+class Timings;
+
+// The checks to run on a zim file, and how. No check is selected by default.
+struct CheckOptions
+{
+    bool checksum = false;
+    bool integrity = false;
+    bool metadata = false;
+    bool favicon = false;
+    bool main_page = false;
+    bool redundant_data = false;
+    bool url_check = false;
+    bool url_check_external = false;
+    bool empty_check = false;
+    bool mime_check = false;
+    bool unreachable_check = false;
+    bool redirect_check = false;
+    unsigned int max_redirect_chain = 1;
+    bool title_index_check = false;
+    double near_duplicates = 0; // The similarity of the near duplicates, 0 to skip them.
+    bool cluster_stats = false; // Describe the compression of the clusters.
+    unsigned int thread_count = 1;
+    std::string cache_filename;
+    std::string checkpoint_filename;
+    bool resume = false;
+    double checkpoint_overhead = 1;
+    double sample_percent = 0; // 0 to check all the clusters.
+    uint64_t seed = 0;
+    std::set<TestType> fail_fast; // Stop at the first failure of these checks.
+    size_t max_memory = 0; // 0 for no limit.
+    std::ostream* output = &std::cout; // The [INFO] lines of the checks, nullptr to discard them.
+    double progress_interval = 1; // Seconds between two calls of the progress callback.
+
+    // Select all the checks (as --all), except the unreachable entries (they
+    // need the whole link graph, and the resources only referenced from CSS
+    // or JavaScript are reported) and the search of near duplicates.
+    void selectAll();
+};
+
+// Run the checks on the zim file `filename` (or on the already opened
+// `archive`). Use `pool` (if given) for the article checks. Measure the time
+// of the phases in `timings` (if given).
+void run_checks(const std::string& filename, const CheckOptions& options,
+                ErrorLogger& error, ProgressBar& progress, ThreadPool* pool,
+                Timings* timings);
+void run_checks(const zim::Archive& archive, const CheckOptions& options,
+                ErrorLogger& error, ProgressBar& progress, ThreadPool* pool,
+                Timings* timings);
+
+/* Check zim files from another program (the zimcheck library).
+ *
+ * The library is internal to zim-tools (zimcheck and its tests): it is not
+ * installed and its API is not stable.
+ *
+ * The checker keeps its threads from one check to the next, and an already
+ * opened archive can be checked, so its caches are reused. The findings are
+ * given to their callback as soon as they are known, from the thread
+ * calling check(). The progress is given every `options.progress_interval`
+ * seconds (and at the end of the article checks) from a reporter thread,
+ * with an increasing `done`: the threads checking the articles never wait
+ * for it. With a finding callback, the report only
+ * counts the findings, it does not keep their messages. The checks print
+ * their [INFO] lines on `options.output`.
+ *
+ *   ZimChecker checker(options);
+ *   checker.onFinding([](TestType type, const std::string& message) { ... });
+ *   if (checker.check(archive) == FAIL) { ... checker.getReport() ... }
+ */
+class ZimChecker
+{
+  public:
+    typedef std::function<void(TestType type, const std::string& message)> FindingCallback;
+    // `done` of the `total` entries checked by the article checks.
+    typedef std::function<void(size_t done, size_t total)> ProgressCallback;
+
+    explicit ZimChecker(const CheckOptions& options);
+    ~ZimChecker();
+    ZimChecker(const ZimChecker&) = delete;
+    ZimChecker& operator=(const ZimChecker&) = delete;
+
+    void onFinding(FindingCallback callback) { findingCallback = callback; }
+    void onProgress(ProgressCallback callback) { progressCallback = callback; }
+    // Keep at most `max` messages per test type in the report (0 for all),
+    // when there is no finding callback.
+    void setMaxReportMsgs(size_t max) { maxReportMsgs = max; }
+
+    // Return PASS or FAIL, or EXCEPTION if the archive cannot be checked (see
+    // getError()). A cancelled check returns the status of what was checked.
+    StatusCode check(const zim::Archive& archive);
+    StatusCode check(const std::string& filename);
+
+    // Stop the current check as soon as possible. May be called from any
+    // thread (as a callback); the next check starts normally.
+    void cancel() { cancellation.cancel(); }
+    bool isCancelled() const { return cancellation.isCancelled(); }
+
+    // The result of the last check.
+    const ErrorLogger& getReport() const { return *report; }
+    const std::string& getError() const { return error; }
+
+  private:
+    template<typename Source>
+    StatusCode runCheck(const Source& source);
+
+    const CheckOptions options;
+    FindingCallback findingCallback;
+    ProgressCallback progressCallback;
+    size_t maxReportMsgs;
+    std::unique_ptr<ThreadPool> pool;
+    CancellationToken cancellation;
+    std::unique_ptr<ErrorLogger> report;
+    std::string error;
+};
+
+#endif
@@ -0,0 +1,110 @@
+#include "checkpoint.h"
+#include "checks.h"
+#include "clustercache.h"
+#include "contenthashtable.h"
+#include "linkgraph.h"
+#include "serialize.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <cstdio>
+
+namespace
+{
+
+const char CHECKPOINT_MAGIC[] = "zimcheck-checkpoint-4\n";
+
+} // unnamed namespace
+
+Checkpoint::Checkpoint(const std::string& path, bool resume, double maxOverhead)
+  : path(path),
+    resume(resume),
+    maxOverhead(maxOverhead),
+    start(Clock::now()),
+    nextSave(start),
+    saveDuration(Clock::duration::zero()),
+    saveCount(0)
+{}
+
+bool Checkpoint::load(const std::string& id, uint64_t& nextChunk,
+                      ErrorLogger& reporter, ContentHashTable& contentHashes,
+                      LinkGraph* linkGraph, ClusterCache* clusterCache) const
+{
+    if (!resume) {
+        return false;
+    }
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    std::string magic(sizeof(CHECKPOINT_MAGIC) - 1, '\0');
+    in.read(&magic[0], magic.size());
+    if (!in || magic != CHECKPOINT_MAGIC) {
+        throw std::runtime_error(path + " is not a zimcheck checkpoint");
+    }
+    if (readString(in) != id) {
+        throw std::runtime_error(path + " is a checkpoint of another archive or of other checks");
+    }
+    nextChunk = readValue<uint64_t>(in);
+    reporter.load(in);
+    contentHashes.load(in);
+    if (linkGraph) {
+        linkGraph->load(in);
+    }
+    if (clusterCache) {
+        clusterCache->load(in);
+    }
+    return true;
+}
+
+bool Checkpoint::isDue() const
+{
+    return Clock::now() >= nextSave;
+}
+
+void Checkpoint::save(const std::string& id, uint64_t nextChunk,
+                      const ErrorLogger& reporter, const ContentHashTable& contentHashes,
+                      const LinkGraph* linkGraph, ClusterCache* clusterCache)
+{
+    const auto saveStart = Clock::now();
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC) - 1);
+        writeString(out, id);
+        writeValue<uint64_t>(out, nextChunk);
+        reporter.save(out);
+        contentHashes.save(out);
+        if (linkGraph) {
+            linkGraph->save(out);
+        }
+        if (clusterCache) {
+            clusterCache->save(out);
+        }
+        out.close();
+        if (!out || std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Cannot write the checkpoint " + path);
+        }
+    }
+    const auto now = Clock::now();
+    const auto duration = now - saveStart;
+    saveDuration += duration;
+    saveCount++;
+    // A save taking d, followed by a pause of d * (100 / maxOverhead - 1),
+    // takes maxOverhead percent of the time.
+    nextSave = now + std::chrono::duration_cast<Clock::duration>(duration * (100 / maxOverhead - 1));
+}
+
+void Checkpoint::finish()
+{
+    std::remove(path.c_str());
+}
+
+double Checkpoint::getOverhead() const
+{
+    const auto elapsed = Clock::now() - start;
+    if (elapsed == Clock::duration::zero()) {
+        return 0;
+    }
+    return 100.0 * saveDuration.count() / elapsed.count();
+}
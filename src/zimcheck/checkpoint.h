@@ -0,0 +1,64 @@
+#ifndef _ZIM_TOOL_CHECKPOINT_H_
+#define _ZIM_TOOL_CHECKPOINT_H_
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+
+class ErrorLogger;
+class ContentHashTable;
+class LinkGraph;
+class ClusterCache;
+
+/* Periodic save of the state of the article checks (the number of chunks
+ * already checked, their findings, the content hash table and the clusters
+ * added to the cluster cache), so a long
+ * check can be resumed after an interruption instead of restarting from zero.
+ *
+ * Writing a checkpoint takes time (mostly to write the content hash table),
+ * so the checkpoints are spaced to take at most `maxOverhead` percent of the
+ * run time.
+ */
+class Checkpoint
+{
+  public:
+    Checkpoint(const std::string& path, bool resume, double maxOverhead);
+
+    // If resuming and a checkpoint exists, fill the state and return true.
+    // `id` identifies the archive and the checks, a checkpoint made with
+    // another id is refused (std::runtime_error).
+    // The link graph and the cluster cache are saved (and loaded) only if
+    // given, so they must be part of the id.
+    bool load(const std::string& id, uint64_t& nextChunk,
+              ErrorLogger& reporter, ContentHashTable& contentHashes,
+              LinkGraph* linkGraph = nullptr, ClusterCache* clusterCache = nullptr) const;
+
+    // Is it time to write a checkpoint?
+    bool isDue() const;
+
+    // Write the state of the checks. The previous checkpoint is replaced only
+    // once the new one is complete.
+    void save(const std::string& id, uint64_t nextChunk,
+              const ErrorLogger& reporter, const ContentHashTable& contentHashes,
+              const LinkGraph* linkGraph = nullptr, ClusterCache* clusterCache = nullptr);
+
+    // The checks are complete, remove the checkpoint.
+    void finish();
+
+    size_t getSaveCount() const { return saveCount; }
+    // Percentage of the time (since the creation) spent writing checkpoints.
+    double getOverhead() const;
+
+  private:
+    typedef std::chrono::steady_clock Clock;
+
+    std::string path;
+    bool resume;
+    double maxOverhead;
+    Clock::time_point start;
+    Clock::time_point nextSave;
+    Clock::duration saveDuration;
+    size_t saveCount;
+};
+
+#endif
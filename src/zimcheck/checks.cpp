@@ -1,40 +1,306 @@
+#define ZIM_PRIVATE
 #include "checks.h"
+#include "contenthashtable.h"
+#include "pathindex.h"
+#include "linkcache.h"
+#include "clustercache.h"
+#include "checkpoint.h"
+#include "serialize.h"
+#include "threadpool.h"
+#include "mimesniffer.h"
+#include "sampling.h"
+#include "timings.h"
+#include "filechecksum.h"
+#include "linkgraph.h"
+#include "redirects.h"
+#include "redundancy.h"
+#include "neardup.h"
+#include "direntscanner.h"
+#include "clusterstats.h"
+#include "spill.h"
 #include "../tools.h"
 
 #include <map>
 #include <unordered_map>
-#include <list>
 #include <sstream>
-#define ZIM_PRIVATE
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <exception>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <cstring>
 #include <zim/archive.h>
 #include <zim/item.h>
 
-void test_checksum(zim::Archive& archive, ErrorLogger& reporter) {
-    std::cout << "[INFO] Verifying Internal Checksum..." << std::endl;
-    bool result = archive.check();
+const std::unordered_map<LogTag, std::string> tagToStr{ {LogTag::ERROR,     "ERROR"},
+                                                         {LogTag::WARNING,   "WARNING"}};
+
+const std::unordered_map<TestType, std::pair<LogTag, std::string>> errormapping = {
+    { TestType::CHECKSUM,      {LogTag::ERROR, "Invalid checksum"}},
+    { TestType::INTEGRITY,     {LogTag::ERROR, "Invalid low-level structure"}},
+    { TestType::EMPTY,         {LogTag::ERROR, "Empty articles"}},
+    { TestType::METADATA,      {LogTag::ERROR, "Missing metadata entries"}},
+    { TestType::FAVICON,       {LogTag::ERROR, "Missing favicon"}},
+    { TestType::MAIN_PAGE,     {LogTag::ERROR, "Missing mainpage"}},
+    { TestType::REDUNDANT,     {LogTag::WARNING, "Redundant data found"}},
+    { TestType::URL_INTERNAL,  {LogTag::ERROR, "Invalid internal links found"}},
+    { TestType::URL_EXTERNAL,  {LogTag::ERROR, "Invalid external links found"}},
+    { TestType::MIME,       {LogTag::ERROR, "Incoherent mimeType found"}},
+    { TestType::UNREACHABLE, {LogTag::WARNING, "Entries not reachable from the main page found"}},
+    { TestType::REDIRECT,    {LogTag::ERROR, "Invalid redirections found"}},
+    { TestType::REDIRECT_CHAIN, {LogTag::WARNING, "Long redirection chains found"}},
+    { TestType::NEAR_DUPLICATE, {LogTag::WARNING, "Near duplicate articles found"}},
+    { TestType::TITLE_INDEX, {LogTag::ERROR, "Invalid title index found"}},
+    { TestType::OTHER,      {LogTag::ERROR, "Other errors found"}}
+};
+
+const std::unordered_map<TestType, std::string> testTypeToStr = {
+    { TestType::CHECKSUM,      "checksum"},
+    { TestType::INTEGRITY,     "integrity"},
+    { TestType::EMPTY,         "empty"},
+    { TestType::METADATA,      "metadata"},
+    { TestType::FAVICON,       "favicon"},
+    { TestType::MAIN_PAGE,     "main_page"},
+    { TestType::REDUNDANT,     "redundant"},
+    { TestType::URL_INTERNAL,  "url_internal"},
+    { TestType::URL_EXTERNAL,  "url_external"},
+    { TestType::MIME,          "mime"},
+    { TestType::UNREACHABLE,   "unreachable"},
+    { TestType::REDIRECT,      "redirect"},
+    { TestType::REDIRECT_CHAIN, "redirect_chain"},
+    { TestType::NEAR_DUPLICATE, "near_duplicate"},
+    { TestType::TITLE_INDEX,   "title_index"},
+    { TestType::OTHER,         "other"}
+};
+
+std::ostream& ErrorLogger::info() const
+{
+    // Without a buffer, the writes fail silently.
+    static std::ostream discarded(nullptr);
+    return output ? *output : discarded;
+}
+
+void ErrorLogger::forEachReportMsg(TestType type, const std::function<void(const std::string&)>& f) const
+{
+    const auto spilled = spilledMsgs.find(type);
+    if (spilled != spilledMsgs.end()) {
+        std::istream& in = spilled->second->rewind();
+        for (auto n = getSpilledMsgCount(type); n > 0; n--) {
+            f(readString(in));
+        }
+        spilled->second->release();
+    }
+    const auto msgs = reportMsgs.find(type);
+    if (msgs != reportMsgs.end()) {
+        for (const auto& msg : msgs->second) {
+            f(msg);
+        }
+    }
+}
+
+void ErrorLogger::spillMsgs()
+{
+    for (auto& testmsg : reportMsgs) {
+        if (testmsg.second.empty()) {
+            continue;
+        }
+        auto& file = spilledMsgs[testmsg.first];
+        if (!file) {
+            file.reset(new TemporaryFile());
+        }
+        std::ostream& out = file->append();
+        for (const auto& msg : testmsg.second) {
+            writeString(out, msg);
+        }
+        file->release();
+        if (!out) {
+            throw std::runtime_error("Cannot write the messages to a temporary file");
+        }
+        spilledMsgCounts[testmsg.first] += testmsg.second.size();
+        // Keep the type in reportMsgs, it is reported in this order.
+        std::vector<std::string>().swap(testmsg.second);
+    }
+    msgMemory = 0;
+}
+
+void ErrorLogger::save(std::ostream& out) const
+{
+    writeValue<uint32_t>(out, reportMsgs.size());
+    for (const auto& testmsg : reportMsgs) {
+        writeValue<uint32_t>(out, uint32_t(testmsg.first));
+        writeValue<uint64_t>(out, testmsg.second.size() + getSpilledMsgCount(testmsg.first));
+        forEachReportMsg(testmsg.first, [&out](const std::string& msg) {
+            writeString(out, msg);
+        });
+    }
+    writeValue<uint32_t>(out, droppedMsgs.size());
+    for (const auto& dropped : droppedMsgs) {
+        writeValue<uint32_t>(out, uint32_t(dropped.first));
+        writeValue<uint64_t>(out, dropped.second);
+    }
+    writeValue<uint32_t>(out, streamedMsgs.size());
+    for (const auto& streamed : streamedMsgs) {
+        writeValue<uint32_t>(out, uint32_t(streamed.first));
+        writeValue<uint64_t>(out, streamed.second);
+    }
+    writeValue<uint32_t>(out, testStatus.size());
+    for (const auto& status : testStatus) {
+        writeValue<uint32_t>(out, uint32_t(status.first));
+        writeValue<uint8_t>(out, status.second);
+    }
+}
+
+void ErrorLogger::load(std::istream& in)
+{
+    const auto readTestType = [&in]() {
+        const auto type = readValue<uint32_t>(in);
+        if (type > uint32_t(TestType::OTHER)) {
+            throw std::runtime_error("Invalid test type");
+        }
+        return TestType(type);
+    };
+    reportMsgs.clear();
+    droppedMsgs.clear();
+    streamedMsgs.clear();
+    spilledMsgs.clear();
+    spilledMsgCounts.clear();
+    msgMemory = 0;
+    for (auto n = readValue<uint32_t>(in); n > 0; n--) {
+        auto& msgs = reportMsgs[readTestType()];
+        for (auto m = readValue<uint64_t>(in); m > 0; m--) {
+            msgs.push_back(readString(in));
+        }
+    }
+    for (auto n = readValue<uint32_t>(in); n > 0; n--) {
+        const auto type = readTestType();
+        droppedMsgs[type] = readValue<uint64_t>(in);
+    }
+    for (auto n = readValue<uint32_t>(in); n > 0; n--) {
+        const auto type = readTestType();
+        reportMsgs[type];
+        streamedMsgs[type] = readValue<uint64_t>(in);
+    }
+    for (auto n = readValue<uint32_t>(in); n > 0; n--) {
+        const auto type = readTestType();
+        testStatus[type] = readValue<uint8_t>(in);
+    }
+}
+
+namespace
+{
+
+/* Check the checksum of the zim file `filename` with computeFileChecksum, or
+ * with `libzimCheck` if the file cannot be read this way (a split zim file
+ * for instance).
+ * The throughput is written in `info` (to print it from the main thread).
+ */
+bool check_file_checksum(const std::string& filename, const std::function<bool()>& libzimCheck,
+                         std::string& info)
+{
+    FileChecksum checksum;
+    try {
+        checksum = computeFileChecksum(filename);
+    } catch (const std::exception&) {
+        return libzimCheck();
+    }
+    const auto gbPerSecond = [&checksum](double seconds) {
+        return seconds > 0 ? checksum.bytes / seconds / 1e9 : 0;
+    };
+    std::ostringstream ss;
+    ss << "[INFO] Checksum of " << checksum.bytes / 1e9 << " GB computed in "
+       << checksum.seconds << " seconds: " << gbPerSecond(checksum.seconds) << " GB/s"
+       << " (reading alone: " << gbPerSecond(checksum.readSeconds) << " GB/s,"
+       << " hashing alone: " << gbPerSecond(checksum.hashSeconds) << " GB/s)";
+    info = ss.str();
+    return checksum.isValid();
+}
+
+} // unnamed namespace
+
+void test_checksum(const zim::Archive& archive, ErrorLogger& reporter) {
+    reporter.info() << "[INFO] Verifying Internal Checksum..." << std::endl;
+    std::string info;
+    bool result = check_file_checksum(archive.getFilename(), [&archive]() { return archive.check(); }, info);
+    if (!info.empty()) {
+        reporter.info() << info << std::endl;
+    }
     reporter.setTestResult(TestType::CHECKSUM, result);
     if (!result) {
-        std::cout << "  [ERROR] Wrong Checksum in ZIM archive" << std::endl;
+        reporter.info() << "  [ERROR] Wrong Checksum in ZIM archive" << std::endl;
         std::ostringstream ss;
         ss << "ZIM Archive Checksum in archive: " << archive.getChecksum() << std::endl;
         reporter.addReportMsg(TestType::CHECKSUM, ss.str());
     }
 }
 
-void test_integrity(const std::string& filename, ErrorLogger& reporter) {
-    std::cout << "[INFO] Verifying ZIM-archive structure integrity..." << std::endl;
+void test_integrity(const std::string& filename, ErrorLogger& reporter,
+                    unsigned int thread_count, ThreadPool* pool) {
+    reporter.info() << "[INFO] Verifying ZIM-archive structure integrity..." << std::endl;
     zim::IntegrityCheckList checks;
-    checks.set(); // enable all checks (including checksum)
-    bool result = zim::validate(filename, checks);
+    checks.set(); // enable all checks (but the checksum)
+    // The checksum reads the whole file, it is computed meanwhile by another
+    // thread (if there are several).
+    checks.reset(size_t(zim::IntegrityCheck::CHECKSUM));
+    std::string info;
+    bool checksumValid = false;
+    std::exception_ptr checksumError;
+    std::atomic<bool> checksumDone(false);
+    const auto checkChecksum = [&]() {
+        try {
+            checksumValid = check_file_checksum(filename, [&filename]() {
+                zim::IntegrityCheckList checksumOnly;
+                checksumOnly.set(size_t(zim::IntegrityCheck::CHECKSUM));
+                return zim::validate(filename, checksumOnly);
+            }, info);
+        } catch (...) {
+            checksumError = std::current_exception();
+        }
+        checksumDone = true;
+    };
+    std::unique_ptr<ThreadPool> localPool;
+    if (!pool && thread_count > 1) {
+        // The calling thread is the other one.
+        localPool.reset(new ThreadPool(1));
+        pool = localPool.get();
+    }
+    if (pool) {
+        pool->submit(checkChecksum);
+    }
+    bool result = false;
+    std::exception_ptr error;
+    try {
+        result = zim::validate(filename, checks);
+    } catch (...) {
+        error = std::current_exception();
+    }
+    // The checksum task uses our local variables, wait for it in any case.
+    if (pool) {
+        pool->helpUntil([&checksumDone]() { return bool(checksumDone); });
+    } else if (!error) {
+        checkChecksum();
+    }
+    if (!error) {
+        error = checksumError;
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+    result = checksumValid && result;
+    if (!info.empty()) {
+        reporter.info() << info << std::endl;
+    }
     reporter.setTestResult(TestType::INTEGRITY, result);
     if (!result) {
-        std::cout << "  [ERROR] ZIM file's low level structure is invalid" << std::endl;
+        reporter.info() << "  [ERROR] ZIM file's low level structure is invalid" << std::endl;
     }
 }
 
 
 void test_metadata(const zim::Archive& archive, ErrorLogger& reporter) {
-    std::cout << "[INFO] Searching for metadata entries..." << std::endl;
+    reporter.info() << "[INFO] Searching for metadata entries..." << std::endl;
     static const char* const test_meta[] = {
         "Title",
         "Creator",
@@ -54,7 +320,7 @@ void test_metadata(const zim::Archive& archive, ErrorLogger& reporter) {
 }
 
 void test_favicon(const zim::Archive& archive, ErrorLogger& reporter) {
-    std::cout << "[INFO] Searching for Favicon..." << std::endl;
+    reporter.info() << "[INFO] Searching for Favicon..." << std::endl;
     static const char* const favicon_paths[] = {"-/favicon.png", "I/favicon.png", "I/favicon", "-/favicon"};
     for (auto &path: favicon_paths) {
         if (archive.hasEntryByPath(path)) {
@@ -65,7 +331,7 @@ void test_favicon(const zim::Archive& archive, ErrorLogger& reporter) {
 }
 
 void test_mainpage(const zim::Archive& archive, ErrorLogger& reporter) {
-    std::cout << "[INFO] Searching for main page..." << std::endl;
+    reporter.info() << "[INFO] Searching for main page..." << std::endl;
     bool testok = true;
     try {
       archive.getMainEntry();
@@ -80,167 +346,1577 @@ void test_mainpage(const zim::Archive& archive, ErrorLogger& reporter) {
     }
 }
 
+namespace
+{
 
-void test_articles(const zim::Archive& archive, ErrorLogger& reporter, ProgressBar progress,
-                   bool redundant_data, bool url_check, bool url_check_external, bool empty_check) {
-    std::cout << "[INFO] Verifying Articles' content..." << std::endl;
-    // Article are store in a map<hash, list<index>>.
-    // So all article with the same hash will be stored in the same list.
-    std::map<unsigned int, std::list<zim::entry_index_type>> hash_main;
+// Number of redirections written at most in a message.
+const uint32_t MAX_DESCRIBED_REDIRECTS = 8;
 
-    int previousIndex = -1;
+// "a -> b -> c": `index` and the entries it redirects to, following at most
+// `hops` redirections.
+std::string describe_redirects(const zim::Archive& archive, zim::entry_index_type index, uint32_t hops)
+{
+    std::ostringstream ss;
+    ss << archive.getEntryByPath(index).getPath();
+    for (uint32_t hop = 0; hop < hops; hop++) {
+        if (hop == MAX_DESCRIBED_REDIRECTS) {
+            ss << " -> ...";
+            break;
+        }
+        const auto entry = archive.getEntryByPath(index);
+        if (!entry.isRedirect()) {
+            break;
+        }
+        index = entry.getRedirectEntryIndex();
+        if (index >= archive.getEntryCount()) {
+            ss << " -> #" << index;
+            break;
+        }
+        ss << " -> " << archive.getEntryByPath(index).getPath();
+    }
+    return ss.str();
+}
 
-    progress.reset(archive.getEntryCount());
-    for (auto& entry:archive.iterEfficient()) {
-        progress.report();
-        auto path = entry.getPath();
-        char ns = archive.hasNewNamespaceScheme() ? 'C' : path[0];
+} // unnamed namespace
 
-        if (entry.isRedirect() || ns == 'M') {
+void test_redirects(const zim::Archive& archive, ErrorLogger& reporter, unsigned int max_chain_length) {
+    reporter.info() << "[INFO] Checking redirections..." << std::endl;
+    const zim::entry_index_type entryCount = archive.getEntryCount();
+    RedirectTable redirects(entryCount);
+    // Only the dirents are needed, read directly from the file if possible.
+    const DirentScanner scanner(archive);
+    DirentView dirent;
+    for (zim::entry_index_type i = 0; i < entryCount; i++) {
+        if (scanner.get(i, dirent)) {
+            if (dirent.isRedirect()) {
+                redirects.setTarget(i, dirent.redirectIndex);
+            }
             continue;
         }
+        const auto entry = archive.getEntryByPath(i);
+        if (entry.isRedirect()) {
+            redirects.setTarget(i, entry.getRedirectEntryIndex());
+        }
+    }
+    redirects.resolve();
 
-        if (empty_check && (ns=='A' || ns == 'I')) {
-            auto item = entry.getItem();
-            if (item.getSize() == 0) {
-                std::ostringstream ss;
-                ss << "Entry " << path << " is empty";
-                reporter.addReportMsg(TestType::EMPTY, ss.str());
-                reporter.setTestResult(TestType::EMPTY, false);
+    std::vector<bool> inLoop;
+    for (const auto& loop : redirects.getLoops()) {
+        inLoop.resize(entryCount);
+        for (const auto entry : loop) {
+            inLoop[entry] = true;
+        }
+        reporter.setTestResult(TestType::REDIRECT, false);
+        reporter.addReportMsg(TestType::REDIRECT,
+            "Redirection loop: " + describe_redirects(archive, loop.front(), loop.size()));
+    }
+    for (zim::entry_index_type i = 0; i < entryCount; i++) {
+        const uint32_t target = redirects.getFinalTarget(i);
+        const uint32_t length = redirects.getChainLength(i);
+        if (target == RedirectTable::DANGLING) {
+            reporter.setTestResult(TestType::REDIRECT, false);
+            reporter.addReportMsg(TestType::REDIRECT,
+                "Redirection to a missing entry: " + describe_redirects(archive, i, length));
+        } else if (target == RedirectTable::LOOP) {
+            if (!inLoop[i]) {
+                reporter.addReportMsg(TestType::REDIRECT,
+                    "Redirection to a loop: " + describe_redirects(archive, i, length));
+            }
+        } else if (target != RedirectTable::NONE && length > max_chain_length
+                && !redirects.isTargeted(i)) {
+            // Only the first redirection of a chain is reported.
+            reporter.setTestResult(TestType::REDIRECT_CHAIN, false);
+            std::ostringstream ss;
+            ss << "Chain of " << length << " redirections: " << describe_redirects(archive, i, length);
+            reporter.addReportMsg(TestType::REDIRECT_CHAIN, ss.str());
+        }
+    }
+}
+
+
+namespace
+{
+
+// Articles are checked by chunks of consecutive entries (in cluster order).
+// A chunk is the unit of work given to a worker thread.
+const zim::entry_index_type ARTICLE_CHUNK_SIZE = 1024;
+// Chunks per thread submitted (or waiting to be merged) at once.
+const size_t CHUNK_WINDOW = 2;
+
+// The chunks submitted (or waiting to be merged) at once on the `pool`. The
+// thread merging them runs chunks too, so a pool without worker still checks
+// one chunk at a time.
+size_t chunkWindow(const ThreadPool& pool)
+{
+    return CHUNK_WINDOW * std::max(pool.size(), 1U);
+}
+
+const zim::cluster_index_type NO_CLUSTER = zim::cluster_index_type(-1);
+
+// Maximum number of links in the link cache.
+const size_t LINK_CACHE_SIZE = 1 << 20;
+// Rough memory used by a link in the link cache (key, target and node).
+const size_t LINK_CACHE_ENTRY_MEMORY = 256;
+
+// With a memory budget, the part of it given to the link cache, and the
+// part of what is left once the path index and the link graph are built
+// given to the redundancy check.
+const size_t LINK_CACHE_MEMORY_SHARE = 8;
+const size_t REDUNDANCY_MEMORY_SHARE = 2;
+// Never less than this for the redundancy check.
+const size_t MIN_REDUNDANCY_MEMORY = 64 * 1024 * 1024;
+
+// What all the workers share while checking the articles.
+struct ArticleCheckContext
+{
+    ArticleCheckContext(const zim::Archive& archive, const ArticleCheckOptions& options,
+                        ClusterCache* clusterCache, const Sampling* sampling, bool timed,
+                        size_t linkCacheSize)
+      : archive(archive),
+        options(options),
+        linkCache(linkCacheSize),
+        clusterCache(clusterCache),
+        sampling(sampling),
+        timed(timed)
+    {}
+
+    const zim::Archive& archive;
+    const ArticleCheckOptions options;
+    PathIndex pathIndex; // Only built for the internal url check.
+    mutable LinkCache linkCache;
+    ClusterCache* clusterCache;
+    std::unique_ptr<ClusterHasher> clusterHasher; // Only if clusterCache is set.
+    std::unique_ptr<ClusterStats> clusterStats;   // Only to describe the clusters.
+    const Sampling* sampling; // Only check some clusters, if set.
+    const bool timed;         // Measure the time of the phases.
+};
+
+const size_t NO_SAMPLE = size_t(-1);
+
+// The checks run on each item (the redundancy is found when merging).
+const TestType ITEM_TEST_TYPES[] = {
+    TestType::EMPTY, TestType::URL_INTERNAL, TestType::URL_EXTERNAL, TestType::MIME
+};
+
+// The fingerprint of the content of an item, for the redundancy check.
+struct ContentRecord
+{
+    Hash128 hash;
+    zim::size_type size;
+    zim::entry_index_type index;
+    size_t sample; // Index of the ClusterSample of the item, or NO_SAMPLE.
+};
+
+// What a worker finds in a chunk. `reporter` is a shard of the main
+// ErrorLogger and is merged into it in chunk order.
+struct ChunkResult
+{
+    ErrorLogger reporter;
+    std::vector<ContentRecord> contents;
+    // The clusters to write in the new cluster cache.
+    std::vector<std::pair<Hash128, ClusterInfo>> clusters;
+    size_t cachedClusters = 0;
+    // The links and the (item, size), for the link graph.
+    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> links;
+    std::vector<std::pair<uint32_t, uint64_t>> items;
+    // The (text signature, item) of the html items, for the near duplicates.
+    std::vector<std::pair<uint64_t, uint32_t>> signatures;
+    std::vector<ClusterRecord> clusterRecords;
+    // The sampled clusters (if sampling) and the one of the item being checked.
+    std::vector<ClusterSample> samples;
+    size_t currentSample = NO_SAMPLE;
+    Timings timings;
+};
+
+/* Run `work(chunk, result)` for all chunks in [0, chunkCount) on the `pool`,
+ * and give the results to `merge` in chunk order (as soon as all the
+ * previous chunks have been merged).
+ * As results are merged in order, the output doesn't depend on the number
+ * of threads or on the scheduling.
+ * Only a window of CHUNK_WINDOW chunks per thread is submitted (or kept
+ * until merged) at once, so the memory doesn't depend on the chunk count:
+ * the results are stored in a ring of the size of the window, the chunks
+ * in flight (after the one being merged) all having a different slot.
+ */
+template<typename Result, typename Work, typename Merge>
+void runChunksInOrder(ThreadPool& pool, size_t chunkCount, Work work, Merge merge)
+{
+    const size_t window = std::min(chunkWindow(pool), chunkCount);
+    std::vector<std::unique_ptr<Result>> results(window);
+    std::mutex mutex;
+    std::atomic<size_t> finished(0);
+    std::atomic<bool> cancelled(false);
+    std::exception_ptr error;
+    size_t submitted = 0;
+
+    const auto submit = [&](size_t chunk) {
+        submitted++;
+        pool.submit([&, chunk]() {
+            std::unique_ptr<Result> result(new Result);
+            try {
+                // Stop as soon as possible in case of error.
+                if (!cancelled) {
+                    work(chunk, *result);
+                }
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (!error) {
+                    error = std::current_exception();
+                }
+                cancelled = true;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results[chunk % window] = std::move(result);
             }
+            finished++;
+        });
+    };
+    while (submitted < window) {
+        submit(submitted);
+    }
+
+    try {
+        for (size_t chunk = 0; chunk < chunkCount; ++chunk) {
+            pool.helpUntil([&]() {
+                std::lock_guard<std::mutex> lock(mutex);
+                return error || results[chunk % window];
+            });
+            std::unique_ptr<Result> result;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (error) {
+                    break;
+                }
+                result = std::move(results[chunk % window]);
+            }
+            // Its slot is free for the next chunk of the window.
+            if (submitted < chunkCount) {
+                submit(submitted);
+            }
+            merge(*result);
         }
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!error) {
+            error = std::current_exception();
+        }
+    }
+
+    // The tasks use our local variables, wait for all of them.
+    cancelled = true;
+    pool.helpUntil([&]() { return finished == submitted; });
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
 
-        auto item = entry.getItem();
+zim::Entry getEntryByClusterOrder(const zim::Archive& archive, zim::entry_index_type idx)
+{
+    return *archive.iterEfficient().offset(idx, 1).begin();
+}
 
-        if (item.getSize() == 0) {
+zim::cluster_index_type getClusterIndex(const zim::Entry& entry)
+{
+    return entry.isRedirect() ? NO_CLUSTER : entry.getItem().getClusterIndex();
+}
+
+// Return the range [begin, end) of entries (in cluster order) of the chunk.
+// The nominal boundaries of the chunk are moved to not split a cluster
+// between two chunks (and so, to decompress a cluster in only one worker).
+std::pair<zim::entry_index_type, zim::entry_index_type>
+getChunkRange(const zim::Archive& archive, size_t chunk)
+{
+    const zim::entry_index_type entryCount = archive.getEntryCount();
+    zim::entry_index_type begin = chunk * ARTICLE_CHUNK_SIZE;
+    zim::entry_index_type end = std::min(begin + ARTICLE_CHUNK_SIZE, entryCount);
+
+    if (begin > 0) {
+        // Skip the entries belonging to the last cluster of the previous chunk.
+        const auto previousCluster = getClusterIndex(getEntryByClusterOrder(archive, begin-1));
+        while (previousCluster != NO_CLUSTER && begin < end
+            && getClusterIndex(getEntryByClusterOrder(archive, begin)) == previousCluster) {
+            begin++;
+        }
+    }
+    if (begin == end) {
+        return std::make_pair(begin, end);
+    }
+
+    // Take the entries belonging to our last cluster from the next chunk.
+    const auto lastCluster = getClusterIndex(getEntryByClusterOrder(archive, end-1));
+    while (lastCluster != NO_CLUSTER && end < entryCount
+        && getClusterIndex(getEntryByClusterOrder(archive, end)) == lastCluster) {
+        end++;
+    }
+    return std::make_pair(begin, end);
+}
+
+// An item to check and its content, loaded once and shared by all the checks.
+struct ArticleContent
+{
+    std::string path;
+    char ns;
+    zim::entry_index_type index;
+    zim::blob_index_type blob;
+    std::string mimetype;
+    zim::size_type size;
+    std::string data; // Only loaded if a check needs it.
+    std::string head; // The first bytes, if only they are needed.
+
+    // What is computed from the data (or found in the cluster cache).
+    bool analyzed = false;
+    Hash128 contentHash;
+    bool hasLinks = false;
+    LinkTable links;
+    std::string sniffedMimetype;
+    uint64_t textSignature = 0;
+};
+
+// The items of one cluster, in blob order.
+struct ClusterContent
+{
+    std::vector<ArticleContent> articles;
+    zim::cluster_index_type cluster = NO_CLUSTER;
+    zim::entry_index_type end; // Index (in cluster order) after the last entry of the cluster.
+    bool hashed = false;       // The cluster can be stored in the cluster cache.
+    Hash128 hash;
+    bool fromCache = false;
+    Timings timings; // Of the loading, done in another thread.
+    bool readAhead = false; // Loaded by another thread before being needed.
+    // The redirections (entry, target) met, for the link graph.
+    std::vector<std::pair<uint32_t, uint32_t>> redirects;
+    ClusterRecord record; // Only if the clusters are described.
+};
+
+// When a cluster cache is used, everything is computed (whatever the checks),
+// so the cache can be reused by any later run.
+bool keep_all(const ArticleCheckContext& context)
+{
+    return context.clusterCache != nullptr;
+}
+
+bool needs_data(const ArticleCheckContext& context, const std::string& mimetype)
+{
+    const ArticleCheckOptions& options = context.options;
+    return keep_all(context)
+        || options.redundant_data
+        || (mimetype == "text/html"
+            && (options.url_check || options.url_check_external || options.unreachable_check
+                || options.near_duplicates));
+}
+
+bool needs_links(const ArticleCheckContext& context, const ArticleContent& article)
+{
+    const ArticleCheckOptions& options = context.options;
+    return article.mimetype == "text/html"
+        && (keep_all(context) || options.url_check || options.url_check_external
+            || options.unreachable_check);
+}
+
+// Take what is known of the articles from the cluster cache.
+// Return false if something is missing (and then nothing is taken).
+bool load_from_cache(const ArticleCheckContext& context, const ClusterInfo& info,
+                     std::vector<ArticleContent>& articles)
+{
+    for (const auto& article : articles) {
+        const auto it = info.find(article.blob);
+        if (it == info.end() || it->second.size != article.size
+         || (needs_links(context, article) && !it->second.hasLinks)) {
+            return false;
+        }
+    }
+    for (auto& article : articles) {
+        const BlobInfo& blob = info.at(article.blob);
+        article.contentHash = blob.hash;
+        article.hasLinks = blob.hasLinks;
+        article.links = blob.links;
+        article.sniffedMimetype = blob.sniffedMimetype;
+        article.textSignature = blob.textSignature;
+        article.analyzed = true;
+    }
+    return true;
+}
+
+/* Load the content of the items of the cluster starting at `begin` (in
+ * cluster order), without going further than `end`.
+ * If sampling, the items of a cluster not in the sample are skipped.
+ * All the blobs of the cluster are read at once, so the cluster is
+ * decompressed only once (it stays in libzim's cluster cache meanwhile).
+ * Consecutive redirects are grouped together as if they were a cluster.
+ * If the cluster is in the cluster cache, it is not read at all.
+ */
+ClusterContent load_cluster(const ArticleCheckContext& context, zim::entry_index_type begin,
+                            zim::entry_index_type end)
+{
+    const zim::Archive& archive = context.archive;
+    ClusterContent content;
+    content.end = begin;
+    bool first = true;
+    bool skip = false;
+    zim::cluster_index_type cluster = NO_CLUSTER;
+    std::vector<zim::Item> items;
+    for (auto& entry:archive.iterEfficient().offset(begin, end - begin)) {
+        const auto entryCluster = getClusterIndex(entry);
+        if (!first && entryCluster != cluster) {
+            break;
+        }
+        if (first && context.sampling && entryCluster != NO_CLUSTER) {
+            skip = !isClusterSampled(*context.sampling, entryCluster);
+        }
+        first = false;
+        cluster = entryCluster;
+        content.end++;
+
+        if (skip) {
+            continue;
+        }
+        if (entry.isRedirect()) {
+            if (context.options.unreachable_check) {
+                content.redirects.push_back(std::make_pair(entry.getIndex(), entry.getRedirectEntryIndex()));
+            }
             continue;
         }
 
-        std::string data;
-        if (redundant_data || item.getMimetype() == "text/html")
-            data = item.getData();
+        ArticleContent article;
+        article.path = entry.getPath();
+        article.ns = archive.hasNewNamespaceScheme() ? 'C' : article.path[0];
+        if (article.ns == 'M') {
+            continue;
+        }
+        const auto item = entry.getItem();
+        article.index = item.getIndex();
+        article.blob = item.getBlobIndex();
+        article.mimetype = item.getMimetype();
+        article.size = item.getSize();
+        content.articles.push_back(std::move(article));
+        items.push_back(item);
+    }
+    if (!skip) {
+        content.cluster = cluster;
+    }
 
-        if(redundant_data)
-            hash_main[adler32(data)].push_back( item.getIndex() );
+    if (context.clusterStats && content.cluster != NO_CLUSTER) {
+        content.record = context.clusterStats->describe(cluster);
+        for (const auto& article : content.articles) {
+            content.record.addBlob(article.blob, article.mimetype, article.size);
+        }
+    }
 
-        if (item.getMimetype() != "text/html")
+    if (context.clusterCache && cluster != NO_CLUSTER && !content.articles.empty()) {
+        PhaseTimer hashTimer(context.timed ? &content.timings : nullptr, Phase::CLUSTER_HASH,
+                             context.clusterHasher->size(cluster), 1);
+        content.hashed = context.clusterHasher->hash(cluster, content.hash);
+        hashTimer.stop();
+        ClusterInfo info;
+        if (content.hashed
+         && context.clusterCache->find(content.hash, info)
+         && load_from_cache(context, info, content.articles)) {
+            content.fromCache = true;
+            return content;
+        }
+    }
+
+    if (context.timed) {
+        content.timings.addThread(std::this_thread::get_id());
+    }
+    PhaseTimer timer(context.timed ? &content.timings : nullptr, Phase::DECOMPRESSION);
+    for (size_t i = 0; i < items.size(); i++) {
+        ArticleContent& article = content.articles[i];
+        if (article.size == 0) {
+            continue;
+        }
+        if (needs_data(context, article.mimetype)) {
+            article.data = items[i].getData();
+        } else if (context.options.mime_check) {
+            article.head = items[i].getData(0, std::min<zim::size_type>(article.size, SNIFF_SIZE));
+        } else {
             continue;
+        }
+        timer.addBytes(article.data.size() + article.head.size());
+        timer.addEntries(1);
+    }
+    timer.stop();
+    return content;
+}
 
-        std::vector<html_link> links;
-        if (url_check || url_check_external) {
-            links = generic_getLinks(data);
+/* Read ahead of a cluster (see load_cluster) on the pool: an idle worker
+ * loads it while the checks run on the current cluster. If no worker started
+ * it when it is needed, the thread needing it loads it itself, so the read
+ * ahead never adds a thread to the ones of the pool. The read ahead is
+ * submitted first: the workers start it before the chunks waiting.
+ * Without pool, the cluster is only loaded when needed.
+ */
+class ClusterPrefetch
+{
+  public:
+    ClusterPrefetch(ThreadPool* pool, const ArticleCheckContext& context,
+                    zim::entry_index_type begin, zim::entry_index_type end)
+      : slot(std::make_shared<Slot>())
+    {
+        slot->load = [&context, begin, end]() { return load_cluster(context, begin, end); };
+        if (pool) {
+            // The task may run after the prefetch is gone, it then does nothing.
+            std::shared_ptr<Slot> task = slot;
+            pool->submitFirst([task]() { task->run(); });
         }
+    }
 
-        if(url_check)
-        {
-            auto baseUrl = path;
-            auto pos = baseUrl.find_last_of('/');
-            baseUrl.resize( pos==baseUrl.npos ? 0 : pos );
+    ClusterPrefetch(ClusterPrefetch&& other) = default;
+    ClusterPrefetch& operator=(ClusterPrefetch&& other)
+    {
+        abandon();
+        slot = std::move(other.slot);
+        return *this;
+    }
 
-            std::unordered_map<std::string, std::vector<std::string>> filtered;
-            int nremptylinks = 0;
-            for (const auto &l : links)
+    ~ClusterPrefetch()
+    {
+        abandon();
+    }
+
+    ClusterContent get()
+    {
+        slot->run();
+        std::unique_lock<std::mutex> lock(slot->mutex);
+        slot->done.wait(lock, [this]() { return slot->finished; });
+        if (slot->error) {
+            std::rethrow_exception(slot->error);
+        }
+        ClusterContent content = std::move(slot->content);
+        content.readAhead = slot->loader != std::this_thread::get_id();
+        return content;
+    }
+
+  private:
+    // The cluster is not needed (anymore): a load not started is cancelled
+    // and a running one is waited for, as it uses the context.
+    void abandon()
+    {
+        if (!slot) {
+            return;
+        }
+        std::unique_lock<std::mutex> lock(slot->mutex);
+        if (!slot->started) {
+            slot->started = slot->finished = true;
+        }
+        slot->done.wait(lock, [this]() { return slot->finished; });
+    }
+
+    struct Slot
+    {
+        std::mutex mutex;
+        std::condition_variable done;
+        bool started = false;
+        bool finished = false;
+        std::function<ClusterContent()> load;
+        ClusterContent content;
+        std::exception_ptr error;
+        std::thread::id loader;
+
+        // Load the cluster, unless another thread already does.
+        void run()
+        {
             {
-                if (l.link.front() == '#' || l.link.front() == '?') continue;
-                if (l.isInternalUrl() == false) continue;
-                if (l.link.empty())
-                {
-                    nremptylinks++;
-                    continue;
+                std::lock_guard<std::mutex> lock(mutex);
+                if (started) {
+                    return;
                 }
+                started = true;
+                loader = std::this_thread::get_id();
+            }
+            try {
+                content = load();
+            } catch (...) {
+                error = std::current_exception();
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                finished = true;
+            }
+            done.notify_all();
+        }
+    };
 
+    std::shared_ptr<Slot> slot;
+};
 
-                if (isOutofBounds(l.link, baseUrl))
-                {
-                    std::ostringstream ss;
-                    ss << l.link << " is out of bounds. Article: " << path;
-                    reporter.addReportMsg(TestType::URL_INTERNAL, ss.str());
-                    reporter.setTestResult(TestType::URL_INTERNAL, false);
-                    continue;
-                }
+/* The read ahead of the first cluster of the chunks: the thread checking a
+ * chunk starts it for the next chunk once it reaches its own last cluster,
+ * so the next chunk doesn't begin by waiting for a load. The first of the
+ * two threads asking for it creates it, so it is loaded only once.
+ */
+class ChunkReadAhead
+{
+  public:
+    ChunkReadAhead(ThreadPool& pool, const ArticleCheckContext& context, size_t chunkCount)
+      : pool(pool),
+        context(context),
+        taken(chunkCount, false)
+    {}
 
-                auto normalized = normalize_link(l.link, baseUrl);
-                filtered[normalized].push_back(l.link);
+    // Start loading the first cluster of `chunk` (entries [begin, end)).
+    void start(size_t chunk, zim::entry_index_type begin, zim::entry_index_type end)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!taken[chunk] && started.find(chunk) == started.end()) {
+            started.emplace(chunk, ClusterPrefetch(&pool, context, begin, end));
+        }
+    }
+
+    // The load of the first cluster of `chunk`, by the current thread if
+    // not started.
+    ClusterPrefetch take(size_t chunk, zim::entry_index_type begin, zim::entry_index_type end)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            taken[chunk] = true;
+            const auto it = started.find(chunk);
+            if (it != started.end()) {
+                ClusterPrefetch prefetch(std::move(it->second));
+                started.erase(it);
+                return prefetch;
             }
+        }
+        return ClusterPrefetch(nullptr, context, begin, end);
+    }
+
+  private:
+    ThreadPool& pool;
+    const ArticleCheckContext& context;
+    std::mutex mutex;
+    std::vector<bool> taken;
+    std::map<size_t, ClusterPrefetch> started;
+};
+
+// Compute what the checks need from the data of the article.
+// `linkSpans` is a buffer of the worker, reused for all its articles.
+void analyze_article(const ArticleCheckContext& context, ArticleContent& article,
+                     std::vector<LinkSpan>& linkSpans, Timings* timings)
+{
+    if (article.analyzed) {
+        return;
+    }
+    if (keep_all(context) || context.options.redundant_data) {
+        PhaseTimer timer(timings, Phase::REDUNDANCY, article.data.size(), 1);
+        article.contentHash = contentHash(article.data);
+    }
+    if (article.size != 0 && needs_links(context, article)) {
+        PhaseTimer timer(timings, Phase::LINK_EXTRACTION, article.data.size(), 1);
+        getLinkTable(article.data, article.links, linkSpans);
+        article.hasLinks = true;
+    }
+    if (keep_all(context) || context.options.mime_check) {
+        PhaseTimer timer(timings, Phase::MIME, 0, 1);
+        const std::string& head = article.data.empty() ? article.head : article.data;
+        article.sniffedMimetype = sniffMimetype(head.data(), std::min(head.size(), SNIFF_SIZE));
+    }
+    if (article.size != 0 && article.mimetype == "text/html"
+     && (keep_all(context) || context.options.near_duplicates)) {
+        PhaseTimer timer(timings, Phase::NEAR_DUPLICATES, article.data.size(), 1);
+        article.textSignature = textSignature(article.data);
+    }
+    article.analyzed = true;
+}
+
+// Identify the archive and the checks of a checkpoint (and if the clusters
+// are added to a cluster cache, saved with it).
+std::string get_checkpoint_id(const zim::Archive& archive, const ArticleCheckOptions& options,
+                              bool clusterCache)
+{
+    const auto uuid = archive.getUuid();
+    std::ostringstream id;
+    id << std::string(uuid.data, sizeof(uuid.data))
+       << archive.getEntryCount() << ' ' << ARTICLE_CHUNK_SIZE << ' '
+       << options.redundant_data << options.url_check
+       << options.url_check_external << options.empty_check << options.mime_check
+       << options.unreachable_check << (options.near_duplicates != 0) << clusterCache;
+    return id.str();
+}
 
-            if (nremptylinks)
+// Add what is known of the articles of `content` to the clusters to store.
+// A cluster may be loaded in several parts (if redirects are in the middle of
+// it), they are gathered in one ClusterInfo.
+void add_cluster_info(std::vector<std::pair<Hash128, ClusterInfo>>& clusters,
+                      const ClusterContent& content)
+{
+    if (clusters.empty() || clusters.back().first != content.hash) {
+        clusters.push_back(std::make_pair(content.hash, ClusterInfo()));
+    }
+    ClusterInfo& info = clusters.back().second;
+    for (const auto& article : content.articles) {
+        info.insert(std::make_pair(article.blob,
+            BlobInfo{article.size, article.contentHash, article.hasLinks, article.links,
+                     article.sniffedMimetype, article.textSignature}));
+    }
+}
+
+LinkTarget resolve_link(const ArticleCheckContext& context, const std::string& baseUrl,
+                        const char* link, size_t size, Timings* timings)
+{
+    PhaseTimer normalizationTimer(timings, Phase::NORMALIZATION, size, 1);
+    if (isOutofBounds(link, size, baseUrl)) {
+        return LinkTarget{true, false, std::string()};
+    }
+    auto normalized = normalize_link(link, size, baseUrl);
+    normalizationTimer.stop();
+    PhaseTimer lookupTimer(timings, Phase::LOOKUP, 0, 1);
+    const uint32_t entry = context.pathIndex.find(normalized);
+    return LinkTarget{false, entry != PathIndex::NOT_FOUND, std::move(normalized), entry};
+}
+
+void check_article(const ArticleCheckContext& context, const ArticleContent& article,
+                   ChunkResult& result)
+{
+    const ArticleCheckOptions& options = context.options;
+    ErrorLogger& reporter = result.reporter;
+    const std::string& path = article.path;
+    Timings* timings = context.timed ? &result.timings : nullptr;
+
+    if (options.unreachable_check && article.ns != 'X' && article.ns != 'W') {
+        result.items.push_back(std::make_pair(article.index, article.size));
+    }
+
+    if (options.empty_check && (article.ns == 'A' || article.ns == 'I')) {
+        if (article.size == 0) {
+            std::ostringstream ss;
+            ss << "Entry " << path << " is empty";
+            reporter.addReportMsg(TestType::EMPTY, ss.str());
+            reporter.setTestResult(TestType::EMPTY, false);
+        }
+    }
+
+    if (article.size == 0) {
+        return;
+    }
+
+    if(options.redundant_data)
+        result.contents.push_back(ContentRecord{article.contentHash, article.size, article.index,
+                                                result.currentSample});
+
+    if (options.mime_check && !isMimetypeCoherent(article.mimetype, article.sniffedMimetype)) {
+        std::ostringstream ss;
+        ss << "Entry " << path << " is declared as " << article.mimetype << " but its content ";
+        if (article.sniffedMimetype.empty()) {
+            ss << "has no signature of this type";
+        } else {
+            ss << "is " << article.sniffedMimetype;
+        }
+        reporter.addReportMsg(TestType::MIME, ss.str());
+        reporter.setTestResult(TestType::MIME, false);
+    }
+
+    if (article.mimetype != "text/html")
+        return;
+
+    if (options.near_duplicates && article.textSignature != 0) {
+        result.signatures.push_back(std::make_pair(article.textSignature, article.index));
+    }
+
+    // Both url checks read the same table, classified once.
+    const LinkTable& links = article.links;
+
+    if(options.url_check || options.unreachable_check)
+    {
+        auto baseUrl = path;
+        auto pos = baseUrl.find_last_of('/');
+        baseUrl.resize( pos==baseUrl.npos ? 0 : pos );
+
+        // The links not found, grouped by target.
+        std::unordered_map<std::string, std::vector<const LinkTable::Link*>> missing;
+        std::vector<uint32_t> targets;
+        int nremptylinks = 0;
+        for (const auto &l : links)
+        {
+            if (l.isInternalUrl() == false) continue;
+            if (l.size == 0)
             {
-                std::ostringstream ss;
-                ss << "Found " << nremptylinks << " empty links in article: " << path;
-                reporter.addReportMsg(TestType::URL_INTERNAL, ss.str());
-                reporter.setTestResult(TestType::URL_INTERNAL, false);
+                nremptylinks++;
+                continue;
             }
+            const char first = *links.data(l);
+            if (first == '#' || first == '?') continue;
 
-            for(const auto &p: filtered)
+            // The link is only copied in a string to be reported.
+            const char* const link = links.data(l);
+            LinkTarget target;
+            PhaseTimer cacheTimer(timings, Phase::LINK_CACHE, 0, 1);
+            const bool cached = context.linkCache.get(baseUrl, link, l.size, target);
+            cacheTimer.stop();
+            if (!cached) {
+                target = resolve_link(context, baseUrl, link, l.size, timings);
+                context.linkCache.put(baseUrl, link, l.size, target);
+            }
+
+            if (target.outOfBounds)
             {
-                const std::string link = p.first;
-                if (!archive.hasEntryByPath(link)) {
-                    int index = item.getIndex();
-                    if (previousIndex != index)
-                    {
-                        std::ostringstream ss;
-                        ss << "The following links:\n";
-                        for (const auto &olink : p.second)
-                            ss << "- " << olink << '\n';
-                        ss << "(" << link << ") were not found in article " << path;
-                        reporter.addReportMsg(TestType::URL_INTERNAL, ss.str());
-                        previousIndex = index;
-                    }
+                if (options.url_check) {
+                    std::ostringstream ss;
+                    ss << links.str(l) << " is out of bounds. Article: " << path;
+                    reporter.addReportMsg(TestType::URL_INTERNAL, ss.str());
                     reporter.setTestResult(TestType::URL_INTERNAL, false);
                 }
+                continue;
+            }
+
+            if (target.found) {
+                targets.push_back(target.entry);
+            } else {
+                missing[target.path].push_back(&l);
             }
         }
 
-        if (url_check_external)
+        if (options.unreachable_check) {
+            std::sort(targets.begin(), targets.end());
+            targets.erase(std::unique(targets.begin(), targets.end()), targets.end());
+            result.links.push_back(std::make_pair(article.index, std::move(targets)));
+        }
+
+        if (nremptylinks && options.url_check)
         {
-            for (const auto &l: links)
-            {
-                if (l.attribute == "src" && l.isExternalUrl())
-                {
-                    std::ostringstream ss;
-                    ss << l.link << " is an external dependence in article " << path;
-                    reporter.addReportMsg(TestType::URL_EXTERNAL, ss.str());
-                    reporter.setTestResult(TestType::URL_EXTERNAL, false);
-                    break;
-                }
-            }
+            std::ostringstream ss;
+            ss << "Found " << nremptylinks << " empty links in article: " << path;
+            reporter.addReportMsg(TestType::URL_INTERNAL, ss.str());
+            reporter.setTestResult(TestType::URL_INTERNAL, false);
+        }
+
+        // Only the first missing link of an article is detailed.
+        if (!missing.empty() && options.url_check)
+        {
+            const auto& p = *missing.begin();
+            std::ostringstream ss;
+            ss << "The following links:\n";
+            for (const auto olink : p.second)
+                ss << "- " << links.str(*olink) << '\n';
+            ss << "(" << p.first << ") were not found in article " << path;
+            reporter.addReportMsg(TestType::URL_INTERNAL, ss.str());
+            reporter.setTestResult(TestType::URL_INTERNAL, false);
         }
     }
 
-    if (redundant_data)
+    if (options.url_check_external)
     {
-        std::cout << "[INFO] Searching for redundant articles..." << std::endl;
-        std::cout << "  Verifying Similar Articles for redundancies..." << std::endl;
-        std::ostringstream output_details;
-        progress.reset(hash_main.size());
-        for(const auto &it: hash_main)
+        for (const auto &l: links)
         {
-            progress.report();
-            auto l = it.second;
-            while ( !l.empty() ) {
-                const auto e1 = archive.getEntryByPath(l.front());
-                l.pop_front();
-                if ( !l.empty() ) {
-                    // The way we have constructed `l`, e1 MUST BE an item
-                    const std::string s1 = e1.getItem().getData();
-                    decltype(l) articlesDifferentFromE1;
-                    for(auto other : l) {
-                        auto e2 = archive.getEntryByPath(other);
-                        std::string s2 = e2.getItem().getData();
-                        if (s1 != s2 ) {
-                            articlesDifferentFromE1.push_back(other);
-                            continue;
-                        }
-
-                        reporter.setTestResult(TestType::REDUNDANT, false);
-                        std::ostringstream ss;
-                        ss << e1.getTitle() << " (idx " << e1.getIndex() << ") and "
-                           << e2.getTitle() << " (idx " << e2.getIndex() << ")";
-                        reporter.addReportMsg(TestType::REDUNDANT, ss.str());
+            if (l.attribute == LinkAttribute::SRC && l.isExternalUrl())
+            {
+                std::ostringstream ss;
+                ss << links.str(l) << " is an external dependence in article " << path;
+                reporter.addReportMsg(TestType::URL_EXTERNAL, ss.str());
+                reporter.setTestResult(TestType::URL_EXTERNAL, false);
+                break;
+            }
+        }
+    }
+}
+
+void report_redundant(const zim::Archive& archive, zim::entry_index_type first,
+                      zim::entry_index_type other, ErrorLogger& reporter)
+{
+    const auto e1 = archive.getEntryByPath(first);
+    const auto e2 = archive.getEntryByPath(other);
+    reporter.setTestResult(TestType::REDUNDANT, false);
+    std::ostringstream ss;
+    ss << e1.getTitle() << " (idx " << e1.getIndex() << ") and "
+       << e2.getTitle() << " (idx " << e2.getIndex() << ")";
+    reporter.addReportMsg(TestType::REDUNDANT, ss.str());
+}
+
+// Unreachable items given in a message each.
+const size_t MAX_DESCRIBED_UNREACHABLE = 8;
+
+/* Report the items which cannot be reached from the main page (or the
+ * favicon) by following the links and the redirections.
+ * Their sizes are in the graph, only the entries described are read.
+ */
+void report_unreachable(const zim::Archive& archive, const PathIndex& pathIndex,
+                        LinkGraph& linkGraph, ErrorLogger& reporter)
+{
+    std::vector<uint32_t> roots;
+    if (archive.hasMainEntry()) {
+        // With the new namespace scheme, the main entry is the W/mainPage
+        // redirection, which is not a user entry (nor a node of the graph):
+        // start from the item it leads to.
+        try {
+            roots.push_back(archive.getMainEntry().getItem(true).getIndex());
+        } catch(...) {
+            // A broken main page is reported by the main page check.
+        }
+    }
+    // The user paths have no namespace with the new namespace scheme.
+    const bool withNamespace = !archive.hasNewNamespaceScheme();
+    static const char* const favicon_paths[] = {"-/favicon.png", "I/favicon.png", "I/favicon", "-/favicon"};
+    for (const auto path : favicon_paths) {
+        const uint32_t entry = pathIndex.find(withNamespace ? path : path + 2);
+        if (entry != PathIndex::NOT_FOUND) {
+            roots.push_back(entry);
+        }
+    }
+    if (roots.empty()) {
+        reporter.info() << "[INFO] No main page, the reachability of the entries is not checked" << std::endl;
+        return;
+    }
+    const size_t reachable = linkGraph.markReachable(roots);
+
+    std::vector<uint32_t> described;
+    size_t unreachableCount = 0;
+    uint64_t unreachableSize = 0;
+    for (uint32_t node = 0; node < linkGraph.nodeCount(); node++) {
+        if (linkGraph.isItem(node) && !linkGraph.isReachable(node)) {
+            if (described.size() < MAX_DESCRIBED_UNREACHABLE) {
+                described.push_back(node);
+            }
+            unreachableCount++;
+            unreachableSize += linkGraph.itemSize(node);
+        }
+    }
+    reporter.info() << "[INFO] Link graph: " << linkGraph.nodeCount() << " entries, "
+              << linkGraph.edgeCount() << " links (" << linkGraph.memoryUsage() / (1024 * 1024)
+              << " MB), " << reachable << " entries reachable from the main page" << std::endl;
+    if (unreachableCount == 0) {
+        return;
+    }
+    reporter.setTestResult(TestType::UNREACHABLE, false);
+    std::ostringstream summary;
+    summary << unreachableCount << " items (" << unreachableSize << " bytes) are not reachable from the main page";
+    reporter.addReportMsg(TestType::UNREACHABLE, summary.str());
+    for (const auto node : described) {
+        std::ostringstream ss;
+        ss << "Entry " << archive.getEntryByPath(node).getPath() << " (" << linkGraph.itemSize(node) << " bytes)";
+        reporter.addReportMsg(TestType::UNREACHABLE, ss.str());
+    }
+    if (unreachableCount > MAX_DESCRIBED_UNREACHABLE) {
+        std::ostringstream ss;
+        ss << "... and " << unreachableCount - MAX_DESCRIBED_UNREACHABLE << " other unreachable items";
+        reporter.addReportMsg(TestType::UNREACHABLE, ss.str());
+    }
+}
+
+// Paths given in the message of a group of near duplicates.
+const size_t MAX_DESCRIBED_NEAR_DUPLICATES = 8;
+
+/* Report the groups of html items with near texts, with their combined size.
+ */
+void report_near_duplicates(const zim::Archive& archive, const NearDuplicateFinder& finder,
+                            ErrorLogger& reporter)
+{
+    const auto groups = finder.findGroups();
+    size_t itemCount = 0;
+    for (const auto& group : groups) {
+        itemCount += group.size();
+    }
+    reporter.info() << "[INFO] Near duplicates: " << finder.size() << " texts compared (at most "
+              << finder.maxDistance() << " bits differing), " << itemCount << " items in "
+              << groups.size() << " groups" << std::endl;
+    for (const auto& group : groups) {
+        uint64_t size = 0;
+        std::ostringstream paths;
+        for (size_t i = 0; i < group.size(); i++) {
+            const auto entry = archive.getEntryByPath(group[i]);
+            size += entry.getItem().getSize();
+            if (i == MAX_DESCRIBED_NEAR_DUPLICATES) {
+                paths << ", ...";
+            } else if (i < MAX_DESCRIBED_NEAR_DUPLICATES) {
+                paths << (i ? ", " : "") << entry.getPath();
+            }
+        }
+        reporter.setTestResult(TestType::NEAR_DUPLICATE, false);
+        std::ostringstream ss;
+        ss << group.size() << " near duplicate items (" << size << " bytes): " << paths.str();
+        reporter.addReportMsg(TestType::NEAR_DUPLICATE, ss.str());
+    }
+}
+
+void report_estimates(const SampleEstimator& estimator, const ArticleCheckOptions& options,
+                      std::ostream& out)
+{
+    out << "[INFO] Sampled " << estimator.getClusterCount() << " clusters ("
+              << estimator.getItemCount() << " items). Estimated rate of items with errors"
+              << " (95% confidence interval):" << std::endl;
+    const std::pair<bool, TestType> checks[] = {
+        {options.empty_check, TestType::EMPTY},
+        {options.redundant_data, TestType::REDUNDANT},
+        {options.url_check, TestType::URL_INTERNAL},
+        {options.url_check_external, TestType::URL_EXTERNAL},
+        {options.mime_check, TestType::MIME}
+    };
+    for (const auto& check : checks) {
+        if (!check.first) {
+            continue;
+        }
+        const auto estimate = estimator.estimate(check.second);
+        out << "  " << testTypeToStr.at(check.second) << ": "
+                  << 100 * estimate.rate << "% [" << 100 * estimate.low << "%, "
+                  << 100 * estimate.high << "%] (" << estimate.failed << " items)" << std::endl;
+    }
+}
+
+// A sink dropping the findings: the logger only counts them.
+class CountingSink : public ReportSink
+{
+  public:
+    void addFinding(TestType, const std::string&) override {}
+    void finish(const ErrorLogger&) override {}
+};
+
+} // unnamed namespace
+
+void test_articles(const zim::Archive& archive, ErrorLogger& reporter, ProgressBar& progress,
+                   const ArticleCheckOptions& checkOptions, ClusterCache* cluster_cache,
+                   Checkpoint* checkpoint, ThreadPool* pool, const Sampling* sampling,
+                   Timings* timings) {
+    reporter.info() << "[INFO] Verifying Articles' content..." << std::endl;
+    PhaseTimer articlesTimer(timings, Phase::ARTICLES);
+    ArticleCheckOptions options = checkOptions;
+    if (sampling && options.unreachable_check) {
+        reporter.info() << "[INFO] The reachability of the entries is not checked on a sample" << std::endl;
+        options.unreachable_check = false;
+    }
+    if (sampling && options.near_duplicates) {
+        reporter.info() << "[INFO] The near duplicates are not searched on a sample" << std::endl;
+        options.near_duplicates = 0;
+    }
+    if (checkpoint && options.near_duplicates) {
+        reporter.info() << "[INFO] The near duplicates are not searched with checkpoints" << std::endl;
+        options.near_duplicates = 0;
+    }
+    if (checkpoint && options.cluster_stats) {
+        reporter.info() << "[INFO] The clusters are not described with checkpoints" << std::endl;
+        options.cluster_stats = false;
+    }
+    ArticleCheckContext context(
+        archive, options, cluster_cache, sampling, timings != nullptr,
+        options.max_memory ? std::min(LINK_CACHE_SIZE, options.max_memory / LINK_CACHE_MEMORY_SHARE / LINK_CACHE_ENTRY_MEMORY)
+                   : LINK_CACHE_SIZE);
+    SampleEstimator sampleEstimator(sampling ? sampling->percent / 100 : 1);
+    if (sampling) {
+        reporter.info() << "[INFO] Checking a sample of about " << sampling->percent
+                  << "% of the clusters (seed " << sampling->seed << ")" << std::endl;
+    }
+    if (cluster_cache) {
+        reporter.info() << "[INFO] Using a cluster cache of " << cluster_cache->size() << " clusters" << std::endl;
+        context.clusterHasher.reset(new ClusterHasher(archive));
+    }
+    if (options.cluster_stats) {
+        context.clusterStats.reset(new ClusterStats(archive));
+    }
+    size_t cachedClusters = 0;
+    size_t hashedClusters = 0;
+
+    if (options.url_check || options.unreachable_check) {
+        reporter.info() << "[INFO] Indexing the paths of the entries..." << std::endl;
+        const auto start = std::chrono::steady_clock::now();
+        PhaseTimer timer(timings, Phase::PATH_INDEX, 0, archive.getEntryCount());
+        context.pathIndex = PathIndex(archive);
+        timer.stop();
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        reporter.info() << "  " << context.pathIndex.size() << " paths indexed in "
+                  << duration.count() << " seconds ("
+                  << context.pathIndex.memoryUsage() / (1024 * 1024) << " MB)" << std::endl;
+    }
+
+    const zim::entry_index_type entryCount = archive.getEntryCount();
+    // The links between the entries, gathered in chunk order.
+    std::unique_ptr<LinkGraph> linkGraph;
+    if (options.unreachable_check) {
+        linkGraph.reset(new LinkGraph(entryCount));
+    }
+
+    // The contents are hashed by the workers and inserted here in chunk (and
+    // so cluster) order. A content is redundant if its hash is already known,
+    // no need to read the items again.
+    // The redundancy of a sample is always found in memory, to be estimated.
+    size_t redundancyMemory = 0;
+    if (options.max_memory && options.redundant_data && !sampling) {
+        const size_t used = context.pathIndex.memoryUsage() + (linkGraph ? linkGraph->memoryUsage() : 0);
+        redundancyMemory = std::max(MIN_REDUNDANCY_MEMORY,
+                                    (options.max_memory > used ? options.max_memory - used : 0) / REDUNDANCY_MEMORY_SHARE);
+        reporter.info() << "[INFO] Memory budget of the redundancy check: "
+                  << redundancyMemory / (1024 * 1024) << " MB" << std::endl;
+    }
+    RedundancyFinder redundancy(redundancyMemory);
+    // The signatures of the texts, gathered in chunk order.
+    NearDuplicateFinder nearDuplicates(options.near_duplicates);
+    ContentHashTable& contentHashes = redundancy.getTable();
+    const size_t chunkCount = (entryCount + ARTICLE_CHUNK_SIZE - 1) / ARTICLE_CHUNK_SIZE;
+    progress.reset(entryCount);
+    articlesTimer.addEntries(entryCount);
+
+    // With checkpoints, the findings of the article checks are also kept
+    // apart from the other ones, to be saved. With a sink, they reach it
+    // through `reporter`: only their counts (and the statuses) are kept and
+    // saved.
+    ErrorLogger articleReporter;
+    reporter.shareLimits(articleReporter);
+    CountingSink countingSink;
+    if (reporter.hasReportSink()) {
+        articleReporter.setReportSink(&countingSink);
+    }
+    std::string checkpointId;
+    uint64_t firstChunk = 0;
+    if (checkpoint) {
+        checkpointId = get_checkpoint_id(archive, context.options, cluster_cache != nullptr);
+        if (checkpoint->load(checkpointId, firstChunk, articleReporter, contentHashes,
+                             linkGraph.get(), cluster_cache)) {
+            firstChunk = std::min<uint64_t>(firstChunk, chunkCount);
+            reporter.info() << "[INFO] Resuming from the checkpoint (" << firstChunk << " of "
+                      << chunkCount << " chunks already checked)" << std::endl;
+            // The findings of the checkpoint were given to the sink by the
+            // interrupted run.
+            reporter.merge(articleReporter, false);
+            if (firstChunk > 0) {
+                progress.report(getChunkRange(archive, firstChunk - 1).second);
+            }
+        }
+    }
+    uint64_t nextChunk = firstChunk;
+
+    // This thread runs chunks too, it is one of the `thread_count` threads.
+    std::unique_ptr<ThreadPool> localPool;
+    if (!pool) {
+        localPool.reset(new ThreadPool(std::max(options.thread_count, 1U) - 1));
+        pool = localPool.get();
+    }
+    ChunkReadAhead readAhead(*pool, context, chunkCount - firstChunk);
+    runChunksInOrder<ChunkResult>(
+        *pool,
+        chunkCount - firstChunk,
+        [&](size_t chunk, ChunkResult& result) {
+            // The results of CHUNK_WINDOW chunks per thread are in memory.
+            reporter.shareLimits(result.reporter, chunkWindow(*pool));
+            reporter.shareFailFast(result.reporter);
+            if (result.reporter.isCancelled()) {
+                return;
+            }
+            if (context.timed) {
+                result.timings.addThread(std::this_thread::get_id());
+            }
+            const auto range = getChunkRange(archive, firstChunk + chunk);
+            if (range.first == range.second) {
+                return;
+            }
+            zim::cluster_index_type sampledCluster = NO_CLUSTER;
+            std::vector<LinkSpan> linkSpans;
+            // Read ahead: the next cluster is loaded (and decompressed) while
+            // the checks run on the current one.
+            ClusterPrefetch next = readAhead.take(chunk, range.first, range.second);
+            zim::entry_index_type begin = range.first;
+            while (true) {
+                ClusterContent cluster = next.get();
+                result.timings.merge(cluster.timings);
+                if (context.timed) {
+                    result.timings.addClusterLoad(cluster.readAhead);
+                }
+                for (const auto& redirect : cluster.redirects) {
+                    result.links.push_back(std::make_pair(redirect.first, std::vector<uint32_t>{redirect.second}));
+                }
+                if (cluster.record.blobCount) {
+                    result.clusterRecords.push_back(std::move(cluster.record));
+                }
+                if (cluster.end < range.second) {
+                    next = ClusterPrefetch(pool, context, cluster.end, range.second);
+                } else if (firstChunk + chunk + 1 < chunkCount && !result.reporter.isCancelled()) {
+                    const auto nextRange = getChunkRange(archive, firstChunk + chunk + 1);
+                    if (nextRange.first < nextRange.second) {
+                        readAhead.start(chunk + 1, nextRange.first, nextRange.second);
+                    }
+                }
+                ClusterSample* sample = nullptr;
+                if (context.sampling && cluster.cluster != NO_CLUSTER) {
+                    // A cluster may be loaded in several parts, see add_cluster_info.
+                    if (result.samples.empty() || sampledCluster != cluster.cluster) {
+                        result.samples.push_back(ClusterSample());
+                    }
+                    sampledCluster = cluster.cluster;
+                    sample = &result.samples.back();
+                    result.currentSample = result.samples.size() - 1;
+                }
+                // The entries of the cluster load which are not articles
+                // (redirects, metadata...).
+                progress.report(cluster.end - begin - cluster.articles.size());
+                begin = cluster.end;
+                for (auto& article : cluster.articles) {
+                    progress.report(1, article.size);
+                    analyze_article(context, article, linkSpans,
+                                    context.timed ? &result.timings : nullptr);
+                    if (!sample) {
+                        check_article(context, article, result);
+                        continue;
+                    }
+                    size_t before[TEST_TYPE_COUNT];
+                    for (const auto type : ITEM_TEST_TYPES) {
+                        before[size_t(type)] = result.reporter.getReportMsgCount(type);
                     }
-                    l.swap(articlesDifferentFromE1);
+                    check_article(context, article, result);
+                    sample->items++;
+                    for (const auto type : ITEM_TEST_TYPES) {
+                        sample->failed[size_t(type)] += result.reporter.getReportMsgCount(type) > before[size_t(type)];
+                    }
+                }
+                result.currentSample = NO_SAMPLE;
+                if (cluster.hashed) {
+                    const auto clusterCount = result.clusters.size();
+                    add_cluster_info(result.clusters, cluster);
+                    if (result.clusters.size() > clusterCount && cluster.fromCache) {
+                        result.cachedClusters++;
+                    }
+                }
+                if (cluster.end >= range.second || result.reporter.isCancelled()) {
+                    break;
+                }
+            }
+        },
+        [&](ChunkResult& result) {
+            PhaseTimer redundancyTimer(result.contents.empty() ? nullptr : timings, Phase::REDUNDANCY);
+            for (const auto& content : result.contents) {
+                if (reporter.isCancelled()) {
+                    break;
+                }
+                const auto first = redundancy.add(content.hash, content.size, content.index);
+                if (first != ContentHashTable::NO_ENTRY && first != RedundancyFinder::PENDING) {
+                    report_redundant(archive, first, content.index, result.reporter);
+                    if (content.sample != NO_SAMPLE) {
+                        result.samples[content.sample].failed[size_t(TestType::REDUNDANT)]++;
+                    }
+                }
+            }
+            redundancyTimer.stop();
+            for (const auto& sample : result.samples) {
+                sampleEstimator.addCluster(sample);
+            }
+            if (timings) {
+                timings->merge(result.timings);
+            }
+            if (linkGraph) {
+                for (const auto& links : result.links) {
+                    linkGraph->addEdges(links.first, links.second);
                 }
+                for (const auto& item : result.items) {
+                    linkGraph->addItem(item.first, item.second);
+                }
+            }
+            for (const auto& signature : result.signatures) {
+                nearDuplicates.add(signature.first, signature.second);
+            }
+            if (context.clusterStats) {
+                for (const auto& record : result.clusterRecords) {
+                    context.clusterStats->add(record);
+                }
+            }
+            reporter.merge(result.reporter);
+            for (const auto& cluster : result.clusters) {
+                cluster_cache->add(cluster.first, cluster.second);
             }
+            cachedClusters += result.cachedClusters;
+            hashedClusters += result.clusters.size();
+            nextChunk++;
+            if (checkpoint) {
+                articleReporter.merge(result.reporter);
+                // Once cancelled, the chunks are not completely checked.
+                if (nextChunk < chunkCount && checkpoint->isDue() && !reporter.isCancelled()) {
+                    checkpoint->save(checkpointId, nextChunk, articleReporter, contentHashes,
+                                     linkGraph.get(), cluster_cache);
+                }
+            }
+        });
+
+    progress.finish();
+    if (reporter.isCancelled()) {
+        reporter.info() << "[INFO] Article checks stopped at the first error (fail fast)" << std::endl;
+    } else if (checkpoint) {
+        checkpoint->finish();
+        reporter.info() << "[INFO] Checkpoints: " << checkpoint->getSaveCount() << " written ("
+                  << checkpoint->getOverhead() << "% of the time)" << std::endl;
+    }
+
+    if (redundancy.isSpilling() && !reporter.isCancelled()) {
+        reporter.info() << "[INFO] Redundancy check: " << redundancy.spilledCount()
+                  << " contents sorted on disk" << std::endl;
+        PhaseTimer timer(timings, Phase::REDUNDANCY);
+        redundancy.finish([&](zim::entry_index_type first, zim::entry_index_type other) {
+            report_redundant(archive, first, other, reporter);
+        });
+    }
+    if (linkGraph && !reporter.isCancelled()) {
+        report_unreachable(archive, context.pathIndex, *linkGraph, reporter);
+    }
+    const size_t unbounded = context.pathIndex.memoryUsage() + (linkGraph ? linkGraph->memoryUsage() : 0);
+    if (options.max_memory && unbounded > options.max_memory) {
+        reporter.info() << "[WARNING] The path index and the link graph take " << unbounded / 1024
+                  << " KB, more than the memory budget (" << options.max_memory / 1024 << " KB)" << std::endl;
+    }
+    if (options.near_duplicates && !reporter.isCancelled()) {
+        PhaseTimer timer(timings, Phase::NEAR_DUPLICATES);
+        report_near_duplicates(archive, nearDuplicates, reporter);
+    }
+    if (sampling && !reporter.isCancelled()) {
+        report_estimates(sampleEstimator, context.options, reporter.info());
+    }
+    if (context.clusterStats && !reporter.isCancelled()) {
+        context.clusterStats->finish();
+        context.clusterStats->report(reporter.info());
+    }
+    if (cluster_cache) {
+        reporter.info() << "[INFO] Cluster cache: " << cachedClusters << " clusters reused on "
+                  << hashedClusters << std::endl;
+    }
+    if (options.url_check) {
+        const uint64_t hits = context.linkCache.hits();
+        const uint64_t lookups = hits + context.linkCache.misses();
+        reporter.info() << "[INFO] Link cache: " << hits << " hits on " << lookups << " lookups ("
+                  << (lookups ? 100 * hits / lookups : 0) << "%)" << std::endl;
+    }
+}
+
+
+namespace
+{
+
+// The title index is checked by chunks of consecutive positions.
+const uint32_t TITLE_CHUNK_SIZE = 1 << 16;
+// Only the first errors of the title index are detailed, the other ones are counted.
+const size_t MAX_DESCRIBED_TITLE_ERRORS = 8;
+
+// The order of the title index: by namespace, then by title (the path if
+// there is no title), compared byte by byte.
+struct TitleKey
+{
+    char ns;
+    const char* text;
+    size_t size;
+};
+
+bool get_title_key(const DirentScanner& scanner, uint32_t entry, TitleKey& key)
+{
+    DirentView dirent;
+    if (!scanner.get(entry, dirent)) {
+        return false;
+    }
+    key.ns = dirent.ns;
+    key.text = dirent.titleSize ? dirent.title : dirent.path;
+    key.size = dirent.titleSize ? dirent.titleSize : dirent.pathSize;
+    return true;
+}
+
+bool title_less(const TitleKey& a, const TitleKey& b)
+{
+    if (a.ns != b.ns) {
+        return uint8_t(a.ns) < uint8_t(b.ns);
+    }
+    const int c = std::memcmp(a.text, b.text, std::min(a.size, b.size));
+    return c != 0 ? c < 0 : a.size < b.size;
+}
+
+std::string describe_title(uint32_t entry, const TitleKey& key)
+{
+    std::ostringstream ss;
+    ss << "\"" << key.ns << "/" << std::string(key.text, key.size) << "\" (#" << entry << ")";
+    return ss.str();
+}
+
+// What a worker finds in a chunk of the title index.
+struct TitleChunkResult
+{
+    std::vector<std::string> errors; // The first ones only.
+    size_t errorCount = 0;
+
+    void add(const std::string& error) {
+        if (errors.size() < MAX_DESCRIBED_TITLE_ERRORS) {
+            errors.push_back(error);
+        }
+        errorCount++;
+    }
+};
+
+// Check the order of the positions [begin, end) of the title index (the
+// first one against the one before it).
+void check_title_chunk(const DirentScanner& scanner, uint32_t begin, uint32_t end,
+                       TitleChunkResult& result)
+{
+    TitleKey previous, current;
+    uint32_t previousEntry = 0;
+    bool hasPrevious = false;
+    if (begin > 0) {
+        previousEntry = scanner.titleEntry(begin - 1);
+        hasPrevious = previousEntry < scanner.entryCount()
+                   && get_title_key(scanner, previousEntry, previous);
+    }
+    for (uint32_t position = begin; position < end; position++) {
+        const uint32_t entry = scanner.titleEntry(position);
+        if (entry >= scanner.entryCount() || !get_title_key(scanner, entry, current)) {
+            std::ostringstream ss;
+            ss << "Title index position " << position << " points to a missing entry #" << entry;
+            result.add(ss.str());
+            hasPrevious = false;
+            continue;
+        }
+        if (hasPrevious && title_less(current, previous)) {
+            std::ostringstream ss;
+            ss << "Title index not sorted at position " << position << ": "
+               << describe_title(previousEntry, previous) << " before "
+               << describe_title(entry, current);
+            result.add(ss.str());
+        }
+        previous = current;
+        previousEntry = entry;
+        hasPrevious = true;
+    }
+}
+
+// Report the errors of the title index: the first ones only, then their count.
+class TitleErrorReporter
+{
+  public:
+    explicit TitleErrorReporter(ErrorLogger& reporter)
+      : reporter(reporter), errorCount(0) {}
+
+    void add(const TitleChunkResult& result) {
+        for (const auto& error : result.errors) {
+            if (errorCount < MAX_DESCRIBED_TITLE_ERRORS) {
+                reporter.addReportMsg(TestType::TITLE_INDEX, error);
+            }
+            errorCount++;
+        }
+        errorCount += result.errorCount - result.errors.size();
+    }
+
+    void finish() {
+        if (errorCount) {
+            reporter.setTestResult(TestType::TITLE_INDEX, false);
+        }
+        if (errorCount > MAX_DESCRIBED_TITLE_ERRORS) {
+            std::ostringstream ss;
+            ss << "... and " << errorCount - MAX_DESCRIBED_TITLE_ERRORS << " other errors in the title index";
+            reporter.addReportMsg(TestType::TITLE_INDEX, ss.str());
+        }
+    }
+
+  private:
+    ErrorLogger& reporter;
+    size_t errorCount;
+};
+
+// Each entry must be listed once in the title index.
+void report_title_listing(ErrorLogger& reporter, uint64_t twice, uint64_t missing)
+{
+    if (twice) {
+        reporter.setTestResult(TestType::TITLE_INDEX, false);
+        std::ostringstream ss;
+        ss << twice << " entries listed several times in the title index";
+        reporter.addReportMsg(TestType::TITLE_INDEX, ss.str());
+    }
+    if (missing) {
+        reporter.setTestResult(TestType::TITLE_INDEX, false);
+        std::ostringstream ss;
+        ss << missing << " entries missing from the title index";
+        reporter.addReportMsg(TestType::TITLE_INDEX, ss.str());
+    }
+}
+
+// The title index read through libzim, when the file is not mapped (a split
+// archive, or Windows): the same checks, on this thread only.
+void check_title_index_with_libzim(const zim::Archive& archive, ErrorLogger& reporter)
+{
+    const uint32_t entryCount = archive.getEntryCount();
+    // The entries listed, in title order.
+    std::vector<uint32_t> entries;
+    entries.reserve(entryCount);
+    TitleChunkResult result;
+    std::string previousTitle;
+    TitleKey previous;
+    uint32_t previousEntry = 0;
+    bool hasPrevious = false;
+    for (uint32_t position = 0; position < entryCount; position++) {
+        uint32_t entryIndex;
+        std::string path, title;
+        try {
+            const auto entry = archive.getEntryByTitle(position);
+            entryIndex = entry.getIndex();
+            path = entry.getPath();
+            title = entry.getTitle();
+        } catch (const std::exception& e) {
+            std::ostringstream ss;
+            ss << "Title index position " << position << " points to a missing entry (" << e.what() << ")";
+            result.add(ss.str());
+            hasPrevious = false;
+            continue;
+        }
+        entries.push_back(entryIndex);
+        TitleKey current;
+        current.ns = path.empty() ? '\0' : path[0];
+        current.text = title.data();
+        current.size = title.size();
+        if (hasPrevious && title_less(current, previous)) {
+            std::ostringstream ss;
+            ss << "Title index not sorted at position " << position << ": "
+               << describe_title(previousEntry, previous) << " before "
+               << describe_title(entryIndex, current);
+            result.add(ss.str());
+        }
+        previousTitle.swap(title);
+        previous = current;
+        previous.text = previousTitle.data();
+        previousEntry = entryIndex;
+        hasPrevious = true;
+    }
+    TitleErrorReporter errors(reporter);
+    errors.add(result);
+    errors.finish();
+
+    // The entry indexes (from libzim) may not start at 0: count the distinct ones.
+    std::sort(entries.begin(), entries.end());
+    const uint64_t listed = entries.size();
+    entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+    report_title_listing(reporter, listed - entries.size(), entryCount - entries.size());
+}
+
+} // unnamed namespace
+
+void test_title_index(const zim::Archive& archive, ErrorLogger& reporter,
+                      unsigned int thread_count, ThreadPool* pool)
+{
+    reporter.info() << "[INFO] Checking the title index..." << std::endl;
+    // Only the dirents are read, directly from the file if possible.
+    const DirentScanner scanner(archive);
+    if (!scanner.isOpen()) {
+        reporter.info() << "[INFO] The zim file is not mapped (" << scanner.error()
+                        << "), the title index is read through libzim." << std::endl;
+        check_title_index_with_libzim(archive, reporter);
+        return;
+    }
+    if (!scanner.hasTitleIndex()) {
+        reporter.setTestResult(TestType::TITLE_INDEX, false);
+        reporter.addReportMsg(TestType::TITLE_INDEX, "The title index is out of the file");
+        return;
+    }
+
+    const uint32_t entryCount = scanner.entryCount();
+    // This thread runs chunks too, it is one of the `thread_count` threads.
+    std::unique_ptr<ThreadPool> localPool;
+    if (!pool) {
+        localPool.reset(new ThreadPool(std::max(thread_count, 1U) - 1));
+        pool = localPool.get();
+    }
+    TitleErrorReporter errors(reporter);
+    runChunksInOrder<TitleChunkResult>(
+        *pool,
+        (uint64_t(entryCount) + TITLE_CHUNK_SIZE - 1) / TITLE_CHUNK_SIZE,
+        [&](size_t chunk, TitleChunkResult& result) {
+            const uint32_t begin = chunk * TITLE_CHUNK_SIZE;
+            const uint32_t end = std::min<uint64_t>(uint64_t(begin) + TITLE_CHUNK_SIZE, entryCount);
+            check_title_chunk(scanner, begin, end, result);
+        },
+        [&](TitleChunkResult& result) { errors.add(result); });
+    errors.finish();
+
+    std::vector<bool> listed(entryCount);
+    uint64_t twice = 0;
+    for (uint32_t position = 0; position < entryCount; position++) {
+        const uint32_t entry = scanner.titleEntry(position);
+        if (entry < entryCount) {
+            twice += listed[entry];
+            listed[entry] = true;
         }
     }
+    report_title_listing(reporter, twice, std::count(listed.begin(), listed.end(), false));
 }
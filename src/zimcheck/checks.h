@@ -2,9 +2,15 @@
 #define _ZIM_TOOL_ZIMFILECHECKS_H_
 
 #include <unordered_map>
+#include <map>
+#include <set>
+#include <atomic>
+#include <string>
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <functional>
+#include <memory>
 
 #include "../progress.h"
 
@@ -12,6 +18,13 @@ namespace zim {
   class Archive;
 }
 
+class ClusterCache;
+class Checkpoint;
+class TemporaryFile;
+class ThreadPool;
+struct Sampling;
+class Timings;
+
 enum StatusCode : int {
    PASS = 0,
    FAIL = 1,
@@ -27,8 +40,7 @@ namespace std {
   };
 }
 
-static std::unordered_map<LogTag, std::string> tagToStr{ {LogTag::ERROR,     "ERROR"},
-                                                         {LogTag::WARNING,   "WARNING"}};
+extern const std::unordered_map<LogTag, std::string> tagToStr;
 
 enum class TestType {
     CHECKSUM,
@@ -41,6 +53,11 @@ enum class TestType {
     URL_INTERNAL,
     URL_EXTERNAL,
     MIME,
+    UNREACHABLE,
+    REDIRECT,
+    REDIRECT_CHAIN,
+    NEAR_DUPLICATE,
+    TITLE_INDEX,
     OTHER
 };
 
@@ -51,27 +68,63 @@ namespace std {
   };
 }
 
-static std::unordered_map<TestType, std::pair<LogTag, std::string>> errormapping = {
-    { TestType::CHECKSUM,      {LogTag::ERROR, "Invalid checksum"}},
-    { TestType::INTEGRITY,     {LogTag::ERROR, "Invalid low-level structure"}},
-    { TestType::EMPTY,         {LogTag::ERROR, "Empty articles"}},
-    { TestType::METADATA,      {LogTag::ERROR, "Missing metadata entries"}},
-    { TestType::FAVICON,       {LogTag::ERROR, "Missing favicon"}},
-    { TestType::MAIN_PAGE,     {LogTag::ERROR, "Missing mainpage"}},
-    { TestType::REDUNDANT,     {LogTag::WARNING, "Redundant data found"}},
-    { TestType::URL_INTERNAL,  {LogTag::ERROR, "Invalid internal links found"}},
-    { TestType::URL_EXTERNAL,  {LogTag::ERROR, "Invalid external links found"}},
-    { TestType::MIME,       {LogTag::ERROR, "Incoherent mimeType found"}},
-    { TestType::OTHER,      {LogTag::ERROR, "Other errors found"}}
+// The level and the title of the report of each test.
+extern const std::unordered_map<TestType, std::pair<LogTag, std::string>> errormapping;
+// The name of each test (in the options and the JSON report).
+extern const std::unordered_map<TestType, std::string> testTypeToStr;
+
+class ErrorLogger;
+
+// Shared flag asking all the checks to stop as soon as possible (see --fail-fast).
+class CancellationToken {
+  public:
+    void cancel() { cancelled = true; }
+    void reset() { cancelled = false; }
+    bool isCancelled() const { return cancelled; }
+
+  private:
+    std::atomic<bool> cancelled{false};
+};
+
+// Receive the findings as soon as they are added to the (main) ErrorLogger.
+class ReportSink {
+  public:
+    virtual ~ReportSink() = default;
+    virtual void addFinding(TestType type, const std::string& message) = 0;
+    // Called once all the checks are done.
+    virtual void finish(const ErrorLogger& logger) = 0;
 };
 
 class ErrorLogger {
   private:
-    std::unordered_map<TestType, std::vector<std::string>> reportMsgs;
+    // Ordered by TestType, so the report doesn't depend on the order the messages are added.
+    std::map<TestType, std::vector<std::string>> reportMsgs;
+    // Number of messages not kept because of maxReportMsgs.
+    std::map<TestType, size_t> droppedMsgs;
+    // Number of messages only given to the sink.
+    std::map<TestType, size_t> streamedMsgs;
+    // The oldest messages, moved to temporary files to keep the memory used
+    // by the messages under maxMsgMemory.
+    std::map<TestType, std::shared_ptr<TemporaryFile>> spilledMsgs;
+    std::map<TestType, size_t> spilledMsgCounts;
+    size_t msgMemory;
+    size_t maxMsgMemory; // 0 means no limit.
     std::unordered_map<TestType, bool> testStatus;
+    size_t maxReportMsgs; // Per test type. 0 means no limit.
+    ReportSink* sink;
+    std::ostream* output;
+    // Cancelled as soon as one of the failFastTypes fails.
+    CancellationToken* cancellation;
+    std::set<TestType> failFastTypes;
 
   public:
     ErrorLogger()
+      : msgMemory(0),
+        maxMsgMemory(0),
+        maxReportMsgs(0),
+        sink(nullptr),
+        output(&std::cout),
+        cancellation(nullptr)
     {
         for (const auto &m : errormapping) {
             testStatus[m.first] = true;
@@ -80,26 +133,177 @@ class ErrorLogger {
 
     void setTestResult(TestType type, bool status) {
         testStatus[type] = status;
+        if (!status && cancellation && failFastTypes.count(type)) {
+            cancellation->cancel();
+        }
+    }
+
+    bool getTestResult(TestType type) const {
+        return testStatus.at(type);
+    }
+
+    // Keep at most `max` messages per test type in memory (and only count the
+    // other ones), so the memory doesn't depend on the number of errors.
+    void setMaxReportMsgs(size_t max) {
+        maxReportMsgs = max;
+    }
+
+    size_t getMaxReportMsgs() const {
+        return maxReportMsgs;
+    }
+
+    // Keep about `bytes` of messages in memory at most, move the other ones
+    // to temporary files (0 for no limit).
+    void setMaxMsgMemory(size_t bytes) {
+        maxMsgMemory = bytes;
+    }
+
+    // Give all the messages to `reportSink` as they are added. They are then
+    // only counted, none is kept in memory.
+    void setReportSink(ReportSink* reportSink) {
+        sink = reportSink;
+    }
+
+    bool hasReportSink() const {
+        return sink != nullptr;
+    }
+
+    // Print the progress of the checks (the [INFO] lines) on `out` (nullptr
+    // to discard it), std::cout by default.
+    void setOutput(std::ostream* out) {
+        output = out;
+    }
+
+    std::ostream& info() const;
+
+    // Cancel `token` at the first failure of one of the (error level) `types`.
+    void setFailFast(CancellationToken* token, const std::set<TestType>& types) {
+        cancellation = token;
+        failFastTypes = types;
+    }
+
+    // Give the fail fast settings to `other` (the logger of a worker thread).
+    void shareFailFast(ErrorLogger& other) const {
+        other.setFailFast(cancellation, failFastTypes);
+    }
+
+    // Give the limits to `other` (the logger of a worker thread, merged into
+    // this one), with a part of the memory of the messages if `shares`
+    // loggers are used at the same time. With a sink, all the messages must
+    // reach it: none is dropped.
+    void shareLimits(ErrorLogger& other, size_t shares = 1) const {
+        other.setMaxReportMsgs(sink ? 0 : maxReportMsgs);
+        other.setMaxMsgMemory(maxMsgMemory ? std::max<size_t>(1, maxMsgMemory / shares) : 0);
+    }
+
+    bool isCancelled() const {
+        return cancellation && cancellation->isCancelled();
     }
 
     void addReportMsg(TestType type, const std::string& message) {
-        reportMsgs[type].push_back(message);
+        auto& msgs = reportMsgs[type];
+        if (sink) {
+            sink->addFinding(type, message);
+            streamedMsgs[type]++;
+            return;
+        }
+        if (maxReportMsgs && msgs.size() + getSpilledMsgCount(type) >= maxReportMsgs) {
+            droppedMsgs[type]++;
+            return;
+        }
+        msgs.push_back(message);
+        msgMemory += sizeof(std::string) + message.capacity();
+        if (maxMsgMemory && msgMemory > maxMsgMemory) {
+            spillMsgs();
+        }
     }
 
+    size_t getReportMsgCount(TestType type) const {
+        auto it = reportMsgs.find(type);
+        return (it == reportMsgs.end() ? 0 : it->second.size()) + getSpilledMsgCount(type)
+             + getDroppedMsgCount(type) + getStreamedMsgCount(type);
+    }
+
+    size_t getSpilledMsgCount(TestType type) const {
+        auto it = spilledMsgCounts.find(type);
+        return it == spilledMsgCounts.end() ? 0 : it->second;
+    }
+
+    // Call `f` on the messages of `type` (the spilled ones included), in order.
+    void forEachReportMsg(TestType type, const std::function<void(const std::string&)>& f) const;
+
+    size_t getDroppedMsgCount(TestType type) const {
+        auto it = droppedMsgs.find(type);
+        return it == droppedMsgs.end() ? 0 : it->second;
+    }
+
+    size_t getStreamedMsgCount(TestType type) const {
+        auto it = streamedMsgs.find(type);
+        return it == streamedMsgs.end() ? 0 : it->second;
+    }
+
+    // Add the messages and the failures of `other` (the logger of a worker thread).
+    // With `toSink` false, the messages already reached the sink (they are
+    // restored from a checkpoint): they are only counted if there is one.
+    void merge(const ErrorLogger& other, bool toSink = true) {
+        for (const auto& testmsg : other.reportMsgs) {
+            if (sink && !toSink) {
+                const auto count = other.getReportMsgCount(testmsg.first)
+                                 - other.getDroppedMsgCount(testmsg.first)
+                                 - other.getStreamedMsgCount(testmsg.first);
+                reportMsgs[testmsg.first];
+                streamedMsgs[testmsg.first] += count;
+                continue;
+            }
+            other.forEachReportMsg(testmsg.first, [&](const std::string& msg) {
+                addReportMsg(testmsg.first, msg);
+            });
+        }
+        for (const auto& dropped : other.droppedMsgs) {
+            droppedMsgs[dropped.first] += dropped.second;
+        }
+        for (const auto& streamed : other.streamedMsgs) {
+            reportMsgs[streamed.first];
+            streamedMsgs[streamed.first] += streamed.second;
+        }
+        for (const auto& status : other.testStatus) {
+            if (!status.second) {
+                testStatus[status.first] = false;
+            }
+        }
+    }
+
+    // Write the logger to (or replace it by the one read from) a checkpoint.
+    // The messages read are not sent to the sink.
+    void save(std::ostream& out) const;
+    void load(std::istream& in);
+
     void report(bool error_details) const {
-        for (auto testmsg : reportMsgs) {
-                auto &p = errormapping[testmsg.first];
-                std::cout << "[" + tagToStr[p.first] + "] " << p.second << ":" << std::endl;
-                for (auto& msg: testmsg.second) {
+        for (const auto& testmsg : reportMsgs) {
+                auto &p = errormapping.at(testmsg.first);
+                std::cout << "[" + tagToStr.at(p.first) + "] " << p.second << ":" << std::endl;
+                forEachReportMsg(testmsg.first, [](const std::string& msg) {
                     std::cout << "  " << msg << std::endl;
+                });
+                const auto dropped = getDroppedMsgCount(testmsg.first);
+                if (dropped) {
+                    std::cout << "  ... and " << dropped << " more" << std::endl;
+                }
+                const auto streamed = getStreamedMsgCount(testmsg.first);
+                if (streamed) {
+                    std::cout << "  " << streamed << " messages streamed out (not kept in this report)" << std::endl;
                 }
         }
     }
 
+  private:
+    void spillMsgs();
+
+  public:
     inline bool overalStatus() const {
         return std::all_of(testStatus.begin(), testStatus.end(),
                            [](std::pair<TestType, bool> e){
-                                    if (errormapping[e.first].first == LogTag::ERROR)
+                                    if (errormapping.at(e.first).first == LogTag::ERROR)
                                     {
                                         return e.second; //return the test status result
                                     }
@@ -109,12 +313,51 @@ class ErrorLogger {
 };
 
 
-void test_checksum(zim::Archive& archive, ErrorLogger& reporter);
-void test_integrity(const std::string& filename, ErrorLogger& reporter);
+void test_checksum(const zim::Archive& archive, ErrorLogger& reporter);
+// The checksum is computed at the same time on `pool` (or on a thread of
+// its own if `thread_count` is more than 1).
+void test_integrity(const std::string& filename, ErrorLogger& reporter,
+                    unsigned int thread_count = 1, ThreadPool* pool = nullptr);
 void test_metadata(const zim::Archive& archive, ErrorLogger& reporter);
 void test_favicon(const zim::Archive& archive, ErrorLogger& reporter);
 void test_mainpage(const zim::Archive& archive, ErrorLogger& reporter);
-void test_articles(const zim::Archive& archive, ErrorLogger& reporter, ProgressBar progress,
-                   bool redundant_data, bool url_check, bool url_check_external, bool empty_check);
+// Report the redirection loops, the redirections to missing entries and the
+// chains of more than `max_chain_length` redirections.
+void test_redirects(const zim::Archive& archive, ErrorLogger& reporter, unsigned int max_chain_length);
+// Report the entries of the title index out of order or out of the entries,
+// and the entries listed twice (or not at all). The index is read directly
+// from the file, by chunks checked by `thread_count` threads (or on `pool`).
+void test_title_index(const zim::Archive& archive, ErrorLogger& reporter,
+                      unsigned int thread_count = 1, ThreadPool* pool = nullptr);
+// The article checks to run (see test_articles), and how.
+struct ArticleCheckOptions
+{
+    bool redundant_data = false;
+    bool url_check = false;
+    bool url_check_external = false;
+    bool empty_check = false;
+    bool mime_check = false;
+    bool unreachable_check = false;
+    // The similarity above which the html items are reported as near
+    // duplicates (0 to skip this check).
+    double near_duplicates = 0;
+    // Print how the clusters are compressed (see ClusterStats).
+    bool cluster_stats = false;
+    unsigned int thread_count = 1;
+    // Bounds the memory of the redundancy check (spilled to disk once
+    // reached), of the messages of the workers and of the link cache (0 for
+    // no limit). The path index and the link graph are needed whole: they
+    // are not bounded, only taken out of the budget of the redundancy check.
+    size_t max_memory = 0;
+};
+
+// Run the article checks on `pool` (if given). Reuse the clusters of
+// `cluster_cache` and save the progress to `checkpoint` (if given). Only
+// check the clusters of `sampling` (if given). Measure the time of the
+// phases in `timings` (if given).
+void test_articles(const zim::Archive& archive, ErrorLogger& reporter, ProgressBar& progress,
+                   const ArticleCheckOptions& options, ClusterCache* cluster_cache = nullptr,
+                   Checkpoint* checkpoint = nullptr, ThreadPool* pool = nullptr,
+                   const Sampling* sampling = nullptr, Timings* timings = nullptr);
 
 #endif
@@ -0,0 +1,244 @@
+#define ZIM_PRIVATE
+#include "clustercache.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <iostream>
+#include <cstdio>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <zim/archive.h>
+
+namespace
+{
+
+const char CACHE_MAGIC[] = "zimcheck-cluster-cache-3\n";
+
+// 0xffffffff as link count means "links not extracted".
+const uint32_t NO_LINKS = uint32_t(-1);
+
+// Read a cluster record (after its hash). No string of the record can be
+// longer than the `remaining` bytes of the file.
+ClusterInfo readClusterInfo(std::istream& in, uint64_t remaining)
+{
+    ClusterInfo info;
+    const auto blobCount = readValue<uint32_t>(in);
+    for (uint32_t i = 0; i < blobCount; i++) {
+        const auto blobIndex = readValue<zim::blob_index_type>(in);
+        BlobInfo blob;
+        blob.size = readValue<uint64_t>(in);
+        blob.hash.low = readValue<uint64_t>(in);
+        blob.hash.high = readValue<uint64_t>(in);
+        blob.sniffedMimetype = readString(in, remaining);
+        blob.textSignature = readValue<uint64_t>(in);
+        const auto linkCount = readValue<uint32_t>(in);
+        blob.hasLinks = (linkCount != NO_LINKS);
+        for (uint32_t l = 0; blob.hasLinks && l < linkCount; l++) {
+            const auto attribute = readString(in, remaining);
+            const auto link = readString(in, remaining);
+            blob.links.add(attribute == "src" ? LinkAttribute::SRC : LinkAttribute::HREF,
+                           link.data(), link.size());
+        }
+        info.insert(std::make_pair(blobIndex, std::move(blob)));
+    }
+    return info;
+}
+
+// Copy `size` bytes of `in` to `out`.
+void copyBytes(std::istream& in, std::ostream& out, uint64_t size)
+{
+    char buffer[64 * 1024];
+    while (size > 0) {
+        const auto n = std::min<uint64_t>(size, sizeof(buffer));
+        in.read(buffer, n);
+        if (!in) {
+            throw std::runtime_error("Cannot read the clusters of the checkpoint");
+        }
+        out.write(buffer, n);
+        size -= n;
+    }
+}
+
+} // unnamed namespace
+
+ClusterHasher::ClusterHasher(const zim::Archive& archive)
+#ifndef _WIN32
+  : fd(-1)
+#endif
+{
+    if (archive.isMultiPart()) {
+        return;
+    }
+#ifdef _WIN32
+    file.open(archive.getFilename(), std::ios::binary);
+    if (!file) {
+        return;
+    }
+#else
+    fd = open(archive.getFilename().c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+#endif
+
+    const auto clusterCount = archive.getClusterCount();
+    offsets.resize(clusterCount);
+    sizes.resize(clusterCount, 0);
+    std::vector<zim::cluster_index_type> byOffset(clusterCount);
+    for (zim::cluster_index_type i = 0; i < clusterCount; i++) {
+        offsets[i] = archive.getClusterOffset(i);
+        byOffset[i] = i;
+    }
+    std::sort(byOffset.begin(), byOffset.end(),
+              [&](zim::cluster_index_type a, zim::cluster_index_type b) { return offsets[a] < offsets[b]; });
+    for (size_t i = 0; i + 1 < byOffset.size(); i++) {
+        sizes[byOffset[i]] = offsets[byOffset[i+1]] - offsets[byOffset[i]];
+    }
+}
+
+ClusterHasher::~ClusterHasher()
+{
+#ifndef _WIN32
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
+
+zim::size_type ClusterHasher::size(zim::cluster_index_type cluster) const
+{
+    return cluster < sizes.size() ? sizes[cluster] : 0;
+}
+
+bool ClusterHasher::hash(zim::cluster_index_type cluster, Hash128& hash) const
+{
+    if (size(cluster) == 0) {
+        return false;
+    }
+    std::vector<char> buffer(sizes[cluster]);
+#ifdef _WIN32
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        file.clear();
+        file.seekg(offsets[cluster]);
+        file.read(buffer.data(), buffer.size());
+        if (!file) {
+            return false;
+        }
+    }
+#else
+    size_t done = 0;
+    while (done < buffer.size()) {
+        const auto r = pread(fd, buffer.data() + done, buffer.size() - done, offsets[cluster] + done);
+        if (r <= 0) {
+            return false;
+        }
+        done += r;
+    }
+#endif
+    hash = hash128(buffer.data(), buffer.size(), buffer.size());
+    return true;
+}
+
+ClusterCache::ClusterCache(const std::string& path)
+  : path(path),
+    previousSize(0)
+{
+    previous.open(path, std::ios::binary);
+    if (previous) {
+        previous.seekg(0, std::ios::end);
+        previousSize = previous.tellg();
+        previous.seekg(0);
+        std::string magic(sizeof(CACHE_MAGIC) - 1, '\0');
+        previous.read(&magic[0], magic.size());
+        if (!previous || magic != CACHE_MAGIC) {
+            std::cerr << "[WARNING] " << path << " is not a cluster cache, ignoring it." << std::endl;
+            previous.close();
+        }
+    }
+    if (previous.is_open()) {
+        // Index the clusters of the previous cache. A truncated cache (from
+        // an interrupted run) is valid up to the last complete cluster.
+        try {
+            while (previous.peek() != EOF) {
+                Hash128 hash;
+                hash.low = readValue<uint64_t>(previous);
+                hash.high = readValue<uint64_t>(previous);
+                const uint64_t offset = previous.tellg();
+                readClusterInfo(previous, previousSize - offset);
+                index[hash] = offset;
+            }
+        } catch (const std::runtime_error&) {}
+        previous.clear();
+    }
+
+    next.open(path + ".tmp", std::ios::binary | std::ios::trunc);
+    if (!next) {
+        throw std::runtime_error("Cannot write the cluster cache " + path + ".tmp");
+    }
+    next.write(CACHE_MAGIC, sizeof(CACHE_MAGIC) - 1);
+}
+
+bool ClusterCache::find(const Hash128& clusterHash, ClusterInfo& info)
+{
+    const auto it = index.find(clusterHash);
+    if (it == index.end()) {
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    previous.seekg(it->second);
+    info = readClusterInfo(previous, previousSize - it->second);
+    return true;
+}
+
+void ClusterCache::add(const Hash128& clusterHash, const ClusterInfo& info)
+{
+    writeValue<uint64_t>(next, clusterHash.low);
+    writeValue<uint64_t>(next, clusterHash.high);
+    writeValue<uint32_t>(next, info.size());
+    for (const auto& blob : info) {
+        writeValue<zim::blob_index_type>(next, blob.first);
+        writeValue<uint64_t>(next, blob.second.size);
+        writeValue<uint64_t>(next, blob.second.hash.low);
+        writeValue<uint64_t>(next, blob.second.hash.high);
+        writeString(next, blob.second.sniffedMimetype);
+        writeValue<uint64_t>(next, blob.second.textSignature);
+        if (!blob.second.hasLinks) {
+            writeValue<uint32_t>(next, NO_LINKS);
+            continue;
+        }
+        writeValue<uint32_t>(next, blob.second.links.size());
+        for (const auto& link : blob.second.links) {
+            writeString(next, LinkTable::attributeName(link.attribute));
+            writeString(next, blob.second.links.str(link));
+        }
+    }
+}
+
+void ClusterCache::save(std::ostream& out)
+{
+    next.flush();
+    const uint64_t size = uint64_t(next.tellp()) - (sizeof(CACHE_MAGIC) - 1);
+    writeValue<uint64_t>(out, size);
+    std::ifstream written(path + ".tmp", std::ios::binary);
+    written.seekg(sizeof(CACHE_MAGIC) - 1);
+    copyBytes(written, out, size);
+}
+
+void ClusterCache::load(std::istream& in)
+{
+    copyBytes(in, next, readValue<uint64_t>(in));
+}
+
+void ClusterCache::commit()
+{
+    next.close();
+    previous.close();
+    if (!next || std::rename((path + ".tmp").c_str(), path.c_str()) != 0) {
+        throw std::runtime_error("Cannot write the cluster cache " + path);
+    }
+}
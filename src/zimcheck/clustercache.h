@@ -0,0 +1,121 @@
+#ifndef _ZIM_TOOL_CLUSTERCACHE_H_
+#define _ZIM_TOOL_CLUSTERCACHE_H_
+
+#include <string>
+#include <vector>
+#include <map>
+#include <unordered_map>
+#include <fstream>
+#include <mutex>
+#include <cstdint>
+
+#include <zim/zim.h>
+
+#include "../tools.h"
+
+namespace zim {
+  class Archive;
+}
+
+// What is known about the content of a blob, whatever the entries pointing to it.
+struct BlobInfo
+{
+    zim::size_type size;
+    Hash128 hash;
+    bool hasLinks; // The links have been extracted (the blob is a html page).
+    LinkTable links;
+    std::string sniffedMimetype; // See sniffMimetype().
+    uint64_t textSignature;      // See textSignature(), 0 if none.
+};
+
+// The blobs of a cluster, by blob index.
+typedef std::map<zim::blob_index_type, BlobInfo> ClusterInfo;
+
+/* Hash the raw (compressed) data of the clusters, read directly from the
+ * zim file. This is much cheaper than decompressing the clusters.
+ *
+ * The size of a cluster is the distance to the next one, so the last cluster
+ * of the file (and the clusters of a split archive) cannot be hashed.
+ *
+ * libzim doesn't give the raw data of a cluster, so a cluster not in the
+ * cache is read twice: once to be hashed, then by libzim to be decompressed.
+ * The second read comes right after the first one and is served by the
+ * page cache; the time of the first one is the CLUSTER_HASH phase (see
+ * --timings).
+ */
+class ClusterHasher
+{
+  public:
+    explicit ClusterHasher(const zim::Archive& archive);
+    ~ClusterHasher();
+
+    // Return false if the cluster cannot be hashed. Thread safe.
+    bool hash(zim::cluster_index_type cluster, Hash128& hash) const;
+
+    // The size of the raw data of the cluster, 0 if it cannot be hashed.
+    zim::size_type size(zim::cluster_index_type cluster) const;
+
+  private:
+    ClusterHasher(const ClusterHasher&);
+    ClusterHasher& operator=(const ClusterHasher&);
+
+#ifdef _WIN32
+    mutable std::mutex mutex;
+    mutable std::ifstream file;
+#else
+    int fd;
+#endif
+    std::vector<zim::offset_type> offsets;
+    std::vector<zim::size_type> sizes;
+};
+
+/* A persistent cache of the BlobInfo of the clusters, identified by the hash
+ * of their raw data.
+ *
+ * Most of the clusters of a new release of an archive are identical to the
+ * previous release. For them, zimcheck can reuse the content hashes and the
+ * links stored in the cache instead of decompressing and parsing them again.
+ * (Everything depending on the entries, as the resolution of the links, is
+ * always checked again).
+ *
+ * The clusters checked by a run are written to a new cache, which replaces
+ * the previous one on commit().
+ */
+class ClusterCache
+{
+  public:
+    explicit ClusterCache(const std::string& path);
+
+    // Return true and set `info` if the cluster is in the cache. Thread safe.
+    bool find(const Hash128& clusterHash, ClusterInfo& info);
+
+    // Write the cluster to the new cache.
+    void add(const Hash128& clusterHash, const ClusterInfo& info);
+
+    // Replace the previous cache with the new one.
+    void commit();
+
+    // Write the clusters added to the new cache to (or add the ones read
+    // from) a checkpoint, so a resumed check keeps the clusters it checked
+    // before the interruption.
+    void save(std::ostream& out);
+    void load(std::istream& in);
+
+    size_t size() const { return index.size(); }
+
+  private:
+    struct Hash128Hasher
+    {
+        size_t operator()(const Hash128& h) const { return h.low; }
+    };
+
+    std::string path;
+    std::mutex mutex;
+    std::ifstream previous;
+    uint64_t previousSize;
+    // Offset of the clusters in the previous cache.
+    std::unordered_map<Hash128, uint64_t, Hash128Hasher> index;
+    std::ofstream next;
+};
+
+#endif
@@ -0,0 +1,361 @@
+#define ZIM_PRIVATE
+#include "clusterstats.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <zim/archive.h>
+
+namespace
+{
+
+// A compressed cluster keeping more than this of its size is reported.
+const double INCOMPRESSIBLE_RATIO = 0.9;
+const uint64_t MIN_SIZE_BUCKET = 16 * 1024;
+
+const size_t CHECKSUM_POS_OFFSET = 72;
+
+// Where the clusters end: at the checksum (or at the end of the file if
+// the header cannot be read).
+#ifdef _WIN32
+uint64_t getClustersEnd(std::ifstream& file)
+{
+    file.seekg(0, std::ios::end);
+    const std::streamoff end = file.tellg();
+    const uint64_t fileSize = end > 0 ? end : 0;
+    unsigned char pos[8];
+    file.seekg(CHECKSUM_POS_OFFSET);
+    if (!file.read(reinterpret_cast<char*>(pos), sizeof(pos))) {
+        file.clear();
+        return fileSize;
+    }
+#else
+uint64_t getClustersEnd(int fd)
+{
+    struct stat st;
+    const uint64_t fileSize = fstat(fd, &st) == 0 ? st.st_size : 0;
+    unsigned char pos[8];
+    if (pread(fd, pos, sizeof(pos), CHECKSUM_POS_OFFSET) != sizeof(pos)) {
+        return fileSize;
+    }
+#endif
+    uint64_t checksumPos = 0;
+    for (size_t i = sizeof(pos); i > 0; i--) {
+        checksumPos = (checksumPos << 8) | pos[i-1];
+    }
+    return checksumPos != 0 && checksumPos <= fileSize ? checksumPos : fileSize;
+}
+
+// The compression of the cluster (low bits of its first byte).
+std::string compressionToStr(int compression)
+{
+    switch (compression) {
+      case 1: return "none";
+      case 2: return "zlib";
+      case 3: return "bzip2";
+      case 4: return "xz";
+      case 5: return "zstd";
+      case -1: return "unknown";
+      default: return "invalid(" + std::to_string(compression) + ")";
+    }
+}
+
+bool isCompressed(int compression)
+{
+    return compression >= 2 && compression <= 5;
+}
+
+// The bucket of `value` in powers of 2 from `first`.
+size_t powerBucket(uint64_t value, uint64_t first, size_t bucketCount)
+{
+    size_t bucket = 0;
+    for (uint64_t limit = first * 2; value >= limit && bucket + 1 < bucketCount; limit *= 2) {
+        bucket++;
+    }
+    return bucket;
+}
+
+std::string dominantMimetype(const ClusterRecord& record)
+{
+    std::string mimetype;
+    uint64_t size = 0;
+    for (const auto& m : record.mimetypeSizes) {
+        if (m.second > size || mimetype.empty()) {
+            mimetype = m.first;
+            size = m.second;
+        }
+    }
+    return mimetype;
+}
+
+double ratio(uint64_t compressedSize, uint64_t size)
+{
+    return size ? double(compressedSize) / size : 0;
+}
+
+void printRatio(std::ostream& out, uint64_t compressedSize, uint64_t size)
+{
+    if (!size) {
+        out << '-';
+        return;
+    }
+    std::ostringstream ss;
+    ss << std::fixed << std::setprecision(1) << 100 * ratio(compressedSize, size) << '%';
+    out << ss.str();
+}
+
+} // unnamed namespace
+
+const size_t ClusterStats::RATIO_BUCKETS;
+const size_t ClusterStats::SIZE_BUCKETS;
+const size_t ClusterStats::BLOB_BUCKETS;
+const size_t ClusterStats::MAX_WORST_CLUSTERS;
+
+void ClusterRecord::addBlob(zim::blob_index_type blob, const std::string& mimetype, uint64_t blobSize)
+{
+    if (blobCount > 0 && blob == lastBlob) {
+        return;
+    }
+    if (blobCount == 0) {
+        firstBlob = blob;
+        firstBlobSize = blobSize;
+        firstMimetype = mimetype;
+    }
+    lastBlob = blob;
+    blobCount++;
+    size += blobSize;
+    mimetypeSizes[mimetype] += blobSize;
+}
+
+void ClusterStats::Totals::add(const ClusterRecord& record)
+{
+    clusters++;
+    blobs += record.blobCount;
+    size += record.size;
+    if (record.compressedSize) {
+        compressedSize += record.compressedSize;
+        knownSize += record.size;
+    }
+}
+
+ClusterStats::ClusterStats(const zim::Archive& archive)
+  : isOpen(false),
+    hasPending(false),
+    sizes(),
+    blobCounts()
+{
+#ifndef _WIN32
+    fd = -1;
+#endif
+    if (archive.isMultiPart()) {
+        return;
+    }
+#ifdef _WIN32
+    file.open(archive.getFilename(), std::ios::binary);
+    if (!file) {
+        return;
+    }
+    const uint64_t clustersEnd = getClustersEnd(file);
+#else
+    fd = open(archive.getFilename().c_str(), O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    const uint64_t clustersEnd = getClustersEnd(fd);
+#endif
+    isOpen = true;
+
+    // The size of a cluster is the distance to the next one (or to the
+    // checksum for the last one).
+    const auto clusterCount = archive.getClusterCount();
+    offsets.resize(clusterCount);
+    compressedSizes.resize(clusterCount, 0);
+    std::vector<zim::cluster_index_type> byOffset(clusterCount);
+    for (zim::cluster_index_type i = 0; i < clusterCount; i++) {
+        offsets[i] = archive.getClusterOffset(i);
+        byOffset[i] = i;
+    }
+    std::sort(byOffset.begin(), byOffset.end(),
+              [&](zim::cluster_index_type a, zim::cluster_index_type b) { return offsets[a] < offsets[b]; });
+    for (size_t i = 0; i < byOffset.size(); i++) {
+        const uint64_t end = i + 1 < byOffset.size() ? offsets[byOffset[i+1]] : clustersEnd;
+        const uint64_t offset = offsets[byOffset[i]];
+        compressedSizes[byOffset[i]] = end > offset ? end - offset : 0;
+    }
+}
+
+ClusterStats::~ClusterStats()
+{
+#ifndef _WIN32
+    if (fd >= 0) {
+        close(fd);
+    }
+#endif
+}
+
+ClusterRecord ClusterStats::describe(zim::cluster_index_type cluster) const
+{
+    ClusterRecord record;
+    record.cluster = cluster;
+    if (!isOpen || cluster >= offsets.size()) {
+        return record;
+    }
+    record.compressedSize = compressedSizes[cluster];
+    // libzim doesn't tell the compression of a cluster, so its first byte is
+    // read here: one more system call per cluster, but no disk read as libzim
+    // reads the same page to decompress the cluster (but for the clusters
+    // found in the cluster cache).
+    char info;
+#ifdef _WIN32
+    std::lock_guard<std::mutex> lock(mutex);
+    file.clear();
+    file.seekg(offsets[cluster]);
+    if (file.read(&info, 1)) {
+#else
+    if (pread(fd, &info, 1, offsets[cluster]) == 1) {
+#endif
+        // 0 is an old value of "none".
+        record.compression = std::max(1, info & 0x0f);
+    }
+    return record;
+}
+
+void ClusterStats::add(const ClusterRecord& record)
+{
+    if (record.blobCount == 0) {
+        return;
+    }
+    if (!hasPending || pending.cluster != record.cluster) {
+        finish();
+        pending = record;
+        hasPending = true;
+        return;
+    }
+    // The next part of the pending cluster.
+    for (const auto& m : record.mimetypeSizes) {
+        pending.mimetypeSizes[m.first] += m.second;
+    }
+    pending.blobCount += record.blobCount;
+    pending.size += record.size;
+    if (record.firstBlob == pending.lastBlob) {
+        pending.blobCount--;
+        pending.size -= record.firstBlobSize;
+        // The blob may have been counted with another mimetype (by another
+        // entry), don't leave an empty one to be taken as dominant.
+        const auto it = pending.mimetypeSizes.find(record.firstMimetype);
+        it->second -= record.firstBlobSize;
+        if (it->second == 0) {
+            pending.mimetypeSizes.erase(it);
+        }
+    }
+    pending.lastBlob = record.lastBlob;
+}
+
+void ClusterStats::finish()
+{
+    if (hasPending) {
+        account(pending);
+        hasPending = false;
+    }
+}
+
+void ClusterStats::account(const ClusterRecord& record)
+{
+    total.add(record);
+    byCompression[record.compression].add(record);
+    byMimetype[dominantMimetype(record)].add(record);
+    sizes[powerBucket(record.size, MIN_SIZE_BUCKET, SIZE_BUCKETS)]++;
+    blobCounts[powerBucket(record.blobCount, 1, BLOB_BUCKETS)]++;
+    if (!record.compressedSize || !record.size) {
+        return;
+    }
+
+    const double r = ratio(record.compressedSize, record.size);
+    ratios[record.compression][std::min(RATIO_BUCKETS - 1, size_t(r * 10))]++;
+
+    if (isCompressed(record.compression) && r >= INCOMPRESSIBLE_RATIO) {
+        const auto bigger = [](const ClusterRecord& a, const ClusterRecord& b) {
+            return a.compressedSize != b.compressedSize ? a.compressedSize > b.compressedSize
+                                                        : a.cluster < b.cluster;
+        };
+        if (worst.size() < MAX_WORST_CLUSTERS || bigger(record, worst.back())) {
+            ClusterRecord kept = record;
+            kept.mimetypeSizes.clear();
+            kept.mimetypeSizes[dominantMimetype(record)] = record.size;
+            worst.insert(std::upper_bound(worst.begin(), worst.end(), kept, bigger), kept);
+            if (worst.size() > MAX_WORST_CLUSTERS) {
+                worst.pop_back();
+            }
+        }
+    }
+}
+
+void ClusterStats::report(std::ostream& out) const
+{
+    out << "[INFO] Clusters: " << total.clusters << " clusters, " << total.blobs << " blobs, "
+        << total.size << " bytes (";
+    printRatio(out, total.compressedSize, total.knownSize);
+    out << " once compressed)" << std::endl;
+
+    out << "  By compression:" << std::endl;
+    for (const auto& c : byCompression) {
+        out << "    " << std::left << std::setw(8) << compressionToStr(c.first) << std::right
+            << std::setw(10) << c.second.clusters << " clusters " << std::setw(12) << c.second.blobs
+            << " blobs " << std::setw(15) << c.second.size << " bytes  ";
+        printRatio(out, c.second.compressedSize, c.second.knownSize);
+        out << std::endl;
+    }
+
+    out << "  By main mimetype:" << std::endl;
+    for (const auto& m : byMimetype) {
+        out << "    " << std::left << std::setw(30) << m.first << std::right
+            << std::setw(10) << m.second.clusters << " clusters " << std::setw(15)
+            << m.second.size << " bytes  ";
+        printRatio(out, m.second.compressedSize, m.second.knownSize);
+        out << std::endl;
+    }
+
+    out << "  Compressed size / size (clusters):" << std::endl;
+    for (const auto& r : ratios) {
+        out << "    " << std::left << std::setw(8) << compressionToStr(r.first) << std::right;
+        for (size_t i = 0; i < RATIO_BUCKETS; i++) {
+            out << ' ' << (i == RATIO_BUCKETS - 1 ? ">=" : "<") << std::min<size_t>(i + 1, 10) * 10
+                << "%:" << r.second[i];
+        }
+        out << std::endl;
+    }
+
+    out << "  Size (clusters):";
+    for (size_t i = 0; i < SIZE_BUCKETS; i++) {
+        const uint64_t limit = (MIN_SIZE_BUCKET << i) / 1024;
+        out << ' ' << (i == SIZE_BUCKETS - 1 ? ">=" : "<") << (i == SIZE_BUCKETS - 1 ? limit : limit * 2)
+            << "K:" << sizes[i];
+    }
+    out << std::endl;
+
+    out << "  Blobs (clusters):";
+    for (size_t i = 0; i < BLOB_BUCKETS; i++) {
+        const uint64_t limit = uint64_t(1) << i;
+        out << ' ' << (i == BLOB_BUCKETS - 1 ? ">=" : "<") << (i == BLOB_BUCKETS - 1 ? limit : limit * 2)
+            << ':' << blobCounts[i];
+    }
+    out << std::endl;
+
+    if (!worst.empty()) {
+        out << "  Compressed clusters saving less than "
+            << int(100 * (1 - INCOMPRESSIBLE_RATIO) + 0.5) << "% (the biggest first):" << std::endl;
+        for (const auto& record : worst) {
+            out << "    Cluster " << record.cluster << " (" << compressionToStr(record.compression)
+                << ", " << record.blobCount << " blobs, " << record.mimetypeSizes.begin()->first
+                << "): " << record.size << " -> " << record.compressedSize << " bytes (";
+            printRatio(out, record.compressedSize, record.size);
+            out << ")" << std::endl;
+        }
+    }
+}
@@ -0,0 +1,110 @@
+#ifndef _ZIM_TOOL_CLUSTERSTATS_H_
+#define _ZIM_TOOL_CLUSTERSTATS_H_
+
+#include <array>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include <zim/zim.h>
+
+namespace zim {
+  class Archive;
+}
+
+// What is known of the blobs of a cluster (or of a part of them, if the
+// cluster is loaded in several parts).
+struct ClusterRecord
+{
+    zim::cluster_index_type cluster = 0;
+    uint64_t compressedSize = 0; // 0 if unknown (split archive).
+    int compression = -1;        // As stored in the cluster, -1 if unknown.
+    uint64_t size = 0;           // Of the blobs referenced by the entries.
+    uint32_t blobCount = 0;
+    std::map<std::string, uint64_t> mimetypeSizes;
+
+    // The blobs are added in blob order, the ones shared by several
+    // entries are counted once.
+    void addBlob(zim::blob_index_type blob, const std::string& mimetype, uint64_t blobSize);
+
+  private:
+    friend class ClusterStats;
+    zim::blob_index_type firstBlob = 0, lastBlob = 0;
+    uint64_t firstBlobSize = 0;
+    std::string firstMimetype;
+};
+
+/* How the clusters of an archive turned out: their compression, their
+ * sizes and their blobs, to tune the creation of the archives.
+ *
+ * The workers describe the clusters they read (the compressed sizes come
+ * from the cluster pointers, the compression from the first byte of each
+ * cluster, likely still in the page cache). Only the totals, the histograms
+ * and the worst clusters are kept.
+ */
+class ClusterStats
+{
+  public:
+    static const size_t RATIO_BUCKETS = 11;       // By 10%, the last one for more than 100%.
+    static const size_t SIZE_BUCKETS = 12;        // Powers of 2, from 16 KB.
+    static const size_t BLOB_BUCKETS = 12;        // Powers of 2.
+    static const size_t MAX_WORST_CLUSTERS = 10;
+
+    explicit ClusterStats(const zim::Archive& archive);
+    ~ClusterStats();
+    ClusterStats(const ClusterStats&) = delete;
+    ClusterStats& operator=(const ClusterStats&) = delete;
+
+    // A new record of `cluster`, with what is known from the file. Thread safe.
+    ClusterRecord describe(zim::cluster_index_type cluster) const;
+
+    // Add the records in cluster order (the parts of a cluster are merged),
+    // then finish().
+    void add(const ClusterRecord& record);
+    void finish();
+
+    uint64_t clusterCount() const { return total.clusters; }
+
+    // Print the totals, the histograms and the worst clusters.
+    void report(std::ostream& out) const;
+
+  private:
+    struct Totals
+    {
+        uint64_t clusters = 0;
+        uint64_t blobs = 0;
+        uint64_t size = 0;
+        uint64_t compressedSize = 0; // Of the clusters whose compressed size is known.
+        uint64_t knownSize = 0;      // Their uncompressed size.
+        void add(const ClusterRecord& record);
+    };
+
+    void account(const ClusterRecord& record);
+
+#ifdef _WIN32
+    mutable std::mutex mutex;
+    mutable std::ifstream file;
+#else
+    int fd;
+#endif
+    bool isOpen;
+    std::vector<zim::offset_type> offsets;
+    std::vector<uint64_t> compressedSizes;
+
+    ClusterRecord pending;
+    bool hasPending;
+    Totals total;
+    std::map<int, Totals> byCompression;
+    std::map<std::string, Totals> byMimetype; // By dominant mimetype.
+    std::map<int, std::array<uint64_t, RATIO_BUCKETS>> ratios;
+    std::array<uint64_t, SIZE_BUCKETS> sizes;
+    std::array<uint64_t, BLOB_BUCKETS> blobCounts;
+    // The compressed clusters saving the least space, the biggest first.
+    std::vector<ClusterRecord> worst;
+};
+
+#endif
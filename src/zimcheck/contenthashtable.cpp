@@ -0,0 +1,96 @@
+#include "contenthashtable.h"
+#include "serialize.h"
+
+namespace
+{
+
+const size_t INITIAL_SIZE = 1024; // Must be a power of 2.
+
+} // unnamed namespace
+
+const zim::entry_index_type ContentHashTable::NO_ENTRY;
+
+ContentHashTable::ContentHashTable()
+  : slots(INITIAL_SIZE, Slot{0, 0, 0, NO_ENTRY}),
+    count(0),
+    maxMemory(0)
+{}
+
+size_t ContentHashTable::findSlot(uint64_t hashLow, uint64_t hashHigh, uint32_t size) const
+{
+    // The hash is already well distributed, no need to mix it again.
+    const size_t mask = slots.size() - 1;
+    size_t pos = hashLow & mask;
+    while (true) {
+        const Slot& slot = slots[pos];
+        if (slot.index == NO_ENTRY
+         || (slot.hashLow == hashLow && slot.hashHigh == hashHigh && slot.size == size)) {
+            return pos;
+        }
+        pos = (pos + 1) & mask;
+    }
+}
+
+void ContentHashTable::grow()
+{
+    std::vector<Slot> oldSlots(slots.size() * 2, Slot{0, 0, 0, NO_ENTRY});
+    oldSlots.swap(slots);
+    for (const auto& slot : oldSlots) {
+        if (slot.index != NO_ENTRY) {
+            slots[findSlot(slot.hashLow, slot.hashHigh, slot.size)] = slot;
+        }
+    }
+}
+
+zim::entry_index_type ContentHashTable::insert(const Hash128& hash, zim::size_type size, zim::entry_index_type index)
+{
+    // Keep the load factor under 3/4.
+    if (needsToGrow()) {
+        grow();
+    }
+    Slot& slot = slots[findSlot(hash.low, hash.high, uint32_t(size))];
+    if (slot.index != NO_ENTRY) {
+        return slot.index;
+    }
+    slot = Slot{hash.low, hash.high, uint32_t(size), index};
+    count++;
+    return NO_ENTRY;
+}
+
+zim::entry_index_type ContentHashTable::find(const Hash128& hash, zim::size_type size) const
+{
+    return slots[findSlot(hash.low, hash.high, uint32_t(size))].index;
+}
+
+bool ContentHashTable::isFull() const
+{
+    // While growing, the old and the new slots are both allocated.
+    return maxMemory && needsToGrow() && slots.size() * 3 * sizeof(Slot) > maxMemory;
+}
+
+void ContentHashTable::save(std::ostream& out) const
+{
+    writeValue<uint64_t>(out, slots.size());
+    writeValue<uint64_t>(out, count);
+    out.write(reinterpret_cast<const char*>(slots.data()), slots.size() * sizeof(Slot));
+}
+
+void ContentHashTable::load(std::istream& in)
+{
+    const auto slotCount = readValue<uint64_t>(in);
+    const auto newCount = readValue<uint64_t>(in);
+    if (slotCount < INITIAL_SIZE || (slotCount & (slotCount - 1)) != 0 || newCount > slotCount) {
+        throw std::runtime_error("Invalid content hash table");
+    }
+    std::vector<Slot> newSlots(slotCount);
+    if (!in.read(reinterpret_cast<char*>(newSlots.data()), slotCount * sizeof(Slot))) {
+        throw std::runtime_error("Truncated file");
+    }
+    slots.swap(newSlots);
+    count = newCount;
+}
+
+Hash128 contentHash(const std::string& data)
+{
+    return hash128(data.data(), data.size(), data.size());
+}
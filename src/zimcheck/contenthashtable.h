@@ -0,0 +1,65 @@
+#ifndef _ZIM_TOOL_CONTENTHASHTABLE_H_
+#define _ZIM_TOOL_CONTENTHASHTABLE_H_
+
+#include <vector>
+#include <iostream>
+#include <cstdint>
+
+#include <zim/zim.h>
+
+#include "../tools.h"
+
+/* Set of the contents seen so far, used to detect redundant items in a single
+ * pass. A content is identified by its 128 bits hash and its size.
+ *
+ * This is a flat open addressing table (linear probing) storing only the
+ * fingerprint and the entry index of the first item having this content:
+ * 24 bytes per slot and no allocation per item.
+ */
+class ContentHashTable
+{
+  public:
+    static const zim::entry_index_type NO_ENTRY = zim::entry_index_type(-1);
+
+    ContentHashTable();
+
+    // Add the content of the item `index`. Return the index of the first item
+    // with the same content, or NO_ENTRY if the content is new.
+    zim::entry_index_type insert(const Hash128& hash, zim::size_type size, zim::entry_index_type index);
+    // Return the index of the first item with this content, or NO_ENTRY.
+    zim::entry_index_type find(const Hash128& hash, zim::size_type size) const;
+
+    // Don't grow the table above `bytes` (0 for no limit).
+    void setMaxMemory(size_t bytes) { maxMemory = bytes; }
+    // Whether a new content would make the table grow above its limit.
+    bool isFull() const;
+
+    size_t size() const { return count; }
+    size_t memoryUsage() const { return slots.capacity() * sizeof(Slot); }
+
+    // Write the table to (or replace it by the one read from) a checkpoint.
+    void save(std::ostream& out) const;
+    void load(std::istream& in);
+
+  private:
+    struct Slot
+    {
+        uint64_t hashLow;
+        uint64_t hashHigh;
+        uint32_t size; // Low bits only, the size is also part of the hash seed.
+        zim::entry_index_type index;
+    };
+
+    void grow();
+    size_t findSlot(uint64_t hashLow, uint64_t hashHigh, uint32_t size) const;
+    bool needsToGrow() const { return (count + 1) * 4 > slots.size() * 3; }
+
+    std::vector<Slot> slots;
+    size_t count;
+    size_t maxMemory;
+};
+
+// Hash of the content of an item, to be inserted in a ContentHashTable.
+Hash128 contentHash(const std::string& data);
+
+#endif
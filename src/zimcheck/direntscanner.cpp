@@ -0,0 +1,158 @@
+#include "direntscanner.h"
+
+#include <cerrno>
+#include <cstring>
+#include <cstdint>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <zim/archive.h>
+
+namespace
+{
+
+const uint32_t ZIM_MAGIC = 72173914;
+const size_t HEADER_SIZE = 80;
+const size_t ENTRY_COUNT_OFFSET = 24;
+const size_t PATH_POINTERS_OFFSET = 32;
+const size_t TITLE_POINTERS_OFFSET = 40;
+// mimetype (2), parameter size (1), namespace (1), revision (4), then the
+// redirection index (4) or the cluster and the blob (8).
+const size_t REDIRECT_DIRENT_SIZE = 12;
+const size_t ITEM_DIRENT_SIZE = 16;
+
+// The zim files are little endian.
+template<typename T>
+T readLittleEndian(const char* p)
+{
+    T value = 0;
+    for (size_t i = 0; i < sizeof(T); i++) {
+        value |= T(uint8_t(p[i])) << (8 * i);
+    }
+    return value;
+}
+
+} // unnamed namespace
+
+const uint16_t DirentView::REDIRECT_MIMETYPE;
+
+DirentScanner::DirentScanner(const zim::Archive& archive)
+  : data(nullptr),
+    size(0),
+    count(0),
+    pathPointers(0),
+    titlePointers(0)
+{
+    if (archive.isMultiPart()) {
+        failure = "split archive";
+        return;
+    }
+#ifdef _WIN32
+    failure = "not mapped on this platform";
+#else
+    const int fd = open(archive.getFilename().c_str(), O_RDONLY);
+    if (fd < 0) {
+        failure = std::strerror(errno);
+        return;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        failure = std::strerror(errno);
+        close(fd);
+        return;
+    }
+    if (uint64_t(info.st_size) < HEADER_SIZE) {
+        failure = "file too small";
+        close(fd);
+        return;
+    }
+    if (uint64_t(info.st_size) > SIZE_MAX) {
+        failure = "file too large to be mapped";
+        close(fd);
+        return;
+    }
+    void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    const int mapError = errno;
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        failure = std::strerror(mapError);
+        return;
+    }
+    data = static_cast<const char*>(mapping);
+    size = info.st_size;
+
+    const uint32_t entryCount = readLittleEndian<uint32_t>(data + ENTRY_COUNT_OFFSET);
+    pathPointers = readLittleEndian<uint64_t>(data + PATH_POINTERS_OFFSET);
+    if (readLittleEndian<uint32_t>(data) != ZIM_MAGIC
+     || pathPointers > size || (size - pathPointers) / 8 < entryCount) {
+        munmap(mapping, size);
+        data = nullptr;
+        size = 0;
+        failure = "invalid header";
+        return;
+    }
+    count = entryCount;
+
+    // The title index is a list of entry indexes (4 bytes each).
+    const uint64_t titles = readLittleEndian<uint64_t>(data + TITLE_POINTERS_OFFSET);
+    if (titles >= HEADER_SIZE && titles <= size && (size - titles) / 4 >= entryCount) {
+        titlePointers = titles;
+    }
+#endif
+}
+
+DirentScanner::~DirentScanner()
+{
+#ifndef _WIN32
+    if (data) {
+        munmap(const_cast<char*>(data), size);
+    }
+#endif
+}
+
+uint32_t DirentScanner::titleEntry(uint32_t position) const
+{
+    return readLittleEndian<uint32_t>(data + titlePointers + 4 * uint64_t(position));
+}
+
+bool DirentScanner::get(uint32_t index, DirentView& dirent) const
+{
+    if (index >= count) {
+        return false;
+    }
+    const uint64_t offset = readLittleEndian<uint64_t>(data + pathPointers + 8 * uint64_t(index));
+    if (offset >= size || size - offset < ITEM_DIRENT_SIZE) {
+        return false;
+    }
+    const char* p = data + offset;
+    dirent.mimetype = readLittleEndian<uint16_t>(p);
+    dirent.ns = p[3];
+    if (dirent.isRedirect()) {
+        dirent.redirectIndex = readLittleEndian<uint32_t>(p + 8);
+        p += REDIRECT_DIRENT_SIZE;
+    } else {
+        dirent.cluster = readLittleEndian<uint32_t>(p + 8);
+        dirent.blob = readLittleEndian<uint32_t>(p + 12);
+        p += ITEM_DIRENT_SIZE;
+    }
+
+    // The path and the title are zero terminated.
+    const char* end = data + size;
+    const char* pathEnd = static_cast<const char*>(std::memchr(p, '\0', end - p));
+    if (!pathEnd) {
+        return false;
+    }
+    const char* titleEnd = static_cast<const char*>(std::memchr(pathEnd + 1, '\0', end - pathEnd - 1));
+    if (!titleEnd) {
+        return false;
+    }
+    dirent.path = p;
+    dirent.pathSize = pathEnd - p;
+    dirent.title = pathEnd + 1;
+    dirent.titleSize = titleEnd - pathEnd - 1;
+    return true;
+}
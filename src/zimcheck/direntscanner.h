@@ -0,0 +1,75 @@
+#ifndef _ZIM_TOOL_DIRENTSCANNER_H_
+#define _ZIM_TOOL_DIRENTSCANNER_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+namespace zim {
+  class Archive;
+}
+
+// A dirent of the archive, pointing into the mapped file (nothing is copied).
+struct DirentView
+{
+    static const uint16_t REDIRECT_MIMETYPE = 0xffff;
+
+    uint16_t mimetype;
+    char ns;
+    uint32_t redirectIndex; // Only for a redirection.
+    uint32_t cluster;       // Only for an item.
+    uint32_t blob;          // Only for an item.
+    const char* path;       // Without the namespace.
+    size_t pathSize;
+    const char* title;      // Empty if the title is the path.
+    size_t titleSize;
+
+    bool isRedirect() const { return mimetype == REDIRECT_MIMETYPE; }
+};
+
+/* Read the dirents of an archive directly from the zim file, mapped in
+ * memory, instead of building a zim::Entry (and copying its path and
+ * title) for each one.
+ *
+ * Used by the checks only needing the dirents (or the title index), on
+ * millions of entries.
+ * The scanner doesn't trust the file: a dirent out of the file is not
+ * returned, the caller then falls back to libzim (which reports the
+ * error). A split archive, a file which cannot be mapped (or any file on
+ * Windows) is not scanned at all, see isOpen() and error(): the checks
+ * then read the dirents through libzim.
+ */
+class DirentScanner
+{
+  public:
+    explicit DirentScanner(const zim::Archive& archive);
+    ~DirentScanner();
+    DirentScanner(const DirentScanner&) = delete;
+    DirentScanner& operator=(const DirentScanner&) = delete;
+
+    bool isOpen() const { return data != nullptr; }
+    // Why the file is not open (empty if it is).
+    const std::string& error() const { return failure; }
+    // All the entries (the user ones come first), 0 if not open.
+    uint32_t entryCount() const { return count; }
+
+    // Set `dirent` to the entry `index` (in path order). Return false if
+    // the dirent is not valid.
+    bool get(uint32_t index, DirentView& dirent) const;
+
+    // Whether the title index (the entries in title order) is in the file.
+    bool hasTitleIndex() const { return titlePointers != 0; }
+    // The index of the entry at `position` (< entryCount()) in the title
+    // index. Not checked: may be out of the entries.
+    uint32_t titleEntry(uint32_t position) const;
+
+  private:
+    const char* data;
+    size_t size;
+    uint32_t count;
+    uint64_t pathPointers;  // Offset of the list of the dirent offsets.
+    uint64_t titlePointers; // Offset of the title index, 0 if not in the file.
+    std::string failure;
+};
+
+#endif
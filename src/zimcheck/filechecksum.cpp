@@ -0,0 +1,232 @@
+#include "filechecksum.h"
+#include "md5.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+
+// The file is read by blocks of BLOCK_SIZE bytes. BLOCK_COUNT blocks are in
+// flight between the reader and the hasher.
+const size_t BLOCK_SIZE = 4 * 1024 * 1024;
+const size_t BLOCK_COUNT = 4;
+
+const uint32_t ZIM_MAGIC = 72173914;
+const size_t HEADER_SIZE = 80;
+const size_t CHECKSUM_POS_OFFSET = 72;
+const size_t CHECKSUM_SIZE = 16;
+
+const size_t NO_BLOCK = size_t(-1);
+
+// The file, read by one thread at a time (with pread, or a std::ifstream on
+// Windows).
+class File
+{
+  public:
+    explicit File(const std::string& filename)
+#ifdef _WIN32
+      : stream(filename, std::ios::binary)
+    {
+        if (!stream) {
+            throw std::runtime_error("Cannot open " + filename);
+        }
+    }
+#else
+      : fd(open(filename.c_str(), O_RDONLY))
+    {
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open " + filename);
+        }
+    }
+    ~File() { close(fd); }
+#endif
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    uint64_t size() const
+    {
+#ifdef _WIN32
+        stream.clear();
+        stream.seekg(0, std::ios::end);
+        const std::streamoff end = stream.tellg();
+        if (end < 0) {
+            throw std::runtime_error("Cannot get the size of the file");
+        }
+        return end;
+#else
+        struct stat st;
+        if (fstat(fd, &st) != 0) {
+            throw std::runtime_error("Cannot get the size of the file");
+        }
+        return st.st_size;
+#endif
+    }
+
+    // Read exactly `size` bytes at `offset`.
+    void readAt(char* data, size_t size, uint64_t offset) const
+    {
+#ifdef _WIN32
+        stream.clear();
+        stream.seekg(offset);
+        stream.read(data, size);
+        if (!stream) {
+            throw std::runtime_error("Cannot read the file");
+        }
+#else
+        while (size > 0) {
+            const ssize_t n = pread(fd, data, size, offset);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                throw std::runtime_error("Cannot read the file");
+            }
+            data += n;
+            size -= n;
+            offset += n;
+        }
+#endif
+    }
+
+    void adviseSequential() const
+    {
+#if !defined(_WIN32) && defined(POSIX_FADV_SEQUENTIAL)
+        posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+#endif
+    }
+
+  private:
+#ifdef _WIN32
+    mutable std::ifstream stream;
+#else
+    int fd;
+#endif
+};
+
+uint64_t readLittleEndian(const char* data, size_t size)
+{
+    uint64_t value = 0;
+    for (size_t i = size; i > 0; i--) {
+        value = (value << 8) | static_cast<unsigned char>(data[i-1]);
+    }
+    return value;
+}
+
+// The blocks ready to be filled (or hashed), in order.
+class BlockQueue
+{
+  public:
+    void push(size_t block)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            blocks.push_back(block);
+        }
+        changed.notify_one();
+    }
+
+    size_t pop()
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [this]() { return !blocks.empty(); });
+        const size_t block = blocks.front();
+        blocks.pop_front();
+        return block;
+    }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::deque<size_t> blocks;
+};
+
+double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+    return duration.count();
+}
+
+} // unnamed namespace
+
+FileChecksum computeFileChecksum(const std::string& filename)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const File file(filename);
+
+    char header[HEADER_SIZE];
+    file.readAt(header, HEADER_SIZE, 0);
+    if (readLittleEndian(header, 4) != ZIM_MAGIC) {
+        throw std::runtime_error(filename + " is not a zim file");
+    }
+    const uint64_t checksumPos = readLittleEndian(header + CHECKSUM_POS_OFFSET, 8);
+    if (checksumPos < HEADER_SIZE || checksumPos + CHECKSUM_SIZE > file.size()) {
+        throw std::runtime_error("Invalid checksum position in " + filename);
+    }
+
+    FileChecksum result;
+    unsigned char digest[CHECKSUM_SIZE];
+    file.readAt(reinterpret_cast<char*>(digest), CHECKSUM_SIZE, checksumPos);
+    result.stored = toHex(digest, CHECKSUM_SIZE);
+    result.bytes = checksumPos;
+    result.readSeconds = 0;
+    result.hashSeconds = 0;
+
+    file.adviseSequential();
+    std::vector<std::vector<char>> buffers(BLOCK_COUNT, std::vector<char>(BLOCK_SIZE));
+    std::vector<size_t> sizes(BLOCK_COUNT);
+    BlockQueue freeBlocks, fullBlocks;
+    for (size_t i = 0; i < BLOCK_COUNT; i++) {
+        freeBlocks.push(i);
+    }
+
+    std::exception_ptr error;
+    std::thread reader([&]() {
+        try {
+            for (uint64_t offset = 0; offset < checksumPos; offset += BLOCK_SIZE) {
+                const size_t block = freeBlocks.pop();
+                sizes[block] = std::min<uint64_t>(BLOCK_SIZE, checksumPos - offset);
+                const auto readStart = std::chrono::steady_clock::now();
+                file.readAt(buffers[block].data(), sizes[block], offset);
+                result.readSeconds += secondsSince(readStart);
+                fullBlocks.push(block);
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+        fullBlocks.push(NO_BLOCK);
+    });
+
+    Md5 md5;
+    for (size_t block = fullBlocks.pop(); block != NO_BLOCK; block = fullBlocks.pop()) {
+        const auto hashStart = std::chrono::steady_clock::now();
+        md5.update(buffers[block].data(), sizes[block]);
+        result.hashSeconds += secondsSince(hashStart);
+        freeBlocks.push(block);
+    }
+    reader.join();
+    if (error) {
+        std::rethrow_exception(error);
+    }
+
+    md5.finish(digest);
+    result.computed = toHex(digest, CHECKSUM_SIZE);
+    result.seconds = secondsSince(start);
+    return result;
+}
@@ -0,0 +1,29 @@
+#ifndef _ZIM_TOOL_FILECHECKSUM_H_
+#define _ZIM_TOOL_FILECHECKSUM_H_
+
+#include <string>
+#include <cstdint>
+
+struct FileChecksum
+{
+    std::string stored;   // The checksum written in the file (hexadecimal).
+    std::string computed; // The MD5 of the file up to the stored checksum.
+    uint64_t bytes;       // Bytes hashed.
+    double seconds;       // Wall time.
+    double readSeconds;   // Time spent waiting for the reads only.
+    double hashSeconds;   // Time spent hashing only.
+
+    bool isValid() const { return stored == computed; }
+};
+
+/* Compute the checksum of the zim file `filename`, reading it only once.
+ *
+ * A reader thread reads the file sequentially by large blocks, while
+ * the calling thread hashes the previous blocks, so the time is about the
+ * slowest of the reads and the hashing instead of their sum.
+ *
+ * Throw std::runtime_error if the file is not a (single part) zim file.
+ */
+FileChecksum computeFileChecksum(const std::string& filename);
+
+#endif
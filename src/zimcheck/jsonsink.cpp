@@ -0,0 +1,80 @@
+#include "jsonsink.h"
+#include "timings.h"
+
+#include <cstdio>
+#include <sstream>
+
+std::string jsonEscape(const std::string& str)
+{
+    std::string escaped;
+    escaped.reserve(str.size());
+    for (unsigned char c : str) {
+        switch (c) {
+          case '"':  escaped += "\\\""; break;
+          case '\\': escaped += "\\\\"; break;
+          case '\n': escaped += "\\n"; break;
+          case '\r': escaped += "\\r"; break;
+          case '\t': escaped += "\\t"; break;
+          default:
+            if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                escaped += buf;
+            } else {
+                escaped += c;
+            }
+        }
+    }
+    return escaped;
+}
+
+JsonLinesSink::JsonLinesSink(std::ostream& out, const std::string& file, std::mutex* mutex)
+  : out(out),
+    fileField(file.empty() ? "" : ",\"file\":\"" + jsonEscape(file) + "\""),
+    mutex(mutex)
+{}
+
+void JsonLinesSink::addLine(const std::string& line)
+{
+    std::unique_lock<std::mutex> lock;
+    if (mutex) {
+        lock = std::unique_lock<std::mutex>(*mutex);
+    }
+    out << line << '\n';
+    out.flush();
+}
+
+void JsonLinesSink::addFinding(TestType type, const std::string& message)
+{
+    addLine("{\"type\":\"finding\"" + fileField
+          + ",\"check\":\"" + testTypeToStr.at(type) + "\""
+          + ",\"level\":\"" + tagToStr.at(errormapping.at(type).first) + "\""
+          + ",\"message\":\"" + jsonEscape(message) + "\"}");
+}
+
+void JsonLinesSink::addTimings(const Timings& timings)
+{
+    std::ostringstream line;
+    line << "{\"type\":\"timings\"" << fileField << ",\"phases\":";
+    timings.writeJson(line);
+    line << "}";
+    addLine(line.str());
+}
+
+void JsonLinesSink::finish(const ErrorLogger& logger)
+{
+    std::ostringstream line;
+    line << "{\"type\":\"summary\"" << fileField
+         << ",\"status\":\"" << (logger.overalStatus() ? "pass" : "fail") << "\""
+         << ",\"checks\":[";
+    for (int i = 0; i <= int(TestType::OTHER); i++) {
+        const auto type = TestType(i);
+        line << (i ? "," : "")
+             << "{\"check\":\"" << testTypeToStr.at(type) << "\""
+             << ",\"status\":\"" << (logger.getTestResult(type) ? "pass" : "fail") << "\""
+             << ",\"count\":" << logger.getReportMsgCount(type)
+             << ",\"dropped\":" << logger.getDroppedMsgCount(type) << "}";
+    }
+    line << "]}";
+    addLine(line.str());
+}
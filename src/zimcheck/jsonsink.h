@@ -0,0 +1,46 @@
+#ifndef _ZIM_TOOL_JSONSINK_H_
+#define _ZIM_TOOL_JSONSINK_H_
+
+#include <mutex>
+#include <ostream>
+#include <string>
+
+#include "checks.h"
+
+class Timings;
+
+/* Write the findings as newline delimited JSON, one object per line, as soon
+ * as they are found:
+ *   {"type":"finding","check":"url_internal","level":"ERROR","message":"..."}
+ * the time of the phases (if measured):
+ *   {"type":"timings","phases":[{"phase":"integrity","nanoseconds":1234,"bytes":0,...},...]}
+ * and a summary as last line:
+ *   {"type":"summary","status":"fail","checks":[{"check":"favicon","status":"fail","count":0,"dropped":0},...]}
+ * If `file` is given (when checking several files), it is added to each line:
+ *   {"type":"finding","file":"wikipedia.zim",...}
+ * Each line is written at once and flushed, so that a reader of a pipe or of
+ * a growing file sees the findings of a long check as they come. It is
+ * written under `mutex` if given (when the sinks of several files checked at
+ * the same time share `out`).
+ */
+class JsonLinesSink : public ReportSink
+{
+  public:
+    explicit JsonLinesSink(std::ostream& out, const std::string& file = "",
+                           std::mutex* mutex = nullptr);
+
+    void addFinding(TestType type, const std::string& message);
+    void addTimings(const Timings& timings);
+    void finish(const ErrorLogger& logger);
+    // Write a line built by the caller (without its newline).
+    void addLine(const std::string& line);
+
+  private:
+    std::ostream& out;
+    std::string fileField; // The "file" field, if any, with its leading comma.
+    std::mutex* mutex;
+};
+
+std::string jsonEscape(const std::string& str);
+
+#endif
@@ -0,0 +1,86 @@
+#include "linkcache.h"
+#include "../tools.h"
+
+#include <cstring>
+
+namespace
+{
+
+const size_t SHARD_COUNT = 64;
+
+uint64_t hashLink(const std::string& baseUrl, const char* link, size_t size)
+{
+    const auto baseHash = hash128(baseUrl.data(), baseUrl.size());
+    return hash128(link, size, baseHash.low ^ baseUrl.size()).low;
+}
+
+bool isLink(const std::string& text, size_t baseSize,
+            const std::string& baseUrl, const char* link, size_t size)
+{
+    return baseSize == baseUrl.size()
+        && text.size() == baseSize + size
+        && std::memcmp(text.data(), baseUrl.data(), baseSize) == 0
+        && std::memcmp(text.data() + baseSize, link, size) == 0;
+}
+
+} // unnamed namespace
+
+LinkCache::LinkCache(size_t maxSize)
+  : shards(SHARD_COUNT),
+    maxShardSize(maxSize / SHARD_COUNT + 1),
+    hitCount(0),
+    missCount(0)
+{}
+
+LinkCache::Shard& LinkCache::getShard(uint64_t hash)
+{
+    // Use the high bits, the low ones are used by the unordered_map of the shard.
+    return shards[(hash >> 48) % SHARD_COUNT];
+}
+
+LinkCache::Entry* LinkCache::find(Shard& shard, uint64_t hash,
+                                  const std::string& baseUrl, const char* link, size_t size)
+{
+    const auto range = shard.targets.equal_range(hash);
+    for (auto it = range.first; it != range.second; ++it) {
+        if (isLink(it->second.text, it->second.baseSize, baseUrl, link, size)) {
+            return &it->second;
+        }
+    }
+    return nullptr;
+}
+
+bool LinkCache::get(const std::string& baseUrl, const char* link, size_t size, LinkTarget& target)
+{
+    const auto hash = hashLink(baseUrl, link, size);
+    Shard& shard = getShard(hash);
+    {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        const Entry* entry = find(shard, hash, baseUrl, link, size);
+        if (entry) {
+            target = entry->target;
+            hitCount++;
+            return true;
+        }
+    }
+    missCount++;
+    return false;
+}
+
+void LinkCache::put(const std::string& baseUrl, const char* link, size_t size, const LinkTarget& target)
+{
+    const auto hash = hashLink(baseUrl, link, size);
+    Shard& shard = getShard(hash);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Another thread may have resolved the same link meanwhile.
+    if (find(shard, hash, baseUrl, link, size)) {
+        return;
+    }
+    if (shard.targets.size() >= maxShardSize) {
+        shard.targets.clear();
+    }
+    std::string text;
+    text.reserve(baseUrl.size() + size);
+    text.append(baseUrl).append(link, size);
+    shard.targets.emplace(hash, Entry{std::move(text), baseUrl.size(), target});
+}
@@ -0,0 +1,70 @@
+#ifndef _ZIM_TOOL_LINKCACHE_H_
+#define _ZIM_TOOL_LINKCACHE_H_
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+
+// What an internal link of an article resolves to.
+struct LinkTarget
+{
+    bool outOfBounds;
+    bool found;
+    std::string path; // The normalized link (empty if out of bounds).
+    uint32_t entry;   // Index of the target, if found.
+};
+
+/* Cache of the resolution of internal links, shared by all the articles (and
+ * all the worker threads).
+ *
+ * Most of the links of an archive point to a few popular targets (css, main
+ * page, images of the skin...). Caching them saves the normalization and
+ * the lookup of the link for all the articles but the first one.
+ * A link is identified by the base url of the article and the raw link. The
+ * pair is hashed as is and both parts are compared on a match, so a probe
+ * doesn't build any key.
+ *
+ * The cache is split in shards protected by their own mutex. A shard is
+ * simply cleared when it is full: the popular links will come back quickly.
+ */
+class LinkCache
+{
+  public:
+    explicit LinkCache(size_t maxSize);
+
+    // Return true and set `target` if the link (the `size` chars at `link`) is in the cache.
+    bool get(const std::string& baseUrl, const char* link, size_t size, LinkTarget& target);
+    void put(const std::string& baseUrl, const char* link, size_t size, const LinkTarget& target);
+
+    uint64_t hits() const { return hitCount; }
+    uint64_t misses() const { return missCount; }
+
+  private:
+    struct Entry
+    {
+        std::string text; // The base url followed by the link.
+        size_t baseSize;
+        LinkTarget target;
+    };
+
+    struct Shard
+    {
+        std::mutex mutex;
+        // By hash of the (base url, link) pair.
+        std::unordered_multimap<uint64_t, Entry> targets;
+    };
+
+    Shard& getShard(uint64_t hash);
+    static Entry* find(Shard& shard, uint64_t hash,
+                       const std::string& baseUrl, const char* link, size_t size);
+
+    std::vector<Shard> shards;
+    size_t maxShardSize;
+    std::atomic<uint64_t> hitCount;
+    std::atomic<uint64_t> missCount;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include "linkgraph.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+
+size_t wordCount(uint32_t bitCount)
+{
+    return (size_t(bitCount) + 63) / 64;
+}
+
+template<typename T>
+void writeVector(std::ostream& out, const std::vector<T>& values)
+{
+    writeValue<uint64_t>(out, values.size());
+    out.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+}
+
+template<typename T>
+void readVector(std::istream& in, std::vector<T>& values)
+{
+    values.resize(readValue<uint64_t>(in));
+    if (!in.read(reinterpret_cast<char*>(values.data()), values.size() * sizeof(T))) {
+        throw std::runtime_error("Truncated file");
+    }
+}
+
+} // unnamed namespace
+
+const uint64_t LinkGraph::NO_EDGES;
+
+LinkGraph::LinkGraph(uint32_t nodeCount)
+  : firstEdge(nodeCount, NO_EDGES),
+    edgeTotal(0),
+    itemSizes(nodeCount, 0),
+    items(wordCount(nodeCount)),
+    reachable(wordCount(nodeCount))
+{}
+
+void LinkGraph::addEdges(uint32_t source, const std::vector<uint32_t>& targets)
+{
+    if (targets.empty()) {
+        return;
+    }
+    firstEdge[source] = edges.size();
+    edges.push_back(uint32_t(targets.size()));
+    edges.insert(edges.end(), targets.begin(), targets.end());
+    edgeTotal += targets.size();
+}
+
+void LinkGraph::addItem(uint32_t node, uint64_t size)
+{
+    setBit(items, node);
+    itemSizes[node] = size;
+}
+
+size_t LinkGraph::markReachable(const std::vector<uint32_t>& roots)
+{
+    // Level by level: the nodes of the next level are set in `next` while
+    // the ones of `frontier` are visited in index order.
+    std::fill(reachable.begin(), reachable.end(), 0);
+    std::vector<uint64_t> frontier(reachable.size());
+    std::vector<uint64_t> next(reachable.size());
+    size_t count = 0;
+    for (const auto root : roots) {
+        if (root >= nodeCount()) {
+            throw std::out_of_range("Root " + std::to_string(root) + " is not a node of the link graph");
+        }
+        if (!isReachable(root)) {
+            setBit(reachable, root);
+            setBit(frontier, root);
+            count++;
+        }
+    }
+    bool empty = count == 0;
+    while (!empty) {
+        empty = true;
+        for (size_t w = 0; w < frontier.size(); w++) {
+            for (uint64_t word = frontier[w]; word; word &= word - 1) {
+                const uint32_t node = uint32_t(w * 64 + __builtin_ctzll(word));
+                const uint64_t first = firstEdge[node];
+                if (first == NO_EDGES) {
+                    continue;
+                }
+                const uint32_t* target = &edges[first + 1];
+                for (const uint32_t* end = target + edges[first]; target != end; ++target) {
+                    if (*target < nodeCount() && !isReachable(*target)) {
+                        setBit(reachable, *target);
+                        setBit(next, *target);
+                        count++;
+                        empty = false;
+                    }
+                }
+            }
+        }
+        frontier.swap(next);
+        std::fill(next.begin(), next.end(), 0);
+    }
+    return count;
+}
+
+size_t LinkGraph::memoryUsage() const
+{
+    return (firstEdge.capacity() + itemSizes.capacity()) * sizeof(uint64_t)
+         + edges.capacity() * sizeof(uint32_t)
+         + (items.capacity() + reachable.capacity()) * sizeof(uint64_t);
+}
+
+void LinkGraph::save(std::ostream& out) const
+{
+    writeVector(out, firstEdge);
+    writeVector(out, edges);
+    writeValue<uint64_t>(out, edgeTotal);
+    writeVector(out, itemSizes);
+    writeVector(out, items);
+}
+
+void LinkGraph::load(std::istream& in)
+{
+    readVector(in, firstEdge);
+    readVector(in, edges);
+    edgeTotal = readValue<uint64_t>(in);
+    readVector(in, itemSizes);
+    readVector(in, items);
+    if (itemSizes.size() != nodeCount() || items.size() != wordCount(nodeCount())) {
+        throw std::runtime_error("Invalid link graph");
+    }
+    reachable.assign(items.size(), 0);
+}
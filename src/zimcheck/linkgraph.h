@@ -0,0 +1,65 @@
+#ifndef _ZIM_TOOL_LINKGRAPH_H_
+#define _ZIM_TOOL_LINKGRAPH_H_
+
+#include <vector>
+#include <iostream>
+#include <cstdint>
+#include <cstddef>
+
+/* Graph of the internal links of an archive, the nodes being the entries
+ * (by index) and the edges the links of the items and the redirections.
+ *
+ * The adjacency lists are stored one after the other in a single array of
+ * 4 bytes indexes, as a CSR (compressed sparse row) graph. As the lists are
+ * added in cluster order (not in entry order), each one starts with its
+ * size and a node only keeps the offset of its list.
+ * The reachable nodes are found by a breadth first search on bitsets
+ * (3 bits per node). With the size of the items (to report the unreachable
+ * ones without reading their entries), the memory is about 4 bytes per edge
+ * plus 16 bytes per node.
+ */
+class LinkGraph
+{
+  public:
+    explicit LinkGraph(uint32_t nodeCount = 0);
+
+    // Set the targets of `source`. Each source is given once.
+    void addEdges(uint32_t source, const std::vector<uint32_t>& targets);
+    // The node is an item of `size` bytes whose reachability matters.
+    void addItem(uint32_t node, uint64_t size);
+
+    // Find the nodes reachable from the `roots`, return their number.
+    // Throw std::out_of_range if a root is not a node.
+    size_t markReachable(const std::vector<uint32_t>& roots);
+
+    bool isItem(uint32_t node) const { return testBit(items, node); }
+    uint64_t itemSize(uint32_t node) const { return itemSizes[node]; }
+    bool isReachable(uint32_t node) const { return testBit(reachable, node); }
+
+    uint32_t nodeCount() const { return uint32_t(firstEdge.size()); }
+    size_t edgeCount() const { return edgeTotal; }
+    size_t memoryUsage() const;
+
+    // Write the graph to (or replace it by the one read from) a checkpoint.
+    void save(std::ostream& out) const;
+    void load(std::istream& in);
+
+  private:
+    static const uint64_t NO_EDGES = uint64_t(-1);
+
+    static bool testBit(const std::vector<uint64_t>& bits, uint32_t i) {
+        return (bits[i / 64] >> (i % 64)) & 1;
+    }
+    static void setBit(std::vector<uint64_t>& bits, uint32_t i) {
+        bits[i / 64] |= uint64_t(1) << (i % 64);
+    }
+
+    std::vector<uint64_t> firstEdge; // Offset of the list of each node in `edges`.
+    std::vector<uint32_t> edges;     // The lists: size, then targets.
+    size_t edgeTotal;
+    std::vector<uint64_t> itemSizes;
+    std::vector<uint64_t> items;     // Bitsets of the nodes.
+    std::vector<uint64_t> reachable;
+};
+
+#endif
@@ -28,16 +28,31 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <set>
 #include <list>
 #include <algorithm>
 #include <regex>
 #include <ctime>
+#include <cctype>
 #include <unordered_map>
+#include <fstream>
+#include <memory>
+#include <chrono>
+#include <random>
+#include <mutex>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
 
 #include "../progress.h"
 #include "../version.h"
 #include "../tools.h"
 #include "checks.h"
+#include "checker.h"
+#include "jsonsink.h"
+#include "threadpool.h"
+#include "timings.h"
 
 void displayHelp()
 {
@@ -55,25 +70,280 @@ void displayHelp()
              "-R , --redundant       Redundant data check\n"
              "-U , --url_internal    URL check - Internal URLs\n"
              "-X , --url_external    URL check - External URLs\n"
-             "-E , --mime            MIME checks\n"
+             "-E , --mime            MIME checks (declared mimetype against the content signature)\n"
+             "-1 , --unreachable     Entries not reachable from the main page by following the links\n"
+             "                       of the html articles. Not run by --all\n"
+             "-2 , --redirects[=K]   Redirection loops, redirections to missing entries and chains\n"
+             "                       of more than K redirections (default 1)\n"
+             "-6 , --title-index     Title index sorted and listing each entry once\n"
+             "-4 , --near-duplicates[=S]  Groups of html articles whose texts are similar at more than\n"
+             "                       S (between 0.9 and 1, default 0.95). Not run by --all\n"
+             "-5 , --cluster-stats   Print how the clusters are compressed (by compression and by\n"
+             "                       mimetype, histograms and incompressible clusters)\n"
              "-D , --details         Details of error\n"
-             "-B , --progress        Print progress report\n"
+             "-T , --threads=N       Number of threads used to check the articles (default 1)\n"
+             "-J , --json=FILE       Write the findings to FILE as JSON lines, as soon as they are found\n"
+             "                       (the text report then only counts them)\n"
+             "-L , --max-messages=N  Keep only N messages per test in the text report (the other ones are only counted)\n"
+             "-K , --cache=FILE      Reuse the unchanged clusters checked by a previous run (and update FILE)\n"
+             "-S , --checkpoint=FILE Save the progress of the article checks in FILE from time to time\n"
+             "-W , --resume          Resume the article checks from the checkpoint FILE, if it exists\n"
+             "                       (and append to the --json file: the findings of the checks run\n"
+             "                       again, after the checkpoint, are written again)\n"
+             "-O , --checkpoint-overhead=P  Spend at most P% of the time writing checkpoints (default 1)\n"
+             "-Q , --sample=P        Check only a random sample of P% of the clusters, and estimate\n"
+             "                       the error rates of the whole archive\n"
+             "-N , --seed=N          Seed of the random sample (default: random)\n"
+             "-3 , --max-memory=SIZE Keep the memory used by the redundancy check, the link cache and\n"
+             "                       the messages under about SIZE bytes (K, M or G suffix), using\n"
+             "                       temporary files, and print the peak memory usage (not on\n"
+             "                       Windows). The path index and the link graph are not bounded\n"
+             "-Y , --timings         Print the time spent in each phase of the checks, with the\n"
+             "                       entries and the bytes processed (also written in the JSON file)\n"
+             "-Z , --fail-fast[=CHECKS]  Stop at the first error (of one of the CHECKS, a comma separated\n"
+             "                       list of empty, checksum, integrity, metadata, favicon, main_page,\n"
+             "                       url_internal, url_external, mime, redirect,\n"
+             "                       title_index)\n"
+             "-G , --batch=LIST      Check all the zim files listed in LIST (one path per line) on a\n"
+             "                       single pool of threads (see --threads)\n"
+             "-B , --progress[=json] Print progress report (with the rate and the remaining time), or\n"
+             "                       JSON lines on the standard error with --progress=json (-B takes\n"
+             "                       no format)\n"
              "-H , --help            Displays Help\n"
              "-V , --version         Displays software version\n"
              "examples:\n"
              "zimcheck -A wikipedia.zim\n"
              "zimcheck --checksum --redundant wikipedia.zim\n"
              "zimcheck -F -R wikipedia.zim\n"
-             "zimcheck -M --favicon wikipedia.zim\n";
+             "zimcheck -M --favicon wikipedia.zim\n"
+             "zimcheck --url_internal --threads=8 wikipedia.zim\n"
+             "zimcheck --threads=16 --json=report.json --batch=zimfiles.txt\n"
+             "zimcheck --sample=5 --seed=42 wikipedia.zim\n"
+             "zimcheck --fail-fast=checksum,url_internal wikipedia.zim\n"
+             "zimcheck --max-memory=8G wikipedia.zim\n";
     return;
 }
 
+// A file checked in batch mode.
+struct BatchFile
+{
+    std::string filename;
+    ErrorLogger error;
+    std::ostringstream output; // The [INFO] lines of the checks, printed with the report.
+    std::unique_ptr<JsonLinesSink> json_sink;
+    StatusCode status = PASS;
+    std::string exception;
+    double seconds = 0;
+    Timings timings;
+    CancellationToken cancellation;
+    bool done = false;
+};
+
+// Print the report of a file checked in batch mode.
+void print_batch_report(const BatchFile& file, bool error_details, bool timed)
+{
+    std::cout << "[INFO] Zim file " << file.filename << ":" << std::endl;
+    std::cout << file.output.str();
+    file.error.report(error_details);
+    std::cout << "[INFO] Test Status: ";
+    switch (file.status) {
+      case PASS: std::cout << "Pass"; break;
+      case FAIL: std::cout << "Fail"; break;
+      case EXCEPTION: std::cout << "Exception (" << file.exception << ")"; break;
+    }
+    std::cout << " (" << file.seconds << " seconds)" << std::endl;
+    if (timed)
+        file.timings.report(std::cout);
+}
+
+/* Check the files listed in `list_filename`.
+ * The files (and the chunks of articles of each file) are scheduled on a
+ * single pool of `options.thread_count` threads, so small and big files
+ * together use all the threads without oversubscribing them.
+ * The JSON lines of all the files are written to `json` as they are found.
+ * The reports are printed in the order of the list, each one as soon as its
+ * file and all the previous ones are checked, then freed.
+ */
+StatusCode check_batch(const std::string& list_filename, const CheckOptions& options,
+                       size_t max_report_msgs, bool error_details, bool timed,
+                       std::ostream* json)
+{
+    std::ifstream list(list_filename);
+    if (!list)
+    {
+        std::cerr << "Cannot open " << list_filename << std::endl;
+        return EXCEPTION;
+    }
+    std::mutex json_mutex;
+    std::vector<std::unique_ptr<BatchFile>> files;
+    std::string line;
+    while (std::getline(list, line))
+    {
+        if (line.empty() || line[0] == '#')
+            continue;
+        std::unique_ptr<BatchFile> file(new BatchFile);
+        file->filename = line;
+        file->error.setMaxReportMsgs(max_report_msgs);
+        file->error.setFailFast(&file->cancellation, options.fail_fast);
+        if (json) {
+            file->json_sink.reset(new JsonLinesSink(*json, line, &json_mutex));
+            file->error.setReportSink(file->json_sink.get());
+        }
+        files.push_back(std::move(file));
+    }
+    std::cout << "[INFO] Checking " << files.size() << " zim files on "
+              << options.thread_count << " threads" << std::endl;
+    // The files checked at the same time (one per worker at most) share the
+    // memory budget.
+    CheckOptions file_options = options;
+    const size_t concurrent_files = std::max<size_t>(1, std::min<size_t>(options.thread_count, files.size()));
+    file_options.max_memory /= concurrent_files;
+
+    // The reports printed so far (all the files before `next_report`).
+    std::mutex report_mutex;
+    size_t next_report = 0;
+    StatusCode status_code = PASS;
+    const auto file_done = [&](BatchFile* f) {
+        if (f->json_sink) {
+            if (timed)
+                f->json_sink->addTimings(f->timings);
+            f->json_sink->finish(f->error);
+            std::ostringstream file_line;
+            file_line << "{\"type\":\"file\",\"file\":\"" << jsonEscape(f->filename) << "\""
+                      << ",\"status\":\"" << (f->status == PASS ? "pass" : f->status == FAIL ? "fail" : "exception") << "\""
+                      << ",\"seconds\":" << f->seconds;
+            if (f->status == EXCEPTION)
+                file_line << ",\"error\":\"" << jsonEscape(f->exception) << "\"";
+            file_line << "}";
+            f->json_sink->addLine(file_line.str());
+        }
+        std::lock_guard<std::mutex> lock(report_mutex);
+        f->done = true;
+        while (next_report < files.size() && files[next_report]->done)
+        {
+            print_batch_report(*files[next_report], error_details, timed);
+            status_code = std::max(status_code, files[next_report]->status);
+            files[next_report].reset();
+            next_report++;
+        }
+    };
+
+    {
+        ThreadPool pool(options.thread_count);
+        for (auto& file : files)
+        {
+            BatchFile* f = file.get();
+            pool.submitJob([f, &file_options, &pool, timed, &file_done]() {
+                const auto start = std::chrono::steady_clock::now();
+                try
+                {
+                    // The files checked at the same time print to their own buffer.
+                    CheckOptions options = file_options;
+                    options.output = &f->output;
+                    ProgressBar progress(1);
+                    run_checks(f->filename, options, f->error, progress, &pool,
+                               timed ? &f->timings : nullptr);
+                    f->status = f->error.overalStatus() ? PASS : FAIL;
+                }
+                catch (const std::exception & e)
+                {
+                    f->exception = e.what();
+                    f->status = EXCEPTION;
+                }
+                catch (...)
+                {
+                    // A job must not throw.
+                    f->exception = "unknown exception";
+                    f->status = EXCEPTION;
+                }
+                const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+                f->seconds = duration.count();
+                try
+                {
+                    file_done(f);
+                }
+                catch (...)
+                {
+                    // A job must not throw (the output failed).
+                }
+            });
+        }
+        pool.wait();
+    }
+    if (json)
+        json->flush();
+    return status_code;
+}
+
+/* Parse the argument of --fail-fast: a comma separated list of checks
+ * (all the error level checks if none is given).
+ */
+bool parse_fail_fast(const char* arg, std::set<TestType>& types)
+{
+    types.clear();
+    if (!arg) {
+        for (const auto& m : errormapping) {
+            if (m.second.first == LogTag::ERROR)
+                types.insert(m.first);
+        }
+        return true;
+    }
+    std::istringstream list(arg);
+    std::string name;
+    while (std::getline(list, name, ','))
+    {
+        const auto it = std::find_if(testTypeToStr.begin(), testTypeToStr.end(),
+                                     [&name](const std::pair<const TestType, std::string>& t) {
+                                         return t.second == name;
+                                     });
+        if (it == testTypeToStr.end() || errormapping.at(it->first).first != LogTag::ERROR)
+        {
+            std::cerr << "Invalid check for --fail-fast: " << name << std::endl;
+            return false;
+        }
+        types.insert(it->first);
+    }
+    return true;
+}
+
+/* Parse a size in bytes, with an optional K, M or G suffix (powers of 1024).
+ * Return 0 if invalid.
+ */
+size_t parse_size(const char* arg)
+{
+    char* end = nullptr;
+    const double value = strtod(arg, &end);
+    double unit = 1;
+    switch (toupper(*end)) {
+      case 'K': unit = 1024.0; end++; break;
+      case 'M': unit = 1024.0 * 1024; end++; break;
+      case 'G': unit = 1024.0 * 1024 * 1024; end++; break;
+    }
+    if (end == arg || *end != '\0' || value <= 0)
+        return 0;
+    return size_t(value * unit);
+}
+
+// Not printed on Windows (no getrusage).
+void printPeakMemory()
+{
+#ifndef _WIN32
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        // In kilobytes on Linux.
+        std::cout << "[INFO] Peak memory usage: " << usage.ru_maxrss / 1024 << " MB" << std::endl;
+    }
+#endif
+}
+
 int main (int argc, char **argv)
 {
     // To calculate the total time taken by the program to run.
-    time_t startTime,endTime;
-    double  timeDiffference;
-    time( &startTime);
+    const auto startTime = std::chrono::steady_clock::now();
+    const auto printTotalTime = [&startTime]() {
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - startTime;
+        std::cout << "[INFO] Total time taken by zimcheck: " << duration.count() << " seconds." << std::endl;
+    };
 
     // The boolean values which will be used to store the output from
     // getopt_long().  These boolean values will be then read by the
@@ -90,9 +360,28 @@ int main (int argc, char **argv)
     bool url_check_external = false;
     bool empty_check = false;
     bool mime_check = false;
+    bool unreachable_check = false;
+    bool redirect_check = false;
+    unsigned int max_redirect_chain = 1;
+    bool title_index_check = false;
+    double near_duplicates = 0;
+    bool cluster_stats = false;
     bool error_details = false;
     bool no_args = true;
     bool help = false;
+    unsigned int thread_count = 1;
+    std::string json_filename;
+    std::string cache_filename;
+    std::string checkpoint_filename;
+    bool resume = false;
+    double checkpoint_overhead = 1;
+    bool timed = false;
+    std::set<TestType> fail_fast;
+    CancellationToken cancellation;
+    std::string batch_filename;
+    double sample_percent = 0;
+    uint64_t seed = std::random_device()();
+    size_t max_memory = 0;
 
     std::string filename = "";
     ProgressBar progress(1);
@@ -106,7 +395,7 @@ int main (int argc, char **argv)
         static struct option long_options[] =
         {
             { "all",          no_argument, 0, 'A'},
-            { "progress",     no_argument, 0, 'B'},
+            { "progress",     optional_argument, 0, 'B'},
             { "empty",        no_argument, 0, '0'},
             { "checksum",     no_argument, 0, 'C'},
             { "integrity",    no_argument, 0, 'I'},
@@ -117,13 +406,31 @@ int main (int argc, char **argv)
             { "url_internal", no_argument, 0, 'U'},
             { "url_external", no_argument, 0, 'X'},
             { "mime",         no_argument, 0, 'E'},
+            { "unreachable",  no_argument, 0, '1'},
+            { "redirects",    optional_argument, 0, '2'},
+            { "title-index",  no_argument, 0, '6'},
+            { "near-duplicates", optional_argument, 0, '4'},
+            { "cluster-stats", no_argument, 0, '5'},
             { "details",      no_argument, 0, 'D'},
+            { "threads",      required_argument, 0, 'T'},
+            { "json",         required_argument, 0, 'J'},
+            { "max-messages", required_argument, 0, 'L'},
+            { "cache",        required_argument, 0, 'K'},
+            { "checkpoint",   required_argument, 0, 'S'},
+            { "resume",       no_argument, 0, 'W'},
+            { "checkpoint-overhead", required_argument, 0, 'O'},
+            { "batch",        required_argument, 0, 'G'},
+            { "sample",       required_argument, 0, 'Q'},
+            { "seed",         required_argument, 0, 'N'},
+            { "timings",      no_argument, 0, 'Y'},
+            { "fail-fast",    optional_argument, 0, 'Z'},
+            { "max-memory",   required_argument, 0, '3'},
             { "help",         no_argument, 0, 'H'},
             { "version",      no_argument, 0, 'V'},
             { 0, 0, 0, 0}
         };
         int option_index = 0;
-        int c = getopt_long (argc, argv, "ACIMFPRUXEDHBVacimfpruxedhbv",
+        int c = getopt_long (argc, argv, "ACIMFPRUXEDHBVWY12::3:4::56Z::T:J:L:K:S:O:G:Q:N:acimfpruxedhbvwyz::t:j:l:k:s:o:g:q:n:",
                              long_options, &option_index);
         //c = getopt (argc, argv, "ACMFPRUXED");
         if(c == -1)
@@ -155,7 +462,12 @@ int main (int argc, char **argv)
             break;
         case 'B':
         case 'b':
-            progress.set_progress_report(true);
+            // Only --progress takes the format: -B may be grouped with other flags.
+            if (optarg && std::string(optarg) != "json") {
+                std::cerr << "Invalid progress format: " << optarg << std::endl;
+                return 1;
+            }
+            progress.set_progress_report(true, optarg ? ProgressBar::Format::JSON : ProgressBar::Format::TEXT);
             break;
         case 'F':
         case 'f':
@@ -187,6 +499,38 @@ int main (int argc, char **argv)
             mime_check = true;
             no_args = false;
             break;
+        case '1':
+            unreachable_check = true;
+            no_args = false;
+            break;
+        case '2':
+            redirect_check = true;
+            no_args = false;
+            if (optarg) {
+                const int k = atoi(optarg);
+                if (k <= 0) {
+                    std::cerr << "Invalid redirection chain length: " << optarg << std::endl;
+                    return 1;
+                }
+                max_redirect_chain = k;
+            }
+            break;
+        case '6':
+            title_index_check = true;
+            no_args = false;
+            break;
+        case '4':
+            near_duplicates = optarg ? atof(optarg) : 0.95;
+            if (near_duplicates < 0.9 || near_duplicates > 1) {
+                std::cerr << "Invalid similarity (between 0.9 and 1): " << optarg << std::endl;
+                return 1;
+            }
+            no_args = false;
+            break;
+        case '5':
+            cluster_stats = true;
+            no_args = false;
+            break;
         case 'D':
         case 'd':
             error_details = true;
@@ -195,6 +539,90 @@ int main (int argc, char **argv)
         case 'h':
             help=true;
             break;
+        case 'T':
+        case 't':
+        {
+            const int n = atoi(optarg);
+            if (n <= 0) {
+                std::cerr << "Invalid number of threads: " << optarg << std::endl;
+                return 1;
+            }
+            thread_count = n;
+            break;
+        }
+        case 'J':
+        case 'j':
+            json_filename = optarg;
+            break;
+        case 'L':
+        case 'l':
+        {
+            const int n = atoi(optarg);
+            if (n <= 0) {
+                std::cerr << "Invalid maximum number of messages: " << optarg << std::endl;
+                return 1;
+            }
+            error.setMaxReportMsgs(n);
+            break;
+        }
+        case 'K':
+        case 'k':
+            cache_filename = optarg;
+            break;
+        case 'S':
+        case 's':
+            checkpoint_filename = optarg;
+            break;
+        case 'W':
+        case 'w':
+            resume = true;
+            break;
+        case 'Y':
+        case 'y':
+            timed = true;
+            break;
+        case 'Z':
+        case 'z':
+            if (!parse_fail_fast(optarg, fail_fast))
+                return 1;
+            break;
+        case 'O':
+        case 'o':
+        {
+            const double p = atof(optarg);
+            if (p <= 0 || p > 100) {
+                std::cerr << "Invalid checkpoint overhead: " << optarg << std::endl;
+                return 1;
+            }
+            checkpoint_overhead = p;
+            break;
+        }
+        case 'G':
+        case 'g':
+            batch_filename = optarg;
+            break;
+        case 'Q':
+        case 'q':
+        {
+            const double p = atof(optarg);
+            if (p <= 0 || p > 100) {
+                std::cerr << "Invalid sample percentage: " << optarg << std::endl;
+                return 1;
+            }
+            sample_percent = p;
+            break;
+        }
+        case 'N':
+        case 'n':
+            seed = strtoull(optarg, nullptr, 10);
+            break;
+        case '3':
+            max_memory = parse_size(optarg);
+            if (!max_memory) {
+                std::cerr << "Invalid memory size: " << optarg << std::endl;
+                return 1;
+            }
+            break;
         case '?':
             if (optopt == 'c')
             {
@@ -225,11 +653,60 @@ int main (int argc, char **argv)
         return -1;
     }
 
+    CheckOptions options;
+    options.checksum = checksum;
+    options.integrity = integrity;
+    options.metadata = metadata;
+    options.favicon = favicon;
+    options.main_page = main_page;
+    options.redundant_data = redundant_data;
+    options.url_check = url_check;
+    options.url_check_external = url_check_external;
+    options.empty_check = empty_check;
+    options.mime_check = mime_check;
+    options.unreachable_check = unreachable_check;
+    options.redirect_check = redirect_check;
+    options.max_redirect_chain = max_redirect_chain;
+    options.title_index_check = title_index_check;
+    options.near_duplicates = near_duplicates;
+    options.cluster_stats = cluster_stats;
+    options.thread_count = thread_count;
+    options.cache_filename = cache_filename;
+    options.checkpoint_filename = checkpoint_filename;
+    options.resume = resume;
+    options.checkpoint_overhead = checkpoint_overhead;
+    options.sample_percent = sample_percent;
+    options.seed = seed;
+    options.fail_fast = fail_fast;
+    options.max_memory = max_memory;
+
     //If no arguments are given to the program, all the tests are performed.
     if ( run_all || no_args )
     {
-        checksum = integrity = metadata = favicon = main_page = redundant_data =
-          url_check = url_check_external = mime_check = empty_check = true;
+        options.selectAll();
+    }
+
+    error.setFailFast(&cancellation, fail_fast);
+
+    if(resume && checkpoint_filename.empty())
+    {
+        std::cerr<<"--resume needs a checkpoint file (--checkpoint)\n";
+        return -1;
+    }
+    if(sample_percent > 0 && !checkpoint_filename.empty())
+    {
+        std::cerr<<"--checkpoint cannot be used with --sample\n";
+        return -1;
+    }
+    if(max_memory && !checkpoint_filename.empty())
+    {
+        std::cerr<<"--checkpoint cannot be used with --max-memory\n";
+        return -1;
+    }
+    if(!batch_filename.empty() && (!cache_filename.empty() || !checkpoint_filename.empty()))
+    {
+        std::cerr<<"--cache and --checkpoint cannot be used with --batch\n";
+        return -1;
     }
 
     //Obtaining filename from argument list
@@ -241,100 +718,56 @@ int main (int argc, char **argv)
             filename = argv[i];
         }
     }
-    if(filename == "")
+    if(filename == "" && batch_filename.empty())
     {
         std::cerr<<"No file provided as argument\n";
         displayHelp();
         return -1;
     }
-    //Tests.
-    try
+    std::ofstream json_file;
+    std::unique_ptr<JsonLinesSink> json_sink;
+    if (!json_filename.empty())
     {
-        std::cout << "[INFO] Checking zim file " << filename << std::endl;
-
-        //Test 0: Low-level ZIM-file structure integrity checks
-        if(integrity)
-            test_integrity(filename, error);
-
-        // Does it make sense to do the other checks if the integrity
-        // check fails?
-        zim::Archive archive( filename );
-
-        //Test 1: Internal Checksum
-        if(checksum) {
-            if ( integrity ) {
-                std::cout << "[INFO] Avoiding redundant checksum test"
-                          << " (already performed by the integrity check)."
-                          << std::endl;
-            } else {
-                test_checksum(archive, error);
-            }
+        // A resumed run adds its findings to the ones of the interrupted run.
+        json_file.open(json_filename, resume ? std::ios::app : std::ios::trunc);
+        if (!json_file)
+        {
+            std::cerr << "Cannot open " << json_filename << std::endl;
+            return -1;
         }
+        if (batch_filename.empty())
+        {
+            json_sink.reset(new JsonLinesSink(json_file));
+            error.setReportSink(json_sink.get());
+        }
+    }
 
-        //Test 2: Metadata Entries:
-        //The file is searched for the compulsory metadata entries.
-        if(metadata)
-            test_metadata(archive, error);
-
-        //Test 3: Test for Favicon.
-        if(favicon)
-            test_favicon(archive, error);
-
-
-        //Test 4: Main Page Entry
-        if(main_page)
-            test_mainpage(archive, error);
-
-        /* Now we want to avoid to loop on the tests but on the article.
-         *
-         * If we loop of the tests we will have :
-         *
-         * for (test: tests) {
-         *     for(article: articles) {
-         *          data = article->getData();
-         *          ...
-         *     }
-         * }
-         *
-         * And so we will get several the data of an article (and so decompression and so).
-         * By looping on the articles first, we have :
-         *
-         * for (article: articles) {
-         *     data = article->getData() {
-         *     for (test: tests) {
-         *         ...
-         *     }
-         * }
-         */
-
-        if ( redundant_data || url_check || url_check_external || empty_check )
-          test_articles(archive, error, progress, redundant_data, url_check, url_check_external, empty_check);
+    if (!batch_filename.empty())
+    {
+        status_code = check_batch(batch_filename, options, error.getMaxReportMsgs(), error_details,
+                                  timed, json_filename.empty() ? nullptr : &json_file);
+        printTotalTime();
+        if (max_memory || timed)
+            printPeakMemory();
+        return status_code;
+    }
 
+    //Tests.
+    try
+    {
+        std::cout << "[INFO] Checking zim file " << filename << std::endl;
 
-        //Test 8: Verifying MIME Types
-        //MIME Checks is intended to verify that all the MIME types of all different articles are listed in the file header.
-        //As of now, there is no method in the existing zimlib to get the list of MIME types listed in the file header.
-        //A bug has been reported for the above problem, and once the bug is fixed, it will be used to add MIME checks to the zimcheck tool.
-        /*
-                if(mime_check)
-                {
-                    std::cout<<"\nTest 8: Verifying MIME Types.. \n"<<std::flush;
-                    progress.reset(articleCount);
-                    test_=true;
-                    for (zim::File::const_iterator it = f.begin(); it != f.end(); ++it)
-                    {
-                        progress.report();
-                    }
-                    if(test_)
-                        std::cout<<"\nPass\n";
-                    else
-                    {
-                        std::cout<<"\nFail\n";
-                    }
-                }
-        */
+        Timings timings;
+        run_checks(filename, options, error, progress, nullptr, timed ? &timings : nullptr);
 
         error.report(error_details);
+        if (timed)
+            timings.report(std::cout);
+        if (json_sink) {
+            if (timed)
+                json_sink->addTimings(timings);
+            json_sink->finish(error);
+        }
         std::cout << "[INFO] Overall Test Status: ";
         if( error.overalStatus())
         {
@@ -346,10 +779,9 @@ int main (int argc, char **argv)
             std::cout << "Fail" << std::endl;
             status_code = FAIL;
         }
-        time( &endTime );
-
-        timeDiffference = difftime( endTime , startTime );
-        std::cout << "[INFO] Total time taken by zimcheck: " << timeDiffference << " seconds."<<std::endl;
+        printTotalTime();
+        if (max_memory || timed)
+            printPeakMemory();
 
     }
     catch (const std::exception & e)
@@ -0,0 +1,29 @@
+#ifndef _ZIM_TOOL_MD5_H_
+#define _ZIM_TOOL_MD5_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+
+// MD5 (RFC 1321), the hash of the zim checksum.
+class Md5
+{
+  public:
+    Md5();
+
+    void update(const char* data, size_t size);
+    // The 16 bytes of the hash. No update is possible afterwards.
+    void finish(unsigned char digest[16]);
+
+  private:
+    void transform(const unsigned char block[64]);
+
+    uint32_t state[4];
+    uint64_t length; // In bytes.
+    unsigned char buffer[64];
+};
+
+// The digest as lower case hexadecimal, as zim::Archive::getChecksum().
+std::string toHex(const unsigned char* data, size_t size);
+
+#endif
@@ -0,0 +1,161 @@
+#include "mimesniffer.h"
+
+#include <vector>
+#include <map>
+#include <set>
+#include <sstream>
+
+namespace
+{
+
+struct MagicNumber
+{
+    const char* pattern;
+    const char* mask; // nullptr to compare all the bytes of the pattern.
+    size_t size;
+    // The mimetypes a content with this signature may be declared with,
+    // the first one being the sniffed mimetype. "type/*" accepts any subtype.
+    const char* mimetypes;
+    // All the contents of these mimetypes have this signature (or another
+    // one of the table for the same mimetype).
+    bool strict;
+};
+
+const MagicNumber MAGIC_NUMBERS[] = {
+    { "\x89PNG\r\n\x1a\n", nullptr, 8, "image/png", true },
+    { "\xff\xd8\xff", nullptr, 3, "image/jpeg image/jpg image/pjpeg", true },
+    { "GIF87a", nullptr, 6, "image/gif", true },
+    { "GIF89a", nullptr, 6, "image/gif", true },
+    { "RIFF\0\0\0\0WEBP", "\xff\xff\xff\xff\0\0\0\0\xff\xff\xff\xff", 12, "image/webp", true },
+    { "BM\0\0\0\0\0\0\0\0", "\xff\xff\0\0\0\0\xff\xff\xff\xff", 10, "image/bmp image/x-bmp image/x-ms-bmp", true },
+    { "\0\0\1\0", nullptr, 4, "image/x-icon image/vnd.microsoft.icon", true },
+    { "\0\0\2\0", nullptr, 4, "image/x-icon image/vnd.microsoft.icon", true },
+    { "II*\0", nullptr, 4, "image/tiff", true },
+    { "MM\0*", nullptr, 4, "image/tiff", true },
+    { "%PDF-", nullptr, 5, "application/pdf", true },
+    { "wOFF", nullptr, 4, "font/woff application/font-woff application/x-font-woff", true },
+    { "wOF2", nullptr, 4, "font/woff2 application/font-woff2", true },
+    { "\0\1\0\0", nullptr, 4, "font/ttf font/sfnt application/x-font-ttf application/font-sfnt application/x-font-truetype", false },
+    { "OTTO\0", nullptr, 5, "font/otf font/sfnt application/vnd.ms-opentype application/x-font-opentype application/font-sfnt", false },
+    { "OggS\0", nullptr, 5, "audio/ogg video/ogg application/ogg audio/opus audio/vorbis", true },
+    { "fLaC", nullptr, 4, "audio/flac audio/x-flac", true },
+    { "RIFF\0\0\0\0WAVE", "\xff\xff\xff\xff\0\0\0\0\xff\xff\xff\xff", 12, "audio/wav audio/x-wav audio/wave audio/vnd.wave", true },
+    { "RIFF\0\0\0\0AVI ", "\xff\xff\xff\xff\0\0\0\0\xff\xff\xff\xff", 12, "video/x-msvideo video/avi", true },
+    { "\x1a\x45\xdf\xa3", nullptr, 4, "video/webm audio/webm video/x-matroska audio/x-matroska", true },
+    { "\0\0\0\0ftyp", "\0\0\0\0\xff\xff\xff\xff", 8, "video/mp4 audio/mp4 video/quicktime video/x-m4v audio/x-m4a video/3gpp audio/3gpp image/avif image/heic image/heif", false },
+    { "ID3\0\0", "\xff\xff\xff\xf8\xff", 5, "audio/mpeg audio/mp3", false },
+    { "\x1f\x8b\x08", nullptr, 3, "application/gzip application/x-gzip", true },
+    { "PK\3\4", nullptr, 4, "application/zip application/*", false },
+    { "\0asm", nullptr, 4, "application/wasm", true },
+};
+
+struct SnifferTables
+{
+    // The magic numbers which may match a content, by first byte.
+    std::vector<const MagicNumber*> byFirstByte[256];
+    // The sniffed mimetype of each magic number.
+    std::map<const MagicNumber*, std::string> sniffedMimetypes;
+    // The mimetypes accepted for a sniffed mimetype.
+    std::map<std::string, std::vector<std::string>> accepted;
+    // The declared mimetypes which must have a signature.
+    std::set<std::string> strict;
+
+    SnifferTables()
+    {
+        for (const auto& magic : MAGIC_NUMBERS) {
+            for (int byte = 0; byte < 256; byte++) {
+                const unsigned char mask = magic.mask ? magic.mask[0] : 0xff;
+                if ((byte & mask) == (static_cast<unsigned char>(magic.pattern[0]) & mask)) {
+                    byFirstByte[byte].push_back(&magic);
+                }
+            }
+            std::istringstream mimetypes(magic.mimetypes);
+            std::string sniffed, mimetype;
+            mimetypes >> sniffed;
+            sniffedMimetypes[&magic] = sniffed;
+            auto& acceptedMimetypes = accepted[sniffed];
+            acceptedMimetypes.push_back(sniffed);
+            if (magic.strict) {
+                strict.insert(sniffed);
+            }
+            while (mimetypes >> mimetype) {
+                acceptedMimetypes.push_back(mimetype);
+                if (magic.strict) {
+                    strict.insert(mimetype);
+                }
+            }
+        }
+    }
+};
+
+const SnifferTables& getTables()
+{
+    static const SnifferTables tables;
+    return tables;
+}
+
+bool matches(const MagicNumber& magic, const char* data, size_t size)
+{
+    if (size < magic.size) {
+        return false;
+    }
+    for (size_t i = 0; i < magic.size; i++) {
+        const unsigned char mask = magic.mask ? magic.mask[i] : 0xff;
+        if ((data[i] & mask) != (magic.pattern[i] & mask)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// "Text/HTML; charset=utf-8" -> "text/html"
+std::string baseMimetype(const std::string& mimetype)
+{
+    std::string base;
+    for (char c : mimetype.substr(0, mimetype.find(';'))) {
+        if (c != ' ' && c != '\t') {
+            base += (c >= 'A' && c <= 'Z') ? c - 'A' + 'a' : c;
+        }
+    }
+    return base;
+}
+
+} // unnamed namespace
+
+std::string sniffMimetype(const char* data, size_t size)
+{
+    if (size == 0) {
+        return "";
+    }
+    const SnifferTables& tables = getTables();
+    for (const auto magic : tables.byFirstByte[static_cast<unsigned char>(data[0])]) {
+        if (matches(*magic, data, size)) {
+            return tables.sniffedMimetypes.at(magic);
+        }
+    }
+    return "";
+}
+
+bool isMimetypeCoherent(const std::string& declared, const std::string& sniffed)
+{
+    const SnifferTables& tables = getTables();
+    const std::string base = baseMimetype(declared);
+    if (base == "application/octet-stream") {
+        return true;
+    }
+    if (sniffed.empty()) {
+        return tables.strict.find(base) == tables.strict.end();
+    }
+    const auto it = tables.accepted.find(sniffed);
+    if (it == tables.accepted.end()) {
+        return true;
+    }
+    for (const auto& mimetype : it->second) {
+        if (mimetype == base
+         || (mimetype.size() > 1 && mimetype.compare(mimetype.size() - 2, 2, "/*") == 0
+             && base.compare(0, mimetype.size() - 1, mimetype, 0, mimetype.size() - 1) == 0)) {
+            return true;
+        }
+    }
+    return false;
+}
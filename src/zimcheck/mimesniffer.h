@@ -0,0 +1,25 @@
+#ifndef _ZIM_TOOL_MIMESNIFFER_H_
+#define _ZIM_TOOL_MIMESNIFFER_H_
+
+#include <string>
+#include <cstddef>
+
+// Number of bytes at the start of a content used to sniff its format.
+const size_t SNIFF_SIZE = 64;
+
+/* Detect the format of a content from its first bytes (its magic number) and
+ * return it as a mimetype, or an empty string if the format is unknown.
+ * Only binary formats with a signature are detected, text formats
+ * (html, css, svg...) are not.
+ */
+std::string sniffMimetype(const char* data, size_t size);
+
+/* Return false if the `declared` mimetype of a content contradicts its
+ * `sniffed` format:
+ * - the content has a known signature not matching the declared mimetype, or
+ * - the declared mimetype is a format always having a signature (png,
+ *   jpeg, pdf...) but the content has none.
+ */
+bool isMimetypeCoherent(const std::string& declared, const std::string& sniffed);
+
+#endif
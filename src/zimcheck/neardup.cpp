@@ -0,0 +1,268 @@
+#include "neardup.h"
+
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+
+// Below this number of words, the texts are not compared.
+const size_t MIN_WORDS = 8;
+const size_t SHINGLE_WORDS = 3;
+// Longest html entity skipped (as "&nbsp;").
+const size_t MAX_ENTITY_SIZE = 10;
+
+const uint32_t NO_GROUP = uint32_t(-1);
+const uint32_t HAS_GROUP = NO_GROUP - 1;
+
+uint64_t mix(uint64_t h)
+{
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdULL;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ULL;
+    h ^= h >> 33;
+    return h;
+}
+
+uint64_t rotate(uint64_t h, unsigned int bits)
+{
+    return (h << bits) | (h >> (64 - bits));
+}
+
+bool isWordChar(unsigned char c)
+{
+    // The bytes of the non ASCII UTF-8 characters are part of the words.
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c >= 0x80;
+}
+
+char lower(char c)
+{
+    return (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+}
+
+// Find `needle` (in lower case) in `html` from `pos`, ignoring the case.
+size_t findNoCase(const std::string& html, const char* needle, size_t pos)
+{
+    const size_t size = std::strlen(needle);
+    for (; pos + size <= html.size(); pos++) {
+        size_t i = 0;
+        while (i < size && lower(html[pos + i]) == needle[i]) {
+            i++;
+        }
+        if (i == size) {
+            return pos;
+        }
+    }
+    return std::string::npos;
+}
+
+// Skip the tag (or the comment) starting at `pos`, with the content of the
+// scripts and of the styles. Return the position after it.
+size_t skipTag(const std::string& html, size_t pos)
+{
+    if (html.compare(pos, 4, "<!--") == 0) {
+        const size_t end = html.find("-->", pos + 4);
+        return end == std::string::npos ? html.size() : end + 3;
+    }
+    size_t nameEnd = pos + 1;
+    while (nameEnd < html.size() && isWordChar(html[nameEnd])) {
+        nameEnd++;
+    }
+    std::string name;
+    for (size_t i = pos + 1; i < nameEnd; i++) {
+        name += lower(html[i]);
+    }
+    size_t end = html.find('>', nameEnd);
+    if (end == std::string::npos) {
+        return html.size();
+    }
+    if (name == "script" || name == "style") {
+        end = findNoCase(html, name == "script" ? "</script" : "</style", end);
+        if (end == std::string::npos) {
+            return html.size();
+        }
+        end = html.find('>', end);
+        if (end == std::string::npos) {
+            return html.size();
+        }
+    }
+    return end + 1;
+}
+
+// Find the set containing `i` (halving the paths).
+uint32_t findRoot(std::vector<uint32_t>& parent, uint32_t i)
+{
+    while (parent[i] != i) {
+        parent[i] = parent[parent[i]];
+        i = parent[i];
+    }
+    return i;
+}
+
+// The smallest position is the root, so the groups don't depend on the
+// order of the unions.
+void unite(std::vector<uint32_t>& parent, uint32_t a, uint32_t b)
+{
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a < b) {
+        parent[b] = a;
+    } else if (b < a) {
+        parent[a] = b;
+    }
+}
+
+} // unnamed namespace
+
+const size_t NearDuplicateFinder::MAX_NEIGHBOURS;
+
+uint64_t textSignature(const std::string& html)
+{
+    int32_t weights[64] = {0};
+    uint64_t words[SHINGLE_WORDS] = {0};
+    size_t wordCount = 0;
+
+    size_t pos = 0;
+    while (pos < html.size()) {
+        const char c = html[pos];
+        if (c == '<') {
+            pos = skipTag(html, pos);
+            continue;
+        }
+        if (c == '&') {
+            const size_t end = html.find(';', pos);
+            if (end != std::string::npos && end - pos <= MAX_ENTITY_SIZE) {
+                pos = end + 1;
+                continue;
+            }
+        }
+        if (!isWordChar(c)) {
+            pos++;
+            continue;
+        }
+
+        // FNV-1a of the word in lower case.
+        uint64_t word = 0xcbf29ce484222325ULL;
+        for (; pos < html.size() && isWordChar(html[pos]); pos++) {
+            word = (word ^ uint8_t(lower(html[pos]))) * 0x100000001b3ULL;
+        }
+        std::copy(words + 1, words + SHINGLE_WORDS, words);
+        words[SHINGLE_WORDS - 1] = word;
+        if (++wordCount < SHINGLE_WORDS) {
+            continue;
+        }
+
+        uint64_t shingle = 0;
+        for (size_t i = 0; i < SHINGLE_WORDS; i++) {
+            shingle ^= rotate(words[i], 1 + 21 * i);
+        }
+        shingle = mix(shingle);
+        for (unsigned int bit = 0; bit < 64; bit++) {
+            weights[bit] += ((shingle >> bit) & 1) ? 1 : -1;
+        }
+    }
+
+    if (wordCount < MIN_WORDS) {
+        return 0;
+    }
+    uint64_t signature = 0;
+    for (unsigned int bit = 0; bit < 64; bit++) {
+        if (weights[bit] > 0) {
+            signature |= uint64_t(1) << bit;
+        }
+    }
+    return signature;
+}
+
+NearDuplicateFinder::NearDuplicateFinder(double similarity)
+  : distance(static_cast<unsigned int>(std::floor((1 - similarity) * 64 + 1e-9)))
+{}
+
+void NearDuplicateFinder::add(uint64_t signature, uint32_t item)
+{
+    signatures.push_back(signature);
+    items.push_back(item);
+}
+
+std::vector<std::vector<uint32_t>> NearDuplicateFinder::findGroups() const
+{
+    const uint32_t count = uint32_t(signatures.size());
+    std::vector<uint32_t> parent(count);
+    std::iota(parent.begin(), parent.end(), 0);
+    std::vector<uint32_t> order(count);
+    // The first position of each different signature of a bucket.
+    std::vector<uint32_t> heads;
+
+    const unsigned int bands = distance + 1;
+    unsigned int shift = 0;
+    for (unsigned int band = 0; band < bands; band++) {
+        const unsigned int width = 64 / bands + (band < 64 % bands ? 1 : 0);
+        const uint64_t mask = width == 64 ? ~uint64_t(0) : ((uint64_t(1) << width) - 1) << shift;
+        shift += width;
+
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) {
+            const uint64_t bandA = signatures[a] & mask;
+            const uint64_t bandB = signatures[b] & mask;
+            if (bandA != bandB) {
+                return bandA < bandB;
+            }
+            if (signatures[a] != signatures[b]) {
+                return signatures[a] < signatures[b];
+            }
+            return a < b;
+        });
+
+        for (uint32_t begin = 0; begin < count; ) {
+            const uint64_t bucket = signatures[order[begin]] & mask;
+            uint32_t end = begin;
+            heads.clear();
+            for (; end < count && (signatures[order[end]] & mask) == bucket; end++) {
+                if (end > begin && signatures[order[end]] == signatures[order[end - 1]]) {
+                    unite(parent, order[end - 1], order[end]);
+                } else {
+                    heads.push_back(order[end]);
+                }
+            }
+            if (distance > 0) {
+                for (size_t i = 0; i < heads.size(); i++) {
+                    const size_t last = std::min(heads.size(), i + 1 + MAX_NEIGHBOURS);
+                    for (size_t j = i + 1; j < last; j++) {
+                        if (signatureDistance(signatures[heads[i]], signatures[heads[j]]) <= distance) {
+                            unite(parent, heads[i], heads[j]);
+                        }
+                    }
+                }
+            }
+            begin = end;
+        }
+    }
+
+    // The roots are the first positions of the groups: mark the ones having
+    // other items, then create the groups when reaching their root, so that
+    // they are ordered by their first added item.
+    std::vector<uint32_t>& groupOf = order;
+    std::fill(groupOf.begin(), groupOf.end(), NO_GROUP);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t root = findRoot(parent, i);
+        if (root != i) {
+            groupOf[root] = HAS_GROUP;
+        }
+    }
+    std::vector<std::vector<uint32_t>> groups;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t root = findRoot(parent, i);
+        if (groupOf[root] == NO_GROUP) {
+            continue;
+        }
+        if (root == i) {
+            groupOf[i] = uint32_t(groups.size());
+            groups.emplace_back();
+        }
+        groups[groupOf[root]].push_back(items[i]);
+    }
+    return groups;
+}
@@ -0,0 +1,58 @@
+#ifndef _ZIM_TOOL_NEARDUP_H_
+#define _ZIM_TOOL_NEARDUP_H_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/* SimHash of the visible text of a html page (the tags, the comments and the
+ * content of the scripts and of the styles being skipped), computed on the
+ * shingles of 3 consecutive words. Pages with similar texts have signatures
+ * differing by a few bits only.
+ * Return 0 (no signature) if the text is too short to be compared.
+ */
+uint64_t textSignature(const std::string& html);
+
+// Number of different bits of two signatures.
+inline unsigned int signatureDistance(uint64_t a, uint64_t b)
+{
+    return __builtin_popcountll(a ^ b);
+}
+
+/* Group the items whose signatures are near (at most `maxDistance()` bits
+ * differ, from the `similarity` ratio of identical bits).
+ *
+ * The signatures are not compared all together: as two signatures differing
+ * by at most d bits have at least one of d+1 bands of bits in common
+ * (pigeonhole), only the signatures sharing a band are compared (locality
+ * sensitive hashing). Signatures sharing a band are sorted, so identical
+ * ones are grouped in a linear time, and each one is only compared to the
+ * MAX_NEIGHBOURS next different ones: a huge bucket (a common boilerplate)
+ * doesn't make the search quadratic.
+ * The memory is 12 bytes per signature (and 8 more while searching).
+ */
+class NearDuplicateFinder
+{
+  public:
+    static const size_t MAX_NEIGHBOURS = 64;
+
+    // `similarity` is between 0.9 and 1.
+    explicit NearDuplicateFinder(double similarity);
+
+    void add(uint64_t signature, uint32_t item);
+
+    // The groups of at least 2 items, each one in add order, ordered by
+    // their first added item.
+    std::vector<std::vector<uint32_t>> findGroups() const;
+
+    unsigned int maxDistance() const { return distance; }
+    size_t size() const { return signatures.size(); }
+
+  private:
+    unsigned int distance;
+    std::vector<uint64_t> signatures;
+    std::vector<uint32_t> items;
+};
+
+#endif
@@ -0,0 +1,113 @@
+#include "pathindex.h"
+#include "direntscanner.h"
+#include "../tools.h"
+
+#include <cstring>
+#include <zim/archive.h>
+
+namespace
+{
+
+const uint32_t EMPTY_SLOT = PathIndex::NOT_FOUND;
+
+uint32_t hashPath(const char* path, size_t length)
+{
+    return uint32_t(hash128(path, length).low);
+}
+
+} // unnamed namespace
+
+const uint32_t PathIndex::NOT_FOUND;
+
+PathIndex::PathIndex()
+  : count(0)
+{}
+
+PathIndex::PathIndex(const zim::Archive& archive)
+  : count(0)
+{
+    // Keep the load factor under 0.85, Robin Hood hashing keeps the probes short.
+    const size_t entryCount = archive.getEntryCount();
+    slots.resize(entryCount + entryCount / 6 + 1, Slot{EMPTY_SLOT, 0});
+    offsets.reserve(entryCount + 1);
+
+    // The paths are copied from the dirents, read directly from the file if
+    // possible (without building an entry for each one).
+    const DirentScanner scanner(archive);
+    const bool withNamespace = !archive.hasNewNamespaceScheme();
+    DirentView dirent;
+    for (uint32_t i = 0; i < entryCount; i++) {
+        const size_t start = arena.size();
+        if (scanner.get(i, dirent)) {
+            if (withNamespace) {
+                arena.push_back(dirent.ns);
+                arena.push_back('/');
+            }
+            arena.insert(arena.end(), dirent.path, dirent.path + dirent.pathSize);
+        } else {
+            const auto path = archive.getEntryByPath(i).getPath();
+            arena.insert(arena.end(), path.begin(), path.end());
+        }
+        offsets.push_back(start);
+        insert(Slot{i, hashPath(arena.data() + start, arena.size() - start)});
+    }
+    offsets.push_back(arena.size());
+    arena.shrink_to_fit();
+}
+
+size_t PathIndex::idealPosition(uint32_t hash) const
+{
+    // Map the hash on [0, slots.size()) without a modulo.
+    return (uint64_t(hash) * slots.size()) >> 32;
+}
+
+size_t PathIndex::probeDistance(const Slot& slot, size_t pos) const
+{
+    const size_t ideal = idealPosition(slot.hash);
+    return pos >= ideal ? pos - ideal : pos + slots.size() - ideal;
+}
+
+void PathIndex::insert(const Slot& newSlot)
+{
+    Slot slot = newSlot;
+    size_t pos = idealPosition(slot.hash);
+    size_t distance = 0;
+    while (true) {
+        Slot& current = slots[pos];
+        if (current.entry == EMPTY_SLOT) {
+            current = slot;
+            count++;
+            return;
+        }
+        // Take the place of richer slots (closer to their ideal position).
+        const size_t currentDistance = probeDistance(current, pos);
+        if (currentDistance < distance) {
+            std::swap(current, slot);
+            distance = currentDistance;
+        }
+        pos = pos + 1 == slots.size() ? 0 : pos + 1;
+        distance++;
+    }
+}
+
+uint32_t PathIndex::find(const std::string& path) const
+{
+    if (count == 0) {
+        return NOT_FOUND;
+    }
+    const uint32_t hash = hashPath(path.data(), path.size());
+    size_t pos = idealPosition(hash);
+    for (size_t distance = 0; ; distance++) {
+        const Slot& slot = slots[pos];
+        // A Robin Hood table is sorted by probe distance, so the path cannot
+        // be after a slot closer to its ideal position than us.
+        if (slot.entry == EMPTY_SLOT || probeDistance(slot, pos) < distance) {
+            return NOT_FOUND;
+        }
+        if (slot.hash == hash && offsets[slot.entry + 1] - offsets[slot.entry] == path.size()
+         && memcmp(arena.data() + offsets[slot.entry], path.data(), path.size()) == 0) {
+            return slot.entry;
+        }
+        pos = pos + 1 == slots.size() ? 0 : pos + 1;
+    }
+}
@@ -0,0 +1,55 @@
+#ifndef _ZIM_TOOL_PATHINDEX_H_
+#define _ZIM_TOOL_PATHINDEX_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+namespace zim {
+  class Archive;
+}
+
+/* Index of the paths of all the (user) entries of an archive.
+ *
+ * Used by the internal url check to resolve links without searching the
+ * dirents of the archive (`zim::Archive::hasEntryByPath()` does a binary
+ * search, reading a dirent at each step).
+ * All the paths are interned in one arena, in entry (path) order, and
+ * indexed by a Robin Hood hash table of 8 bytes slots.
+ */
+class PathIndex
+{
+  public:
+    PathIndex();
+    explicit PathIndex(const zim::Archive& archive);
+
+    static const uint32_t NOT_FOUND = uint32_t(-1);
+
+    // Return the index of the entry of `path`, or NOT_FOUND.
+    uint32_t find(const std::string& path) const;
+    bool contains(const std::string& path) const { return find(path) != NOT_FOUND; }
+
+    size_t size() const { return count; }
+    size_t memoryUsage() const {
+        return arena.capacity() + slots.capacity() * sizeof(Slot)
+             + offsets.capacity() * sizeof(uint64_t);
+    }
+
+  private:
+    struct Slot
+    {
+        uint32_t entry; // The path is [offsets[entry], offsets[entry+1]) in the arena.
+        uint32_t hash;
+    };
+
+    void insert(const Slot& slot);
+    size_t idealPosition(uint32_t hash) const;
+    size_t probeDistance(const Slot& slot, size_t pos) const;
+
+    std::vector<char> arena;
+    std::vector<uint64_t> offsets;
+    std::vector<Slot> slots;
+    size_t count;
+};
+
+#endif
@@ -0,0 +1,86 @@
+#include "redirects.h"
+
+#include <algorithm>
+
+const uint32_t RedirectTable::NONE = uint32_t(-1);
+const uint32_t RedirectTable::LOOP = uint32_t(-2);
+const uint32_t RedirectTable::DANGLING = uint32_t(-3);
+const uint32_t RedirectTable::IN_PROGRESS = uint32_t(-1);
+
+RedirectTable::RedirectTable(uint32_t entryCount)
+  : next(entryCount, NONE),
+    length(entryCount, 0),
+    targeted((size_t(entryCount) + 63) / 64),
+    redirectTotal(0)
+{}
+
+void RedirectTable::setTarget(uint32_t entry, uint32_t target)
+{
+    if (next[entry] == NONE) {
+        redirectTotal++;
+    }
+    next[entry] = target;
+    if (target < entryCount()) {
+        targeted[target / 64] |= uint64_t(1) << (target % 64);
+    }
+}
+
+void RedirectTable::resolve()
+{
+    // The redirections of the chain being walked, marked IN_PROGRESS.
+    std::vector<uint32_t> chain;
+    for (uint32_t start = 0; start < entryCount(); start++) {
+        if (next[start] == NONE || length[start] != 0) {
+            continue;
+        }
+
+        uint32_t current = start;
+        uint32_t finalTarget;
+        uint32_t baseLength;
+        while (true) {
+            chain.push_back(current);
+            length[current] = IN_PROGRESS;
+            const uint32_t target = next[current];
+            if (target >= entryCount()) {
+                finalTarget = DANGLING;
+                baseLength = 0;
+                break;
+            }
+            if (next[target] == NONE) {
+                finalTarget = target;
+                baseLength = 0;
+                break;
+            }
+            if (length[target] == IN_PROGRESS) {
+                // `target` is in the chain: the chain ends in a new loop.
+                const auto loopStart = std::find(chain.begin(), chain.end(), target);
+                std::vector<uint32_t> loop(loopStart, chain.end());
+                std::rotate(loop.begin(), std::min_element(loop.begin(), loop.end()), loop.end());
+                const uint32_t loopSize = uint32_t(loop.size());
+                for (const auto entry : loop) {
+                    next[entry] = LOOP;
+                    length[entry] = loopSize;
+                }
+                loops.push_back(std::move(loop));
+                chain.erase(loopStart, chain.end());
+                finalTarget = LOOP;
+                baseLength = loopSize;
+                break;
+            }
+            if (length[target] != 0) {
+                // Already resolved.
+                finalTarget = next[target];
+                baseLength = length[target];
+                break;
+            }
+            current = target;
+        }
+
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            next[*it] = finalTarget;
+            length[*it] = ++baseLength;
+        }
+        chain.clear();
+    }
+    std::sort(loops.begin(), loops.end());
+}
@@ -0,0 +1,59 @@
+#ifndef _ZIM_TOOL_REDIRECTS_H_
+#define _ZIM_TOOL_REDIRECTS_H_
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/* The redirections of an archive, by entry index.
+ *
+ * Once all the targets are set, resolve() follows each redirection to the
+ * item it finally leads to. The chains are walked only once: the target of
+ * each redirection of a chain is replaced by the final item (path
+ * compression), so the next walks reaching it stop there. This takes a time
+ * linear in the number of entries and 8 bytes per entry (plus a bit for
+ * the targeted entries).
+ */
+class RedirectTable
+{
+  public:
+    // Special values of getFinalTarget().
+    static const uint32_t NONE;     // Not a redirection.
+    static const uint32_t LOOP;     // The redirection leads to a loop.
+    static const uint32_t DANGLING; // The redirection leads to a missing entry.
+
+    explicit RedirectTable(uint32_t entryCount = 0);
+
+    // `entry` redirects to `target` (which may be out of range).
+    void setTarget(uint32_t entry, uint32_t target);
+
+    void resolve();
+
+    // The item `entry` leads to, NONE, LOOP or DANGLING.
+    uint32_t getFinalTarget(uint32_t entry) const { return next[entry]; }
+    // Number of redirections followed to get the final target. For a
+    // redirection leading to a loop, the ones up to the loop plus the ones
+    // of the loop, so following them meets each entry of the chain once.
+    uint32_t getChainLength(uint32_t entry) const { return length[entry]; }
+    // Whether another redirection targets `entry`.
+    bool isTargeted(uint32_t entry) const {
+        return (targeted[entry / 64] >> (entry % 64)) & 1;
+    }
+
+    // The loops found, each one given once from its smallest entry.
+    const std::vector<std::vector<uint32_t>>& getLoops() const { return loops; }
+
+    uint32_t entryCount() const { return uint32_t(next.size()); }
+    size_t redirectCount() const { return redirectTotal; }
+
+  private:
+    static const uint32_t IN_PROGRESS;
+
+    std::vector<uint32_t> next;   // The target, then the final target once resolved.
+    std::vector<uint32_t> length; // 0 until resolved (or not a redirection).
+    std::vector<uint64_t> targeted;
+    std::vector<std::vector<uint32_t>> loops;
+    size_t redirectTotal;
+};
+
+#endif
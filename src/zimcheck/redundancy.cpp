@@ -0,0 +1,57 @@
+#include "redundancy.h"
+
+#include <tuple>
+
+const zim::entry_index_type RedundancyFinder::PENDING = ContentHashTable::NO_ENTRY - 1;
+
+bool RedundancyFinder::Content::operator<(const Content& other) const
+{
+    return std::tie(hashLow, hashHigh, size, order)
+         < std::tie(other.hashLow, other.hashHigh, other.size, other.order);
+}
+
+// Half of the memory for the table, a quarter for the buffer of each sorter.
+RedundancyFinder::RedundancyFinder(size_t maxMemory)
+  : spilling(false),
+    addCount(0),
+    contents(maxMemory / 4),
+    duplicates(maxMemory / 4)
+{
+    table.setMaxMemory(maxMemory / 2);
+}
+
+zim::entry_index_type RedundancyFinder::add(const Hash128& hash, zim::size_type size, zim::entry_index_type index)
+{
+    const uint64_t order = addCount++;
+    if (!spilling && !table.isFull()) {
+        return table.insert(hash, size, index);
+    }
+    spilling = true;
+    const auto first = table.find(hash, size);
+    if (first != ContentHashTable::NO_ENTRY) {
+        duplicates.add(Duplicate{order, first, index});
+    } else {
+        contents.add(Content{hash.low, hash.high, uint32_t(size), index, order});
+    }
+    return PENDING;
+}
+
+void RedundancyFinder::finish(const std::function<void(zim::entry_index_type, zim::entry_index_type)>& report)
+{
+    // The contents are sorted by content, then by order: the first of each
+    // group is the first item with this content.
+    bool hasPrevious = false;
+    Content first;
+    contents.forEach([&](const Content& content) {
+        if (hasPrevious && content.hashLow == first.hashLow && content.hashHigh == first.hashHigh
+         && content.size == first.size) {
+            duplicates.add(Duplicate{content.order, first.index, content.index});
+        } else {
+            first = content;
+            hasPrevious = true;
+        }
+    });
+    duplicates.forEach([&](const Duplicate& duplicate) {
+        report(duplicate.first, duplicate.index);
+    });
+}
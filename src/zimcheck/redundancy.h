@@ -0,0 +1,70 @@
+#ifndef _ZIM_TOOL_REDUNDANCY_H_
+#define _ZIM_TOOL_REDUNDANCY_H_
+
+#include <functional>
+#include <cstdint>
+
+#include <zim/zim.h>
+
+#include "contenthashtable.h"
+#include "spill.h"
+
+/* Find the items having the same content as a previous one, within a
+ * memory budget.
+ *
+ * The contents are inserted in a ContentHashTable until it is full. Then the
+ * new contents are only looked for in the table, and the ones not found are
+ * sorted on disk by content (ExternalSorter) to find their duplicates once
+ * all the contents are added. From then on, the redundant items are only
+ * given at the end, in the order of their add(), so the report is the same
+ * as without budget.
+ */
+class RedundancyFinder
+{
+  public:
+    static const zim::entry_index_type PENDING;
+
+    // 0 for no memory limit.
+    explicit RedundancyFinder(size_t maxMemory = 0);
+
+    // Add the content of the item `index`. Return the index of the first
+    // item with the same content, NO_ENTRY if the content is new, or PENDING
+    // once the table is full (see finish()).
+    zim::entry_index_type add(const Hash128& hash, zim::size_type size, zim::entry_index_type index);
+
+    // Call `report(first, index)` for the redundant items added as PENDING.
+    void finish(const std::function<void(zim::entry_index_type, zim::entry_index_type)>& report);
+
+    bool isSpilling() const { return spilling; }
+    size_t spilledCount() const { return contents.size(); }
+    ContentHashTable& getTable() { return table; }
+
+  private:
+    struct Content
+    {
+        uint64_t hashLow;
+        uint64_t hashHigh;
+        uint32_t size;
+        zim::entry_index_type index;
+        uint64_t order; // Rank of the add() call.
+
+        bool operator<(const Content& other) const;
+    };
+
+    struct Duplicate
+    {
+        uint64_t order;
+        zim::entry_index_type first;
+        zim::entry_index_type index;
+
+        bool operator<(const Duplicate& other) const { return order < other.order; }
+    };
+
+    ContentHashTable table;
+    bool spilling;
+    uint64_t addCount;
+    ExternalSorter<Content> contents;     // Not in the table.
+    ExternalSorter<Duplicate> duplicates; // Found once spilling.
+};
+
+#endif
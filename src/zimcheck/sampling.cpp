@@ -0,0 +1,77 @@
+#include "sampling.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include "../tools.h"
+
+namespace
+{
+
+const double Z_95 = 1.96;
+
+} // unnamed namespace
+
+bool isClusterSampled(const Sampling& sampling, zim::cluster_index_type cluster)
+{
+    const uint64_t value = cluster;
+    const Hash128 hash = hash128(reinterpret_cast<const char*>(&value), sizeof(value), sampling.seed);
+    // 2^-64 * hash.low is uniform in [0, 1).
+    return std::ldexp(double(hash.low), -64) * 100 < sampling.percent;
+}
+
+SampleEstimator::SampleEstimator(double fraction)
+  : fraction(fraction),
+    clusterCount(0),
+    sumN(0),
+    sumN2(0),
+    sumY(),
+    sumY2(),
+    sumYN()
+{}
+
+void SampleEstimator::addCluster(const ClusterSample& sample)
+{
+    if (sample.items == 0) {
+        return;
+    }
+    const double n = sample.items;
+    clusterCount++;
+    sumN += sample.items;
+    sumN2 += n * n;
+    for (size_t i = 0; i < TEST_TYPE_COUNT; i++) {
+        const double y = sample.failed[i];
+        sumY[i] += sample.failed[i];
+        sumY2[i] += y * y;
+        sumYN[i] += y * n;
+    }
+}
+
+SampleEstimator::Estimate SampleEstimator::estimate(TestType type) const
+{
+    const size_t i = size_t(type);
+    Estimate estimate{0, 0, 1, sumY[i]};
+    if (sumN == 0) {
+        return estimate;
+    }
+    const double N = sumN;
+    const double r = sumY[i] / N;
+    estimate.rate = r;
+    if (sumY[i] == 0) {
+        // Nothing found: "rule of three" upper bound.
+        estimate.high = std::min(1.0, 3 / N);
+        return estimate;
+    }
+    if (clusterCount < 2) {
+        return estimate;
+    }
+    // Linearized variance of the ratio estimator sum(y)/sum(n):
+    //   (1 - f) * m / (m - 1) * sum((y - r * n)^2) / N^2
+    const double m = clusterCount;
+    const double residuals = std::max(0.0, sumY2[i] - 2 * r * sumYN[i] + r * r * sumN2);
+    const double variance = (1 - fraction) * m / (m - 1) * residuals / (N * N);
+    const double margin = Z_95 * std::sqrt(variance);
+    estimate.low = std::max(0.0, r - margin);
+    estimate.high = std::min(1.0, r + margin);
+    return estimate;
+}
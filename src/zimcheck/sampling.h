@@ -0,0 +1,67 @@
+#ifndef _ZIM_TOOL_SAMPLING_H_
+#define _ZIM_TOOL_SAMPLING_H_
+
+#include <cstdint>
+#include <cstddef>
+
+#include <zim/zim.h>
+
+#include "checks.h"
+
+// Check only a random subset of the clusters (see --sample).
+struct Sampling
+{
+    double percent; // Percentage of the clusters to check.
+    uint64_t seed;
+};
+
+// Is the cluster part of the sample? The choice only depends on the seed and
+// on the cluster, so it is the same whatever the number of threads.
+bool isClusterSampled(const Sampling& sampling, zim::cluster_index_type cluster);
+
+const size_t TEST_TYPE_COUNT = size_t(TestType::OTHER) + 1;
+
+// The items of a sampled cluster and the ones having a finding, by test type.
+struct ClusterSample
+{
+    size_t items = 0;
+    size_t failed[TEST_TYPE_COUNT] = {};
+};
+
+/* Estimate the rate of items having a finding in the whole archive from
+ * the sampled clusters.
+ *
+ * The clusters (not the items) are the sampling unit, and the items of a
+ * cluster are often alike (same kind of pages, same errors), so the rate is
+ * a ratio estimator whose variance is computed from the cluster totals.
+ */
+class SampleEstimator
+{
+  public:
+    explicit SampleEstimator(double fraction);
+
+    void addCluster(const ClusterSample& sample);
+
+    struct Estimate
+    {
+        double rate;
+        double low;  // Bounds of the 95% confidence interval.
+        double high;
+        size_t failed;
+    };
+    Estimate estimate(TestType type) const;
+
+    size_t getClusterCount() const { return clusterCount; }
+    size_t getItemCount() const { return sumN; }
+
+  private:
+    double fraction;
+    size_t clusterCount;
+    size_t sumN;
+    double sumN2;
+    size_t sumY[TEST_TYPE_COUNT];
+    double sumY2[TEST_TYPE_COUNT];
+    double sumYN[TEST_TYPE_COUNT];
+};
+
+#endif
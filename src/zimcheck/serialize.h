@@ -0,0 +1,53 @@
+#ifndef _ZIM_TOOL_SERIALIZE_H_
+#define _ZIM_TOOL_SERIALIZE_H_
+
+#include <string>
+#include <iostream>
+#include <stdexcept>
+#include <cstdint>
+
+/* Helpers to write and read the binary files of zimcheck (cluster cache,
+ * checkpoints). Values are written in the native byte order: these files are
+ * only meant to be read again on the same machine.
+ */
+
+template<typename T>
+void writeValue(std::ostream& out, T value)
+{
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+inline void writeString(std::ostream& out, const std::string& str)
+{
+    writeValue<uint32_t>(out, str.size());
+    out.write(str.data(), str.size());
+}
+
+// Throw a std::runtime_error if the file is truncated.
+template<typename T>
+T readValue(std::istream& in)
+{
+    T value;
+    if (!in.read(reinterpret_cast<char*>(&value), sizeof(value))) {
+        throw std::runtime_error("Truncated file");
+    }
+    return value;
+}
+
+// `maxSize` bounds the size read before allocating the string (the bytes
+// left in the file, for instance), so a corrupted size cannot exhaust the
+// memory.
+inline std::string readString(std::istream& in, uint64_t maxSize = uint64_t(-1))
+{
+    const auto size = readValue<uint32_t>(in);
+    if (size > maxSize) {
+        throw std::runtime_error("Invalid string size");
+    }
+    std::string str(size, '\0');
+    if (!in.read(&str[0], str.size())) {
+        throw std::runtime_error("Truncated file");
+    }
+    return str;
+}
+
+#endif
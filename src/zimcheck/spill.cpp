@@ -0,0 +1,214 @@
+#include "spill.h"
+
+#include <cstdlib>
+
+#ifdef _WIN32
+# define NOMINMAX
+# include <climits>
+# include <fcntl.h>
+# include <io.h>
+# include <sys/stat.h>
+# include <windows.h>
+#else
+# include <unistd.h>
+#endif
+
+namespace
+{
+
+const size_t STREAM_BUFFER_SIZE = 1024 * 1024;
+
+#ifdef _WIN32
+
+std::string temporaryDirectory()
+{
+    char dir[MAX_PATH + 1];
+    const DWORD size = GetTempPathA(sizeof(dir), dir);
+    return size > 0 && size <= MAX_PATH ? std::string(dir, size) : ".\\";
+}
+
+// The file is deleted when it is closed (_O_TEMPORARY).
+int createTemporaryFile()
+{
+    const std::string dir = temporaryDirectory();
+    char path[MAX_PATH];
+    int fd = -1;
+    if (GetTempFileNameA(dir.c_str(), "zim", 0, path) != 0) {
+        fd = _open(path, _O_RDWR | _O_BINARY | _O_TEMPORARY, _S_IREAD | _S_IWRITE);
+    }
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create a temporary file in " + dir);
+    }
+    return fd;
+}
+
+void closeFile(int fd)
+{
+    _close(fd);
+}
+
+// A temporary file is used by one thread at a time: seeking then reading
+// (or writing) is the same as pread (or pwrite).
+int64_t readAt(int fd, char* data, size_t size, uint64_t offset)
+{
+    if (_lseeki64(fd, offset, SEEK_SET) < 0) {
+        return -1;
+    }
+    return _read(fd, data, unsigned(std::min<size_t>(size, INT_MAX)));
+}
+
+int64_t writeAt(int fd, const char* data, size_t size, uint64_t offset)
+{
+    if (_lseeki64(fd, offset, SEEK_SET) < 0) {
+        return -1;
+    }
+    return _write(fd, data, unsigned(std::min<size_t>(size, INT_MAX)));
+}
+
+#else
+
+std::string temporaryDirectory()
+{
+    const char* dir = std::getenv("TMPDIR");
+    return dir && *dir ? dir : "/tmp";
+}
+
+int createTemporaryFile()
+{
+    std::string path = temporaryDirectory() + "/zimcheck-XXXXXX";
+    const int fd = mkstemp(&path[0]);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create a temporary file in " + temporaryDirectory());
+    }
+    unlink(path.c_str());
+    return fd;
+}
+
+void closeFile(int fd)
+{
+    close(fd);
+}
+
+int64_t readAt(int fd, char* data, size_t size, uint64_t offset)
+{
+    return pread(fd, data, size, offset);
+}
+
+int64_t writeAt(int fd, const char* data, size_t size, uint64_t offset)
+{
+    return pwrite(fd, data, size, offset);
+}
+
+#endif
+
+} // unnamed namespace
+
+TemporaryFile::Buffer::Buffer(int fd)
+  : fd(fd),
+    fileSize(0),
+    readOffset(0)
+{}
+
+void TemporaryFile::Buffer::startWrite()
+{
+    release();
+    data.resize(STREAM_BUFFER_SIZE);
+    setp(data.data(), data.data() + data.size());
+}
+
+void TemporaryFile::Buffer::startRead()
+{
+    release();
+    data.resize(STREAM_BUFFER_SIZE);
+    readOffset = 0;
+    setg(data.data(), data.data(), data.data());
+}
+
+void TemporaryFile::Buffer::release()
+{
+    flushWrite();
+    setp(nullptr, nullptr);
+    setg(nullptr, nullptr, nullptr);
+    std::vector<char>().swap(data);
+}
+
+bool TemporaryFile::Buffer::flushWrite()
+{
+    const char* begin = pbase();
+    while (begin < pptr()) {
+        const auto written = writeAt(fd, begin, pptr() - begin, fileSize);
+        if (written <= 0) {
+            return false;
+        }
+        begin += written;
+        fileSize += written;
+    }
+    setp(pbase(), epptr());
+    return true;
+}
+
+TemporaryFile::Buffer::int_type TemporaryFile::Buffer::overflow(int_type c)
+{
+    if (!pbase() || !flushWrite()) {
+        return traits_type::eof();
+    }
+    if (!traits_type::eq_int_type(c, traits_type::eof())) {
+        *pptr() = traits_type::to_char_type(c);
+        pbump(1);
+    }
+    return traits_type::not_eof(c);
+}
+
+TemporaryFile::Buffer::int_type TemporaryFile::Buffer::underflow()
+{
+    if (!eback()) {
+        return traits_type::eof();
+    }
+    if (gptr() < egptr()) {
+        return traits_type::to_int_type(*gptr());
+    }
+    const auto size = std::min<uint64_t>(data.size(), fileSize - readOffset);
+    const int64_t read = size ? readAt(fd, data.data(), size, readOffset) : 0;
+    if (read <= 0) {
+        return traits_type::eof();
+    }
+    readOffset += read;
+    setg(data.data(), data.data(), data.data() + read);
+    return traits_type::to_int_type(*gptr());
+}
+
+int TemporaryFile::Buffer::sync()
+{
+    return flushWrite() ? 0 : -1;
+}
+
+TemporaryFile::TemporaryFile()
+  : fd(createTemporaryFile()),
+    buffer(fd),
+    stream(&buffer)
+{}
+
+TemporaryFile::~TemporaryFile()
+{
+    closeFile(fd);
+}
+
+std::iostream& TemporaryFile::append()
+{
+    buffer.startWrite();
+    stream.clear();
+    return stream;
+}
+
+std::iostream& TemporaryFile::rewind()
+{
+    buffer.startRead();
+    stream.clear();
+    return stream;
+}
+
+void TemporaryFile::release()
+{
+    stream.flush();
+    buffer.release();
+}
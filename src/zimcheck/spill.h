@@ -0,0 +1,219 @@
+#ifndef _ZIM_TOOL_SPILL_H_
+#define _ZIM_TOOL_SPILL_H_
+
+#include <algorithm>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <queue>
+#include <stdexcept>
+#include <streambuf>
+#include <string>
+#include <utility>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+/* Anonymous file in the temporary directory ($TMPDIR or /tmp), deleted
+ * as soon as it is created: it only lives as long as the object, even if
+ * zimcheck is killed. On Windows, the file (in GetTempPath()) is deleted
+ * when it is closed.
+ * The file is written and read with the helpers of serialize.h.
+ *
+ * The stream buffer (1 MB) is only allocated while the file is used: many
+ * files can be kept (the runs of an ExternalSorter, the messages of each
+ * test) while only the ones being read or written take memory.
+ */
+class TemporaryFile
+{
+  public:
+    TemporaryFile();
+    ~TemporaryFile();
+    TemporaryFile(const TemporaryFile&) = delete;
+    TemporaryFile& operator=(const TemporaryFile&) = delete;
+
+    // Move to the end of the file to append (or to its start to read).
+    std::iostream& append();
+    std::iostream& rewind();
+
+    // Write what is buffered and free the buffer, until the next append()
+    // or rewind().
+    void release();
+
+  private:
+    class Buffer : public std::streambuf
+    {
+      public:
+        explicit Buffer(int fd);
+
+        void startWrite();
+        void startRead();
+        void release();
+
+      protected:
+        int_type overflow(int_type c) override;
+        int_type underflow() override;
+        int sync() override;
+
+      private:
+        bool flushWrite();
+
+        int fd;
+        std::vector<char> data;
+        uint64_t fileSize;
+        uint64_t readOffset; // Offset of the end of the get area in the file.
+    };
+
+    int fd;
+    Buffer buffer;
+    std::iostream stream;
+};
+
+/* Sort more records than the memory can hold (external merge sort).
+ *
+ * The records are kept in memory until `maxMemory` bytes are used, then
+ * sorted and written to a temporary file (a run). Once all the records are
+ * added, the runs are merged. `Record` must be trivially copyable and the
+ * order of `Less` total, so the result doesn't depend on the runs.
+ */
+template<typename Record, typename Less = std::less<Record>>
+class ExternalSorter
+{
+  public:
+    explicit ExternalSorter(size_t maxMemory, Less less = Less())
+      : maxRecords(std::max<size_t>(1, maxMemory / sizeof(Record))),
+        less(less),
+        count(0)
+    {}
+
+    void add(const Record& record)
+    {
+        if (buffer.size() >= maxRecords) {
+            writeRun();
+        } else if (buffer.capacity() == 0) {
+            buffer.reserve(maxRecords);
+        }
+        buffer.push_back(record);
+        count++;
+    }
+
+    size_t size() const { return count; }
+    size_t runCount() const { return runs.size(); }
+
+    // Call `f` on all the records, in order. The sorter is empty afterwards.
+    template<typename F>
+    void forEach(F f)
+    {
+        if (runs.empty()) {
+            std::sort(buffer.begin(), buffer.end(), less);
+            for (const auto& record : buffer) {
+                f(record);
+            }
+        } else {
+            if (!buffer.empty()) {
+                writeRun();
+            }
+            std::vector<Record>().swap(buffer);
+            merge(f);
+        }
+        std::vector<Record>().swap(buffer);
+        runs.clear();
+        count = 0;
+    }
+
+  private:
+    void writeRun()
+    {
+        std::sort(buffer.begin(), buffer.end(), less);
+        std::unique_ptr<TemporaryFile> run(new TemporaryFile());
+        std::ostream& out = run->append();
+        out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size() * sizeof(Record));
+        run->release();
+        if (!out) {
+            throw std::runtime_error("Cannot write a temporary file");
+        }
+        runSizes.push_back(buffer.size());
+        runs.push_back(std::move(run));
+        buffer.clear();
+    }
+
+    template<typename F>
+    void merge(F f)
+    {
+        // Each run read takes a buffer, so at most MAX_FAN_IN runs are merged
+        // at once: the runs are merged by groups into longer runs until there
+        // are few enough.
+        while (runs.size() > MAX_FAN_IN) {
+            std::vector<std::unique_ptr<TemporaryFile>> mergedRuns;
+            std::vector<size_t> mergedSizes;
+            for (size_t first = 0; first < runs.size(); first += MAX_FAN_IN) {
+                std::unique_ptr<TemporaryFile> run(new TemporaryFile());
+                std::ostream& out = run->append();
+                size_t size = 0;
+                mergeRuns(first, std::min(first + MAX_FAN_IN, runs.size()), [&](const Record& record) {
+                    out.write(reinterpret_cast<const char*>(&record), sizeof(Record));
+                    size++;
+                });
+                run->release();
+                if (!out) {
+                    throw std::runtime_error("Cannot write a temporary file");
+                }
+                mergedRuns.push_back(std::move(run));
+                mergedSizes.push_back(size);
+            }
+            runs.swap(mergedRuns);
+            runSizes.swap(mergedSizes);
+        }
+        mergeRuns(0, runs.size(), f);
+        runSizes.clear();
+    }
+
+    // Merge the runs [first, last), which are deleted once read.
+    template<typename F>
+    void mergeRuns(size_t first, size_t last, F f)
+    {
+        // The smallest next record of each run, the smallest on top.
+        typedef std::pair<Record, size_t> Head;
+        const auto greater = [this](const Head& a, const Head& b) { return less(b.first, a.first); };
+        std::priority_queue<Head, std::vector<Head>, decltype(greater)> heads(greater);
+        std::vector<std::istream*> inputs(runs.size(), nullptr);
+        for (size_t i = first; i < last; i++) {
+            inputs[i] = &runs[i]->rewind();
+            pushNext(heads, inputs, i);
+        }
+        while (!heads.empty()) {
+            const Head head = heads.top();
+            heads.pop();
+            f(head.first);
+            pushNext(heads, inputs, head.second);
+        }
+        for (size_t i = first; i < last; i++) {
+            runs[i].reset();
+        }
+    }
+
+    template<typename Queue>
+    void pushNext(Queue& heads, const std::vector<std::istream*>& inputs, size_t run)
+    {
+        if (runSizes[run] == 0) {
+            return;
+        }
+        runSizes[run]--;
+        Record record;
+        if (!inputs[run]->read(reinterpret_cast<char*>(&record), sizeof(Record))) {
+            throw std::runtime_error("Truncated temporary file");
+        }
+        heads.push(std::make_pair(record, run));
+    }
+
+    static const size_t MAX_FAN_IN = 16;
+
+    const size_t maxRecords;
+    Less less;
+    size_t count;
+    std::vector<Record> buffer;
+    std::vector<std::unique_ptr<TemporaryFile>> runs;
+    std::vector<size_t> runSizes; // Records not read yet.
+};
+
+#endif
@@ -0,0 +1,194 @@
+#include "threadpool.h"
+
+#include <algorithm>
+
+namespace
+{
+
+// The pool and the index of the worker running on this thread, if any.
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local unsigned int currentIndex = 0;
+
+} // unnamed namespace
+
+ThreadPool::ThreadPool(unsigned int threadCount)
+  : nextQueue(0),
+    pending(0),
+    events(0),
+    stopping(false)
+{
+    // Without worker, the tasks still need a queue.
+    for (unsigned int i = 0; i < std::max(threadCount, 1U); ++i) {
+        queues.emplace_back(new TaskQueue);
+    }
+    for (unsigned int i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    changed.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task)
+{
+    pending++;
+    // A worker keeps the tasks it submits (they likely work on the same
+    // data as itself), the other threads spread them.
+    const unsigned int index = currentPool == this
+                             ? currentIndex
+                             : nextQueue++ % queues.size();
+    {
+        std::lock_guard<std::mutex> lock(queues[index]->mutex);
+        queues[index]->tasks.push_back(std::move(task));
+    }
+    signal();
+}
+
+void ThreadPool::submitFirst(std::function<void()> task)
+{
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(firstTasks.mutex);
+        firstTasks.tasks.push_back(std::move(task));
+    }
+    signal();
+}
+
+void ThreadPool::submitJob(std::function<void()> job)
+{
+    pending++;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    signal();
+}
+
+bool ThreadPool::popTask(std::function<void()>& task)
+{
+    {
+        std::lock_guard<std::mutex> lock(firstTasks.mutex);
+        if (!firstTasks.tasks.empty()) {
+            task = std::move(firstTasks.tasks.front());
+            firstTasks.tasks.pop_front();
+            return true;
+        }
+    }
+    // Tasks are taken in submission order (from the front), by their owner
+    // as by the thieves: the chunks are merged in order, the first ones are
+    // needed first. The tasks submitted first are taken before all of them.
+    const unsigned int first = currentPool == this ? currentIndex : 0;
+    for (unsigned int i = 0; i < queues.size(); ++i) {
+        TaskQueue& queue = *queues[(first + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ThreadPool::popJob(std::function<void()>& job)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    if (jobs.empty()) {
+        return false;
+    }
+    job = std::move(jobs.front());
+    jobs.pop_front();
+    return true;
+}
+
+void ThreadPool::run(std::function<void()>& work)
+{
+    work();
+    work = nullptr; // Release what the work holds before signaling its end.
+    pending--;
+    signal();
+}
+
+void ThreadPool::signal()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        events++;
+    }
+    changed.notify_all();
+}
+
+void ThreadPool::workerLoop(unsigned int index)
+{
+    currentPool = this;
+    currentIndex = index;
+    while (true) {
+        uint64_t seen;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen = events;
+        }
+        std::function<void()> work;
+        if (popTask(work) || popJob(work)) {
+            run(work);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        if (stopping) {
+            return;
+        }
+        changed.wait(lock, [&]() { return events != seen || stopping; });
+    }
+}
+
+void ThreadPool::helpUntil(const std::function<bool()>& done)
+{
+    while (true) {
+        uint64_t seen;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen = events;
+        }
+        if (done()) {
+            return;
+        }
+        std::function<void()> task;
+        if (popTask(task)) {
+            run(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return events != seen; });
+    }
+}
+
+void ThreadPool::wait()
+{
+    while (true) {
+        uint64_t seen;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            seen = events;
+        }
+        if (pending == 0) {
+            return;
+        }
+        std::function<void()> work;
+        if (workers.empty() && (popTask(work) || popJob(work))) {
+            run(work);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait(lock, [&]() { return events != seen; });
+    }
+}
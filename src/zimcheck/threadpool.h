@@ -0,0 +1,84 @@
+#ifndef _ZIM_TOOL_THREADPOOL_H_
+#define _ZIM_TOOL_THREADPOOL_H_
+
+#include <deque>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+
+/* A fixed set of worker threads running two kinds of work:
+ *
+ * - jobs (submitJob): long units of work, as checking a whole zim file. They
+ *   are run in submission order.
+ * - tasks (submit): short units of work, as checking a chunk of articles.
+ *   Each worker has its own queue of tasks (where the tasks it submits go),
+ *   and an idle worker steals the tasks of the other ones. The tasks
+ *   submitted with submitFirst (as a read ahead, needed soon) go to a queue
+ *   of their own, run before all the other tasks.
+ *
+ * The workers run the pending tasks before starting a new job, so the jobs
+ * already started finish first. A thread waiting for tasks (helpUntil) runs
+ * them meanwhile instead of blocking a worker: a thread outside of the pool
+ * doing so is one more thread running the tasks. So a pool of N - 1 workers
+ * gives N threads to the thread helping it, and a pool without worker runs
+ * all its tasks on the threads waiting for them.
+ *
+ * Tasks and jobs must not throw.
+ */
+class ThreadPool
+{
+  public:
+    explicit ThreadPool(unsigned int threadCount);
+    ~ThreadPool();
+
+    void submit(std::function<void()> task);
+    void submitFirst(std::function<void()> task);
+    void submitJob(std::function<void()> job);
+
+    // Run tasks (not jobs) until `done` returns true. `done` is checked again
+    // each time a task is submitted or finished (anywhere in the pool).
+    void helpUntil(const std::function<bool()>& done);
+
+    // Wait for all the tasks and jobs to be finished. Only a pool without
+    // worker runs them on the waiting thread.
+    void wait();
+
+    unsigned int size() const { return workers.size(); }
+
+  private:
+    ThreadPool(const ThreadPool&);
+    ThreadPool& operator=(const ThreadPool&);
+
+    struct TaskQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(unsigned int index);
+    bool popTask(std::function<void()>& task);
+    bool popJob(std::function<void()>& job);
+    void run(std::function<void()>& work);
+    void signal();
+
+    std::vector<std::unique_ptr<TaskQueue>> queues;
+    TaskQueue firstTasks;
+    std::atomic<unsigned int> nextQueue;
+    std::deque<std::function<void()>> jobs;
+    std::atomic<size_t> pending; // Tasks and jobs submitted and not finished.
+
+    // Protect `jobs`, `events` and `stopping`.
+    std::mutex mutex;
+    std::condition_variable changed;
+    uint64_t events; // Incremented on each submission and end of a task/job.
+    bool stopping;
+
+    std::vector<std::thread> workers;
+};
+
+#endif
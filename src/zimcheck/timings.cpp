@@ -0,0 +1,148 @@
+#include "timings.h"
+
+#include <iomanip>
+
+namespace
+{
+
+const char* const PHASE_NAMES[PHASE_COUNT] = {
+    "integrity",
+    "checksum",
+    "open",
+    "metadata",
+    "favicon",
+    "main_page",
+    "redirects",
+    "title_index",
+    "path_index",
+    "articles",
+    "cluster_hash",
+    "decompression",
+    "link_extraction",
+    "normalization",
+    "link_cache",
+    "lookup",
+    "redundancy",
+    "mime",
+    "near_duplicates"
+};
+
+double toSeconds(uint64_t nanoseconds)
+{
+    return nanoseconds / 1e9;
+}
+
+double toMB(uint64_t bytes)
+{
+    return bytes / (1024.0 * 1024.0);
+}
+
+} // unnamed namespace
+
+std::string phaseToStr(Phase phase)
+{
+    return PHASE_NAMES[size_t(phase)];
+}
+
+void Timings::add(Phase phase, uint64_t nanoseconds, uint64_t bytes, uint64_t entries)
+{
+    PhaseStats& s = stats[size_t(phase)];
+    s.nanoseconds += nanoseconds;
+    s.bytes += bytes;
+    s.entries += entries;
+    s.calls++;
+}
+
+void Timings::merge(const Timings& other)
+{
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        stats[i].nanoseconds += other.stats[i].nanoseconds;
+        stats[i].bytes += other.stats[i].bytes;
+        stats[i].entries += other.stats[i].entries;
+        stats[i].calls += other.stats[i].calls;
+    }
+    threads.insert(other.threads.begin(), other.threads.end());
+    clusterLoads += other.clusterLoads;
+    readAheadLoads += other.readAheadLoads;
+}
+
+void Timings::report(std::ostream& out) const
+{
+    const auto flags = out.flags();
+    const auto precision = out.precision();
+    out << "[INFO] Time per phase (the article phases are summed over the threads):" << std::endl
+        << "  " << std::left << std::setw(16) << "phase" << std::right
+        << std::setw(12) << "seconds" << std::setw(12) << "entries"
+        << std::setw(12) << "MB" << std::setw(12) << "MB/s" << std::endl;
+    out << std::fixed;
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        const PhaseStats& s = stats[i];
+        if (s.calls == 0) {
+            continue;
+        }
+        const double seconds = toSeconds(s.nanoseconds);
+        out << "  " << std::left << std::setw(16) << PHASE_NAMES[i] << std::right
+            << std::setw(12) << std::setprecision(3) << seconds
+            << std::setw(12) << s.entries
+            << std::setw(12) << std::setprecision(1) << toMB(s.bytes);
+        if (s.bytes && s.nanoseconds) {
+            out << std::setw(12) << toMB(s.bytes) / seconds;
+        } else {
+            out << std::setw(12) << "-";
+        }
+        out << std::endl;
+    }
+    if (!threads.empty()) {
+        out << "  (article checks run on " << threads.size() << " threads)" << std::endl;
+    }
+    if (clusterLoads) {
+        out << "  (" << readAheadLoads << " of " << clusterLoads
+            << " cluster loads read ahead)" << std::endl;
+    }
+    out.flags(flags);
+    out.precision(precision);
+}
+
+void Timings::writeJson(std::ostream& out) const
+{
+    out << "[";
+    bool first = true;
+    for (size_t i = 0; i < PHASE_COUNT; i++) {
+        const PhaseStats& s = stats[i];
+        if (s.calls == 0) {
+            continue;
+        }
+        out << (first ? "" : ",")
+            << "{\"phase\":\"" << PHASE_NAMES[i] << "\""
+            << ",\"nanoseconds\":" << s.nanoseconds
+            << ",\"bytes\":" << s.bytes
+            << ",\"entries\":" << s.entries
+            << ",\"calls\":" << s.calls
+            << ",\"mb_per_s\":" << (s.nanoseconds ? toMB(s.bytes) / toSeconds(s.nanoseconds) : 0)
+            << "}";
+        first = false;
+    }
+    out << "]";
+}
+
+PhaseTimer::PhaseTimer(Timings* timings, Phase phase, uint64_t bytes, uint64_t entries)
+  : timings(timings),
+    phase(phase),
+    bytes(bytes),
+    entries(entries)
+{
+    if (timings) {
+        start = std::chrono::steady_clock::now();
+    }
+}
+
+void PhaseTimer::stop()
+{
+    if (!timings) {
+        return;
+    }
+    const auto duration = std::chrono::steady_clock::now() - start;
+    timings->add(phase, std::chrono::duration_cast<std::chrono::nanoseconds>(duration).count(),
+                 bytes, entries);
+    timings = nullptr;
+}
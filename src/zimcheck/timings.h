@@ -0,0 +1,111 @@
+#ifndef _ZIM_TOOL_TIMINGS_H_
+#define _ZIM_TOOL_TIMINGS_H_
+
+#include <chrono>
+#include <cstdint>
+#include <cstddef>
+#include <ostream>
+#include <set>
+#include <string>
+#include <thread>
+
+// The phases of zimcheck whose time is measured (see --timings).
+enum class Phase {
+    INTEGRITY,
+    CHECKSUM,
+    OPEN,
+    METADATA,
+    FAVICON,
+    MAIN_PAGE,
+    REDIRECTS,
+    TITLE_INDEX,
+    PATH_INDEX,
+    ARTICLES,        // Wall time of the article checks, the phases below included.
+    CLUSTER_HASH,    // Reading the raw clusters to look for them in the cluster cache.
+    DECOMPRESSION,   // Reading (and decompressing) the items.
+    LINK_EXTRACTION,
+    NORMALIZATION,   // Normalizing the internal links.
+    LINK_CACHE,      // Looking for the internal links in the link cache.
+    LOOKUP,          // Looking for the links not in the cache in the path index.
+    REDUNDANCY,      // Hashing the contents and looking for the hashes.
+    MIME,
+    NEAR_DUPLICATES, // Computing the signatures of the texts.
+    OTHER            // Not a phase, the number of phases.
+};
+
+const size_t PHASE_COUNT = size_t(Phase::OTHER);
+
+std::string phaseToStr(Phase phase);
+
+struct PhaseStats
+{
+    uint64_t nanoseconds = 0;
+    uint64_t bytes = 0;
+    uint64_t entries = 0;
+    uint64_t calls = 0; // Number of times the phase was run.
+};
+
+/* The time spent in each phase, with the bytes and the entries processed.
+ * Not thread safe: each worker fills its own Timings, which are merged.
+ * So the time of the article phases is summed over all the threads (and
+ * may be more than the wall time of the article checks).
+ */
+class Timings
+{
+  public:
+    void add(Phase phase, uint64_t nanoseconds, uint64_t bytes = 0, uint64_t entries = 0);
+    // Count bytes processed by a phase once it is measured (when they are
+    // only known after it).
+    void addBytes(Phase phase, uint64_t bytes) { stats[size_t(phase)].bytes += bytes; }
+    // Count a thread running a part of the article checks.
+    void addThread(std::thread::id thread) { threads.insert(thread); }
+    // Count a load of a cluster for the article checks, `readAhead` if
+    // another thread started it before it was needed.
+    void addClusterLoad(bool readAhead) { clusterLoads++; readAheadLoads += readAhead; }
+    void merge(const Timings& other);
+
+    const PhaseStats& get(Phase phase) const { return stats[size_t(phase)]; }
+    // The number of distinct threads which ran the article checks.
+    size_t threadCount() const { return threads.size(); }
+    uint64_t clusterLoadCount() const { return clusterLoads; }
+    uint64_t readAheadCount() const { return readAheadLoads; }
+
+    // Print the phases run as a table.
+    void report(std::ostream& out) const;
+    // Write the phases run as a JSON array.
+    void writeJson(std::ostream& out) const;
+
+  private:
+    PhaseStats stats[PHASE_COUNT];
+    std::set<std::thread::id> threads;
+    uint64_t clusterLoads = 0;
+    uint64_t readAheadLoads = 0;
+};
+
+/* Measure the time of a phase from its construction to its destruction (or
+ * to stop()). Does nothing (not even reading the clock) if `timings` is null,
+ * so the checks may be timed only if asked.
+ */
+class PhaseTimer
+{
+  public:
+    PhaseTimer(Timings* timings, Phase phase, uint64_t bytes = 0, uint64_t entries = 0);
+    ~PhaseTimer() { stop(); }
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+    // Add bytes and entries processed once the timer is started.
+    void addBytes(uint64_t count) { bytes += count; }
+    void addEntries(uint64_t count) { entries += count; }
+
+    void stop();
+
+  private:
+    Timings* timings;
+    Phase phase;
+    uint64_t bytes;
+    uint64_t entries;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
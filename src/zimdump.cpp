@@ -36,6 +36,7 @@
 #include <unordered_map>
 
 #include "version.h"
+#include "progress.h"
 
 #include <fcntl.h>
 #ifdef _WIN32
@@ -130,7 +131,7 @@ class ZimDumper
     zim::Entry getEntryByPath(const std::string &path);
     zim::Entry getEntry(zim::size_type idx);
 
-    void dumpFiles(const std::string& directory, bool symlinkdump, std::function<bool (const char c)> nsfilter);
+    void dumpFiles(const std::string& directory, bool symlinkdump, std::function<bool (const char c)> nsfilter, ProgressBar& progress);
 };
 
 zim::Entry ZimDumper::getEntryByPath(const std::string& path)
@@ -288,7 +289,7 @@ inline void write_to_file(const std::string &base, const std::string& path, cons
 }
 
 
-void ZimDumper::dumpFiles(const std::string& directory, bool symlinkdump, std::function<bool (const char c)> nsfilter)
+void ZimDumper::dumpFiles(const std::string& directory, bool symlinkdump, std::function<bool (const char c)> nsfilter, ProgressBar& progress)
 {
   unsigned int truncatedFiles = 0;
 #if defined(_WIN32)
@@ -299,6 +300,7 @@ void ZimDumper::dumpFiles(const std::string& directory, bool symlinkdump, std::f
 #endif
 
   std::vector<std::string> pathcache;
+  progress.reset(m_archive.getEntryCount());
   for (auto& entry:m_archive.iterEfficient()) {
     std::string path = entry.getPath();
     std::string dir = "";
@@ -337,22 +339,27 @@ void ZimDumper::dumpFiles(const std::string& directory, bool symlinkdump, std::f
             ss << "<meta http-equiv=\"refresh\" content=\"0;url=" + encodedurl + "\" /><head><body></body></html>";
             auto content = ss.str();
             write_to_file(directory + SEPARATOR, relative_path, content.c_str(), content.size());
+            progress.report(1, content.size());
         } else {
 #ifdef _WIN32
             auto blob = redirectItem.getData();
             write_to_file(directory + SEPARATOR, relative_path, blob.data(), blob.size());
+            progress.report(1, blob.size());
 #else
             if (symlink(redirectPath.c_str(), full_path.c_str()) != 0) {
               throw std::runtime_error(
                 std::string("Error creating symlink from ") + full_path + " to " + redirectPath);
             }
+            progress.report();
 #endif
         }
     } else {
       auto blob = entry.getItem().getData();
       write_to_file(directory + SEPARATOR, relative_path, blob.data(), blob.size());
+      progress.report(1, blob.size());
     }
   }
+  progress.finish();
 }
 
 static const char USAGE[] =
@@ -361,7 +368,7 @@ zimdump tool is used to inspect a zim file and also to dump its contents into th
 
 Usage:
   zimdump list [--details] [--idx=INDEX|([--url=URL] [--ns=N])] [--] <file>
-  zimdump dump --dir=DIR [--ns=N] [--redirect] [--] <file>
+  zimdump dump --dir=DIR [--ns=N] [--redirect] [--progress|--progress-json] [--] <file>
   zimdump show (--idx=INDEX|(--url=URL [--ns=N])) [--] <file>
   zimdump info [--ns=N] [--] <file>
   zimdump -h | --help
@@ -378,6 +385,8 @@ Options:
   --details    Show details about the articles. Else, list only the url of the article(s).
   --dir=DIR    Directory where to dump the article(s) content.
   --redirect   Use symlink to dump redirect articles. Else create html redirect file
+  --progress   Print the progress of the dump (with the rate and the remaining time).
+  --progress-json  Print the progress of the dump as JSON lines on the standard error.
   -h, --help   Show this help
   --version    Show zimdump version.
 
@@ -394,12 +403,12 @@ int subcmdInfo(ZimDumper &app, std::map<std::string, docopt::value> &args)
     return 0;
 }
 
-int subcmdDumpAll(ZimDumper &app, const std::string &outdir, bool redirect, std::function<bool (const char c)> nsfilter)
+int subcmdDumpAll(ZimDumper &app, const std::string &outdir, bool redirect, std::function<bool (const char c)> nsfilter, ProgressBar& progress)
 {
 #ifdef _WIN32
-    app.dumpFiles(outdir, false, nsfilter);
+    app.dumpFiles(outdir, false, nsfilter, progress);
 #else
-    app.dumpFiles(outdir, redirect, nsfilter);
+    app.dumpFiles(outdir, redirect, nsfilter, progress);
 #endif
     return 0;
 }
@@ -424,7 +433,14 @@ int subcmdDump(ZimDumper &app,  std::map<std::string, docopt::value> &args)
         directory.pop_back();
     }
 
-    return subcmdDumpAll(app, directory, redirect, filter);
+    ProgressBar progress(1);
+    if (args["--progress"].asBool()) {
+        progress.set_progress_report(true);
+    } else if (args["--progress-json"].asBool()) {
+        progress.set_progress_report(true, ProgressBar::Format::JSON);
+    }
+
+    return subcmdDumpAll(app, directory, redirect, filter, progress);
 }
 
 int subcmdShow(ZimDumper &app,  std::map<std::string, docopt::value> &args)
@@ -20,6 +20,7 @@
 
 #include "zimcreatorfs.h"
 #include "../tools.h"
+#include "../progress.h"
 #include "tools.h"
 
 #include <fstream>
@@ -184,6 +185,9 @@ void ZimCreatorFS::addItem(std::shared_ptr<zim::writer::Item> item)
  for (auto& handler: itemHandlers) {
      handler->handleItem(item);
   }
+  if (progress) {
+    progress->report();
+  }
 }
 
 void ZimCreatorFS::processSymlink(const std::string& curdir, const std::string& symlink_path)
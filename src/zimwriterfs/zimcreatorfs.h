@@ -26,6 +26,8 @@
 
 #include <zim/writer/creator.h>
 
+class ProgressBar;
+
 class IHandler
 {
  public:
@@ -42,6 +44,7 @@ class ZimCreatorFS : public zim::writer::Creator
   virtual ~ZimCreatorFS() = default;
 
   virtual void add_customHandler(IHandler* handler);
+  void setProgress(ProgressBar* _progress) { progress = _progress; }
   virtual void add_redirectArticles_from_file(const std::string& path);
   virtual void visitDirectory(const std::string& path);
 
@@ -57,6 +60,7 @@ class ZimCreatorFS : public zim::writer::Creator
 
  private:
   std::vector<IHandler*> itemHandlers;
+  ProgressBar* progress = nullptr; ///< Reported for each added item, if set
   std::string directoryPath;  ///< html dir without trailing slash
   std::string canonical_basedir;
 };
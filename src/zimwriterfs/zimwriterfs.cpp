@@ -35,6 +35,7 @@
 #include "zimcreatorfs.h"
 #include "mimetypecounter.h"
 #include "../tools.h"
+#include "../progress.h"
 #include "tools.h"
 
 /* Check for version number */
@@ -65,6 +66,8 @@ int minChunkSize = 2048;
 bool verboseFlag = false;
 bool withoutFTIndex = false;
 bool zstdFlag = false;
+bool progressFlag = false;
+ProgressBar::Format progressFormat = ProgressBar::Format::TEXT;
 }
 
 // Global flags
@@ -156,6 +159,9 @@ void usage()
             << std::endl;
   std::cout << "\t-z, --zstd\t\tuse Zstandard as ZIM compression (lzma otherwise)"
             << std::endl;
+  std::cout << "\t-P, --progress[=json]\tprint the number of added items and the rate, "
+               "as JSON lines on STDERR with =json"
+            << std::endl;
   std::cout << std::endl;
 
   std::cout << "Example:" << std::endl;
@@ -197,6 +203,7 @@ void parse_args(int argc, char** argv)
          {"publisher", required_argument, 0, 'p'},
          {"zstd", no_argument, 0, 'z'},
          {"withoutFTIndex", no_argument, 0, 'j'},
+         {"progress", optional_argument, 0, 'P'},
 
          // Only for backward compatibility
          {"withFullTextIndex", no_argument, 0, 'i'},
@@ -207,7 +214,7 @@ void parse_args(int argc, char** argv)
 
   do {
     c = getopt_long(
-        argc, argv, "hVvijxuzw:m:f:t:d:c:l:p:r:e:n:", long_options, &option_index);
+        argc, argv, "hVvijxuzP::w:m:f:t:d:c:l:p:r:e:n:", long_options, &option_index);
 
     if (c != -1) {
       switch (c) {
@@ -276,6 +283,16 @@ void parse_args(int argc, char** argv)
         case 'z':
           zstdFlag = true;
           break;
+        case 'P':
+          progressFlag = true;
+          if (optarg && std::string(optarg) == "json") {
+            progressFormat = ProgressBar::Format::JSON;
+          } else if (optarg) {
+            std::cerr << "zimwriterfs: unknown progress format '" << optarg
+                      << "'" << std::endl;
+            exit(1);
+          }
+          break;
       }
     }
   } while (c != -1);
@@ -389,6 +406,13 @@ void create_zim()
   /* Directory visitor */
   MimetypeCounter mimetypeCounter;
   zimCreator.add_customHandler(&mimetypeCounter);
+  // The number of files is not known beforehand: no remaining time.
+  ProgressBar progress(1);
+  if (progressFlag) {
+    progress.set_progress_report(true, progressFormat);
+    zimCreator.setProgress(&progress);
+    progress.reset(0);
+  }
   zimCreator.visitDirectory(directoryPath);
 
   /* Check redirects file and read it if necessary*/
@@ -406,6 +430,8 @@ void create_zim()
       zimCreator.add_redirectArticles_from_file(redirectsPath);
     }
   }
+  progress.finish();
+  zimCreator.setProgress(nullptr);
   zimCreator.finishZimCreation();
 }
 
@@ -3,6 +3,10 @@
 #include "../src/tools.h"
 #include <magic.h>
 #include <unordered_map>
+#include <cstring>
+#include <chrono>
+#include <functional>
+#include <iostream>
 
 magic_t magic;
 bool inflateHtmlFlag = false;
@@ -181,6 +185,8 @@ TEST(tools, isOutofBounds)
     ASSERT_FALSE(isOutofBounds("../", "/a"));
     ASSERT_TRUE(isOutofBounds("../../", "/a"));
     ASSERT_TRUE(isOutofBounds("../../../-/s/css_modules/ext.cite.ux-enhancements.css", "A/Blood_/"));
+    // Only the given chars are read.
+    ASSERT_FALSE(isOutofBounds("../../", 3, "/a"));
 }
 
 TEST(tools, normalize_link)
@@ -193,6 +199,12 @@ TEST(tools, normalize_link)
     ASSERT_EQ(normalize_link(".././a", "/b/c"), "/b/a");
     ASSERT_EQ(normalize_link("../a/b/aa#localanchor", "/b/c"), "/b/a/b/aa");
     ASSERT_EQ(normalize_link("../a/b/aa?localanchor", "/b/c"), "/b/a/b/aa");
+
+    // url decoding
+    ASSERT_EQ(normalize_link("a%20b", "/b"), "/b/a b");
+    // Only the given chars are read.
+    ASSERT_EQ(normalize_link("a%20b/../c", 5, "/b"), "/b/a b");
+    ASSERT_EQ(normalize_link("a%2", 3, "/b"), "/b/a\x02");
 }
 
 TEST(tools, addler32)
@@ -203,6 +215,27 @@ TEST(tools, addler32)
     ASSERT_EQ(adler32(""), 1);
 }
 
+TEST(tools, hash128)
+{
+    // SMHasher verification of MurmurHash3_x64_128
+    unsigned char key[256];
+    unsigned char hashes[256*16];
+    for (int i = 0; i < 256; i++) {
+        key[i] = i;
+        const auto h = hash128(reinterpret_cast<const char*>(key), i, 256 - i);
+        memcpy(hashes + i*16, &h.low, 8);
+        memcpy(hashes + i*16 + 8, &h.high, 8);
+    }
+    const auto h = hash128(reinterpret_cast<const char*>(hashes), sizeof(hashes), 0);
+    uint32_t verification;
+    memcpy(&verification, &h.low, 4);
+    ASSERT_EQ(verification, 0x6384BA69U);
+
+    ASSERT_EQ(hash128("", 0), hash128("", 0));
+    ASSERT_NE(hash128("abc", 3), hash128("abd", 3));
+    ASSERT_NE(hash128("abc", 3, 0), hash128("abc", 3, 1));
+}
+
 TEST(tools, getLinks)
 {
     auto v = generic_getLinks("");
@@ -229,3 +262,211 @@ TEST(tools, getLinks)
     ASSERT_EQ(v3[0].attribute, "src");
     ASSERT_EQ(v3[0].link, "https://fonts.goos.com/css?family=OpenSans");
 }
+
+TEST(tools, getLinkTable)
+{
+    LinkTable table;
+    getLinkTable("", table);
+    ASSERT_TRUE(table.empty());
+
+    const std::string page = "<a href=\"MailTo:a@b.c\">a</a><img src=\"https://example.com/a.png\">"
+                             "<a href=\"../b.html#c\">b</a><img src=\"data:image/png;base64,AA\">";
+    getLinkTable(page, table);
+    ASSERT_EQ(table.size(), 4U);
+    EXPECT_EQ(table[0].attribute, LinkAttribute::HREF);
+    EXPECT_EQ(table[0].kind, UriKind::MAILTO);
+    EXPECT_EQ(table.str(table[0]), "MailTo:a@b.c");
+    EXPECT_EQ(table[1].attribute, LinkAttribute::SRC);
+    EXPECT_EQ(table[1].kind, UriKind::GENERIC_URI);
+    EXPECT_TRUE(table[1].isExternalUrl());
+    EXPECT_EQ(table.str(table[2]), "../b.html#c");
+    EXPECT_TRUE(table[2].isInternalUrl());
+    EXPECT_EQ(table[3].kind, UriKind::DATA);
+    EXPECT_FALSE(table[3].isExternalUrl());
+    EXPECT_FALSE(table[3].isInternalUrl());
+
+    // Classified as the html_link.
+    for (const auto& link : table) {
+        EXPECT_EQ(link.kind, html_link::detectUriKind(table.str(link)));
+    }
+
+    // The table and the buffer of spans are reused for the next page.
+    std::vector<LinkSpan> spans;
+    getLinkTable(page, table, spans);
+    getLinkTable("<a href=\"d.html\">d</a>", table, spans);
+    ASSERT_EQ(table.size(), 1U);
+    EXPECT_EQ(table.str(table[0]), "d.html");
+}
+
+TEST(tools, getLinkSpans)
+{
+    const auto links = [](const std::string& page) {
+        std::vector<LinkSpan> spans;
+        getLinkSpans(page.data(), page.size(), spans);
+        std::vector<std::string> result;
+        for (const auto& span : spans) {
+            result.push_back(std::string(span.isSrc ? "src:" : "href:") + page.substr(span.offset, span.size));
+        }
+        return result;
+    };
+    typedef std::vector<std::string> Links;
+
+    ASSERT_EQ(links("<a\thref='a.html'><img\nsrc = \"b.png\"><a\r\nhref=\n'c'>"),
+              Links({"href:a.html", "src:b.png", "href:c"}));
+    // Not an attribute.
+    ASSERT_EQ(links("href='a' <a xhref='b' data-src='c' src=d>"), Links());
+    // Not terminated.
+    ASSERT_EQ(links("<a href='a.html'><a href=\"b.html"), Links({"href:a.html"}));
+    // The value of a link is not scanned.
+    ASSERT_EQ(links("<a href='x src=\"y\"'>"), Links({"href:x src=\"y\""}));
+    ASSERT_EQ(links("<a href= src=\"y\">"), Links({"src:y"}));
+
+    // The links are found wherever they are in the blocks of the scanner.
+    for (size_t offset = 0; offset < 70; offset++) {
+        const std::string page = std::string(offset, '=') + " src='a=b'" + std::string(offset % 7, ' ')
+                               + "<a href=\"" + std::string(offset, 'c') + "\">=";
+        ASSERT_EQ(links(page), Links({"src:a=b", "href:" + std::string(offset, 'c')})) << offset;
+    }
+}
+
+TEST(tools, linkScanners)
+{
+    struct Scanner {
+        const char* name;
+        detail::LinkScanner scan;
+        bool supported;
+    };
+    const std::vector<Scanner> scanners = {
+        {"sse2", detail::scanLinksSse2, detail::linkScannerSupportsSse2()},
+        {"avx2", detail::scanLinksAvx2, detail::linkScannerSupportsAvx2()},
+    };
+    const auto spans = [](detail::LinkScanner scan, const std::string& page) {
+        std::vector<std::string> result;
+        std::vector<LinkSpan> links;
+        scan(page.data(), page.size(), links);
+        for (const auto& link : links) {
+            result.push_back(std::string(link.isSrc ? "src:" : "href:")
+                             + std::to_string(link.offset) + ":" + page.substr(link.offset, link.size));
+        }
+        return result;
+    };
+
+    // Pieces of pages, shifted over the blocks of 16 and 32 bytes so that the
+    // attributes, the '=' and the quotes fall on both sides of the block
+    // boundaries, and that the links end in a next block or in the tail.
+    const std::vector<std::string> pieces = {
+        "<a href=\"a.html\">",
+        "<img src='b.png'>",
+        " href = 'c=d' ",
+        "==",
+        "<a\nhref=\n\"" + std::string(40, 'e') + "\">",
+        " src=f ",
+        "xhref='g'",
+        " src='h",
+        " href=\"",
+    };
+    std::vector<std::string> pages;
+    for (size_t shift = 0; shift <= 64; shift++) {
+        for (const auto& piece : pieces) {
+            pages.push_back(std::string(shift, ' ') + piece);
+            pages.push_back(std::string(shift, '=') + piece + std::string(shift % 5, 'x'));
+            pages.push_back(std::string(shift, 'y') + piece + piece + pieces[shift % pieces.size()]);
+        }
+    }
+    // Mixes of all the pieces, of sizes around the multiples of the blocks.
+    uint32_t seed = 1;
+    for (size_t i = 0; i < 500; i++) {
+        std::string page;
+        const size_t count = i % 9;
+        for (size_t j = 0; j < count; j++) {
+            seed = seed * 1103515245 + 12345;
+            page += pieces[(seed >> 16) % pieces.size()];
+            page += std::string((seed >> 8) % 7, ' ');
+        }
+        pages.push_back(page);
+    }
+
+    size_t linkCount = 0;
+    for (const auto& page : pages) {
+        const auto expected = spans(detail::scanLinksScalar, page);
+        linkCount += expected.size();
+        for (const auto& scanner : scanners) {
+            if (scanner.supported) {
+                ASSERT_EQ(spans(scanner.scan, page), expected) << scanner.name << " on \"" << page << "\"";
+            }
+        }
+    }
+    ASSERT_GT(linkCount, pages.size());
+}
+
+namespace
+{
+
+// The link extraction before getLinkSpans (but not reading after the end).
+std::vector<html_link> byteByByteGetLinks(const std::string& page)
+{
+    const char* p = page.c_str();
+    const char* const end = p + page.size();
+    std::vector<html_link> links;
+    std::string attr;
+    while (*p) {
+        if (strncmp(p, " href", 5) == 0) {
+            attr = "href";
+            p += 5;
+        } else if (strncmp(p, " src", 4) == 0) {
+            attr = "src";
+            p += 4;
+        } else {
+            p += 1;
+            continue;
+        }
+        while (*p == ' ')
+            p += 1;
+        if (*p == '\0' || *(p++) != '=')
+            continue;
+        while (*p == ' ')
+            p += 1;
+        if (*p == '\0')
+            break;
+        const char delimiter = *p++;
+        if (delimiter != '\'' && delimiter != '"')
+            continue;
+        const char* linkStart = p;
+        while (p < end && *p != delimiter)
+            p++;
+        if (p == end)
+            break;
+        links.push_back(html_link(attr, std::string(linkStart, p)));
+        p += 1;
+    }
+    return links;
+}
+
+} // unnamed namespace
+
+// Run with --gtest_also_run_disabled_tests to compare the link extractions.
+TEST(tools, DISABLED_getLinksBenchmark)
+{
+    std::string page;
+    for (int i = 0; page.size() < 64 * 1024 * 1024; i++) {
+        page += "<p class=\"text\">Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do "
+                "eiusmod tempor <a href=\"../A/Article_" + std::to_string(i) + "\" title=\"Article\">"
+                "incididunt</a> ut labore et dolore magna aliqua.<img src=\"../I/image.png\" "
+                "width=\"20\" height=\"20\"/></p>\n";
+    }
+    const auto measure = [&page](const char* name, const std::function<size_t()>& extract) {
+        const auto start = std::chrono::steady_clock::now();
+        const size_t count = extract();
+        const std::chrono::duration<double> duration = std::chrono::steady_clock::now() - start;
+        std::cout << name << ": " << count << " links, "
+                  << page.size() / duration.count() / 1e9 << " GB/s" << std::endl;
+        return count;
+    };
+    const size_t expected = measure("byte by byte", [&page]() { return byteByByteGetLinks(page).size(); });
+    ASSERT_EQ(measure("generic_getLinks", [&page]() { return generic_getLinks(page).size(); }), expected);
+    ASSERT_EQ(measure("getLinkSpans", [&page]() {
+        std::vector<LinkSpan> spans;
+        getLinkSpans(page.data(), page.size(), spans);
+        return spans.size();
+    }), expected);
+}
@@ -1,8 +1,43 @@
+#define ZIM_PRIVATE
 #include "gtest/gtest.h"
 
 #include "zim/zim.h"
 #include "zim/archive.h"
+#include "zim/writer/creator.h"
+#include <sstream>
 #include "../src/zimcheck/checks.h"
+#include "../src/zimcheck/checker.h"
+#include "../src/zimcheck/contenthashtable.h"
+#include "../src/zimcheck/pathindex.h"
+#include "../src/zimcheck/linkcache.h"
+#include "../src/zimcheck/jsonsink.h"
+#include "../src/zimcheck/clustercache.h"
+#include "../src/zimcheck/checkpoint.h"
+#include "../src/zimcheck/threadpool.h"
+#include "../src/zimcheck/mimesniffer.h"
+#include "../src/zimcheck/sampling.h"
+#include "../src/zimcheck/timings.h"
+#include "../src/zimcheck/md5.h"
+#include "../src/zimcheck/filechecksum.h"
+#include "../src/zimcheck/linkgraph.h"
+#include "../src/zimcheck/redirects.h"
+#include "../src/zimcheck/redundancy.h"
+#include "../src/zimcheck/spill.h"
+#include "../src/zimcheck/neardup.h"
+#include "../src/zimcheck/direntscanner.h"
+#include "../src/zimcheck/clusterstats.h"
+#include "../src/zimcheck/serialize.h"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
 
 
 TEST(zimfilechecks, test_checksum)
@@ -53,6 +88,19 @@ TEST(zimfilechecks, test_mainpage)
     ASSERT_TRUE(logger.overalStatus());
 }
 
+namespace
+{
+// The checks of the items (not the near duplicates nor the cluster statistics).
+ArticleCheckOptions allArticleChecks(unsigned int threadCount = 1)
+{
+    ArticleCheckOptions options;
+    options.redundant_data = options.url_check = options.url_check_external = true;
+    options.empty_check = options.mime_check = options.unreachable_check = true;
+    options.thread_count = threadCount;
+    return options;
+}
+} // unnamed namespace
+
 TEST(zimfilechecks, test_articles)
 {
     std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
@@ -62,7 +110,1256 @@ TEST(zimfilechecks, test_articles)
     ProgressBar progress(1);
 
     
-    test_articles(archive, logger, progress, true, true, true ,true);
+    ArticleCheckOptions options;
+    options.redundant_data = options.url_check = options.url_check_external = options.empty_check = true;
+    test_articles(archive, logger, progress, options);
 
     ASSERT_TRUE(logger.overalStatus());
 }
+
+TEST(zimfilechecks, test_articles_multithreaded)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+
+    zim::Archive archive(fn);
+    ProgressBar progress(1);
+
+    ErrorLogger logger1;
+    test_articles(archive, logger1, progress, allArticleChecks(1));
+    ErrorLogger logger4;
+    test_articles(archive, logger4, progress, allArticleChecks(4));
+
+    ASSERT_EQ(logger1.overalStatus(), logger4.overalStatus());
+
+    std::ostringstream report1, report4;
+    auto coutBuf = std::cout.rdbuf(report1.rdbuf());
+    logger1.report(true);
+    std::cout.rdbuf(report4.rdbuf());
+    logger4.report(true);
+    std::cout.rdbuf(coutBuf);
+    ASSERT_EQ(report1.str(), report4.str());
+}
+
+namespace
+{
+std::string getReport(const ErrorLogger& logger)
+{
+    std::ostringstream report;
+    auto coutBuf = std::cout.rdbuf(report.rdbuf());
+    logger.report(true);
+    std::cout.rdbuf(coutBuf);
+    return report.str();
+}
+} // unnamed namespace
+
+TEST(zimfilechecks, test_articles_cluster_cache)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+    const std::string cacheFn = "zimcheck-test-cluster-cache";
+    std::remove(cacheFn.c_str());
+
+    zim::Archive archive(fn);
+    ProgressBar progress(1);
+
+    ErrorLogger logger;
+    test_articles(archive, logger, progress, allArticleChecks());
+
+    // First run fills the cache, second run uses it.
+    for (int run = 0; run < 2; run++) {
+        ClusterCache cache(cacheFn);
+        ASSERT_EQ(cache.size() != 0, run == 1);
+        ErrorLogger cachedLogger;
+        Timings timings;
+        test_articles(archive, cachedLogger, progress, allArticleChecks(2), &cache,
+                      nullptr, nullptr, nullptr, &timings);
+        cache.commit();
+        ASSERT_EQ(getReport(logger), getReport(cachedLogger));
+        // The raw clusters are read to be hashed, on each run.
+        ASSERT_GT(timings.get(Phase::CLUSTER_HASH).bytes, 0U);
+    }
+    std::remove(cacheFn.c_str());
+}
+
+TEST(zimfilechecks, zim_checker)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+    zim::Archive archive(fn);
+
+    CheckOptions options;
+    options.selectAll();
+    options.unreachable_check = true;
+    options.thread_count = 2;
+    options.progress_interval = 0.001;
+    std::ostringstream output;
+    options.output = &output;
+    ZimChecker checker(options);
+    std::map<TestType, std::vector<std::string>> findings;
+    checker.onFinding([&findings](TestType type, const std::string& msg) {
+        findings[type].push_back(msg);
+    });
+    size_t done = 0;
+    checker.onProgress([&done](size_t d, size_t total) {
+        ASSERT_GE(d, done);
+        ASSERT_GE(total, d);
+        done = d;
+    });
+    const StatusCode status = checker.check(archive);
+
+    // The same findings as zimcheck.
+    ErrorLogger logger;
+    ProgressBar progress(1);
+    run_checks(fn, options, logger, progress, nullptr, nullptr);
+    ASSERT_EQ(status, logger.overalStatus() ? PASS : FAIL);
+    // The report of the checker only counts the findings given to the callback.
+    for (const auto& m : errormapping) {
+        std::vector<std::string> msgs;
+        logger.forEachReportMsg(m.first, [&msgs](const std::string& msg) {
+            msgs.push_back(msg);
+        });
+        ASSERT_EQ(findings[m.first], msgs);
+        ASSERT_EQ(checker.getReport().getReportMsgCount(m.first), msgs.size());
+        ASSERT_EQ(checker.getReport().getStreamedMsgCount(m.first), msgs.size());
+    }
+    ASSERT_EQ(done, archive.getEntryCount());
+    ASSERT_NE(output.str().find("[INFO] Verifying Articles' content..."), std::string::npos);
+
+    // Cancelled at the first progress report: the articles are not all
+    // checked and the unreachable entries are not searched.
+    output.str("");
+    size_t cancelledDone = 0;
+    checker.onProgress([&checker, &cancelledDone](size_t d, size_t) {
+        checker.cancel();
+        cancelledDone = d;
+    });
+    checker.check(archive);
+    ASSERT_TRUE(checker.isCancelled());
+    ASSERT_GT(cancelledDone, 0U);
+    ASSERT_LT(cancelledDone, archive.getEntryCount());
+    ASSERT_NE(output.str().find("[INFO] Article checks stopped at the first error"), std::string::npos);
+    ASSERT_EQ(output.str().find("[INFO] Link graph:"), std::string::npos);
+
+    ASSERT_EQ(checker.check("data/zimfiles/missing.zim"), EXCEPTION);
+    ASSERT_FALSE(checker.getError().empty());
+    ASSERT_FALSE(checker.isCancelled());
+}
+
+TEST(zimfilechecks, cluster_cache)
+{
+    const std::string cacheFn = "zimcheck-test-cluster-cache";
+    std::remove(cacheFn.c_str());
+    const Hash128 h1{1, 2}, h2{3, 4};
+
+    {
+        ClusterCache cache(cacheFn);
+        ASSERT_EQ(cache.size(), 0U);
+        ClusterInfo info;
+        info.insert(std::make_pair(0, BlobInfo{5, Hash128{6, 7}, false, {}, "image/png", 0}));
+        LinkTable links;
+        links.add(LinkAttribute::HREF, "a.html", 6);
+        info.insert(std::make_pair(1, BlobInfo{8, Hash128{9, 10}, true, links, "", 11}));
+        cache.add(h1, info);
+        cache.commit();
+    }
+
+    ClusterCache cache(cacheFn);
+    ASSERT_EQ(cache.size(), 1U);
+    ClusterInfo info;
+    ASSERT_FALSE(cache.find(h2, info));
+    ASSERT_TRUE(cache.find(h1, info));
+    ASSERT_EQ(info.size(), 2U);
+    ASSERT_EQ(info.at(0).size, 5U);
+    ASSERT_EQ(info.at(0).sniffedMimetype, "image/png");
+    ASSERT_FALSE(info.at(0).hasLinks);
+    ASSERT_EQ(info.at(1).hash, (Hash128{9, 10}));
+    ASSERT_TRUE(info.at(1).hasLinks);
+    ASSERT_EQ(info.at(1).links.size(), 1U);
+    ASSERT_EQ(info.at(1).links.str(info.at(1).links[0]), "a.html");
+    ASSERT_EQ(info.at(1).links[0].attribute, LinkAttribute::HREF);
+    ASSERT_EQ(info.at(1).textSignature, 11U);
+
+    // A string longer than the file is a corrupted record, ignored without
+    // allocating it.
+    {
+        std::ofstream corrupted(cacheFn, std::ios::binary | std::ios::trunc);
+        corrupted << "zimcheck-cluster-cache-3\n";
+        writeValue<uint64_t>(corrupted, h1.low);
+        writeValue<uint64_t>(corrupted, h1.high);
+        writeValue<uint32_t>(corrupted, 1);  // blob count
+        writeValue<zim::blob_index_type>(corrupted, 0);
+        writeValue<uint64_t>(corrupted, 5);  // size
+        writeValue<uint64_t>(corrupted, 6);  // hash
+        writeValue<uint64_t>(corrupted, 7);
+        writeValue<uint32_t>(corrupted, 0xfffffff0); // size of the mimetype
+    }
+    ASSERT_EQ(ClusterCache(cacheFn).size(), 0U);
+    std::remove(cacheFn.c_str());
+    std::remove((cacheFn + ".tmp").c_str());
+}
+
+TEST(zimfilechecks, content_hash_table)
+{
+    ContentHashTable table;
+    const std::string a = "some content";
+    const std::string b = "other content";
+
+    ASSERT_EQ(table.insert(contentHash(a), a.size(), 1), ContentHashTable::NO_ENTRY);
+    ASSERT_EQ(table.insert(contentHash(b), b.size(), 2), ContentHashTable::NO_ENTRY);
+    ASSERT_EQ(table.insert(contentHash(a), a.size(), 3), 1U);
+    ASSERT_EQ(table.insert(contentHash(b), b.size(), 4), 2U);
+    ASSERT_EQ(table.size(), 2U);
+
+    // Force the table to grow.
+    for (zim::entry_index_type i = 0; i < 10000; i++) {
+        const auto content = std::to_string(i);
+        ASSERT_EQ(table.insert(contentHash(content), content.size(), 10+i), ContentHashTable::NO_ENTRY);
+    }
+    ASSERT_EQ(table.insert(contentHash(a), a.size(), 5), 1U);
+    ASSERT_EQ(table.insert(contentHash("42"), 2, 6), 52U);
+    ASSERT_EQ(table.size(), 10002U);
+}
+
+TEST(zimfilechecks, external_sorter)
+{
+    // 1000 records by runs of 100.
+    ExternalSorter<uint64_t> sorter(100 * sizeof(uint64_t));
+    for (uint64_t i = 0; i < 1000; i++) {
+        sorter.add((i * 7919) % 1000);
+    }
+    ASSERT_EQ(sorter.size(), 1000U);
+    ASSERT_EQ(sorter.runCount(), 9U);
+    uint64_t expected = 0;
+    sorter.forEach([&](uint64_t value) { ASSERT_EQ(value, expected++); });
+    ASSERT_EQ(expected, 1000U);
+    ASSERT_EQ(sorter.size(), 0U);
+
+    // 100 runs of 10, merged in several passes.
+    ExternalSorter<uint64_t> smallSorter(10 * sizeof(uint64_t));
+    for (uint64_t i = 0; i < 1000; i++) {
+        smallSorter.add((i * 7919) % 1000);
+    }
+    ASSERT_EQ(smallSorter.runCount(), 99U);
+    expected = 0;
+    smallSorter.forEach([&](uint64_t value) { ASSERT_EQ(value, expected++); });
+    ASSERT_EQ(expected, 1000U);
+    ASSERT_EQ(smallSorter.runCount(), 0U);
+}
+
+TEST(zimfilechecks, redundancy_finder)
+{
+    // The same redundant items, in the same order, with or without budget.
+    typedef std::vector<std::pair<zim::entry_index_type, zim::entry_index_type>> Pairs;
+    const auto findRedundant = [](size_t maxMemory, bool& spilled) {
+        RedundancyFinder finder(maxMemory);
+        Pairs pairs;
+        for (zim::entry_index_type i = 0; i < 20000; i++) {
+            const auto content = std::to_string(i % 7000);
+            const auto first = finder.add(contentHash(content), content.size(), i);
+            if (first != ContentHashTable::NO_ENTRY && first != RedundancyFinder::PENDING) {
+                pairs.push_back(std::make_pair(first, i));
+            }
+        }
+        spilled = finder.isSpilling();
+        finder.finish([&](zim::entry_index_type first, zim::entry_index_type index) {
+            pairs.push_back(std::make_pair(first, index));
+        });
+        return pairs;
+    };
+    bool spilled;
+    const Pairs expected = findRedundant(0, spilled);
+    ASSERT_FALSE(spilled);
+    ASSERT_EQ(expected.size(), 13000U);
+    ASSERT_EQ(findRedundant(64 * 1024, spilled), expected);
+    ASSERT_TRUE(spilled);
+}
+
+TEST(zimfilechecks, path_index)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+
+    zim::Archive archive(fn);
+    PathIndex index(archive);
+
+    ASSERT_EQ(index.size(), archive.getEntryCount());
+    for (auto& entry:archive.iterByPath()) {
+        ASSERT_TRUE(index.contains(entry.getPath()));
+        ASSERT_EQ(index.find(entry.getPath()), entry.getIndex());
+        ASSERT_FALSE(index.contains(entry.getPath() + "_"));
+    }
+    ASSERT_FALSE(index.contains(""));
+    ASSERT_EQ(index.find(""), PathIndex::NOT_FOUND);
+    ASSERT_FALSE(PathIndex().contains(""));
+}
+
+TEST(zimfilechecks, dirent_scanner)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+
+    zim::Archive archive(fn);
+    const DirentScanner scanner(archive);
+    ASSERT_TRUE(scanner.isOpen());
+    ASSERT_GE(scanner.entryCount(), archive.getEntryCount());
+    DirentView dirent;
+    for (auto& entry:archive.iterByPath()) {
+        ASSERT_TRUE(scanner.get(entry.getIndex(), dirent));
+        const std::string path(dirent.path, dirent.pathSize);
+        ASSERT_EQ(std::string(1, dirent.ns) + "/" + path, entry.getPath());
+        if (dirent.titleSize) {
+            ASSERT_EQ(std::string(dirent.title, dirent.titleSize), entry.getTitle());
+        }
+        ASSERT_EQ(dirent.isRedirect(), entry.isRedirect());
+        if (entry.isRedirect()) {
+            ASSERT_EQ(dirent.redirectIndex, entry.getRedirectEntryIndex());
+        }
+    }
+    ASSERT_FALSE(scanner.get(scanner.entryCount(), dirent));
+}
+
+TEST(zimfilechecks, title_index)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+    {
+        zim::Archive archive(fn);
+        const DirentScanner scanner(archive);
+        ASSERT_TRUE(scanner.hasTitleIndex());
+        std::vector<uint32_t> entries;
+        for (uint32_t i = 0; i < scanner.entryCount(); i++) {
+            entries.push_back(scanner.titleEntry(i));
+        }
+        std::sort(entries.begin(), entries.end());
+        for (uint32_t i = 0; i < scanner.entryCount(); i++) {
+            ASSERT_EQ(entries[i], i);
+        }
+
+        ErrorLogger logger;
+        test_title_index(archive, logger, 2);
+        ASSERT_TRUE(logger.overalStatus());
+        ASSERT_EQ(logger.getReportMsgCount(TestType::TITLE_INDEX), 0U);
+    }
+
+    // A copy whose title index is broken.
+    std::ifstream in(fn, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint32_t entryCount;
+    uint64_t titlePointers;
+    std::memcpy(&entryCount, &data[24], 4);
+    std::memcpy(&titlePointers, &data[40], 8);
+    char* titles = &data[titlePointers];
+    // The first and the last titles swapped, an entry replaced by a missing one.
+    std::swap_ranges(titles, titles + 4, titles + 4 * (entryCount - 1));
+    std::memset(titles + 4 * (entryCount / 2), 0xff, 4);
+    const std::string brokenFn = "zimcheck-test-title-index.zim";
+    std::ofstream(brokenFn, std::ios::binary) << data;
+    {
+        zim::Archive archive(brokenFn);
+        ErrorLogger logger;
+        test_title_index(archive, logger, 2);
+        ASSERT_FALSE(logger.overalStatus());
+        std::vector<std::string> msgs;
+        logger.forEachReportMsg(TestType::TITLE_INDEX, [&msgs](const std::string& msg) {
+            msgs.push_back(msg);
+        });
+        ASSERT_EQ(msgs.size(), 4U);
+        ASSERT_EQ(msgs[0].find("Title index not sorted at position 1: "), 0U);
+        ASSERT_EQ(msgs[1], "Title index position " + std::to_string(entryCount / 2)
+                           + " points to a missing entry #4294967295");
+        ASSERT_EQ(msgs[2].find("Title index not sorted at position " + std::to_string(entryCount - 1)), 0U);
+        ASSERT_EQ(msgs[3], "1 entries missing from the title index");
+    }
+    std::remove(brokenFn.c_str());
+
+    // Split archives are not mapped, their title index is read through libzim.
+    const auto checkSplit = [](const std::string& content, ErrorLogger& logger) {
+        const std::string splitFn = "zimcheck-test-title-index-split.zim";
+        const size_t half = content.size() / 2;
+        std::ofstream(splitFn + "aa", std::ios::binary) << content.substr(0, half);
+        std::ofstream(splitFn + "ab", std::ios::binary) << content.substr(half);
+        {
+            zim::Archive archive(splitFn);
+            ASSERT_TRUE(archive.isMultiPart());
+            const DirentScanner scanner(archive);
+            ASSERT_FALSE(scanner.isOpen());
+            ASSERT_EQ(scanner.error(), "split archive");
+            test_title_index(archive, logger, 2);
+        }
+        std::remove((splitFn + "aa").c_str());
+        std::remove((splitFn + "ab").c_str());
+    };
+    {
+        std::ifstream original(fn, std::ios::binary);
+        const std::string content((std::istreambuf_iterator<char>(original)), std::istreambuf_iterator<char>());
+        ErrorLogger logger;
+        checkSplit(content, logger);
+        ASSERT_TRUE(logger.overalStatus());
+        ASSERT_EQ(logger.getReportMsgCount(TestType::TITLE_INDEX), 0U);
+    }
+    {
+        ErrorLogger logger;
+        checkSplit(data, logger);
+        ASSERT_FALSE(logger.overalStatus());
+        std::vector<std::string> msgs;
+        logger.forEachReportMsg(TestType::TITLE_INDEX, [&msgs](const std::string& msg) {
+            msgs.push_back(msg);
+        });
+        ASSERT_FALSE(msgs.empty());
+        ASSERT_EQ(msgs[0].find("Title index not sorted at position 1: "), 0U);
+    }
+}
+
+TEST(zimfilechecks, cluster_stats)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+
+    zim::Archive archive(fn);
+    ClusterStats stats(archive);
+    ClusterRecord first = stats.describe(0);
+    ASSERT_EQ(first.cluster, 0U);
+    ASSERT_GT(first.compressedSize, 0U);
+    ASSERT_GE(first.compression, 0);
+    // The last cluster ends at the checksum.
+    zim::cluster_index_type last = 0;
+    for (zim::cluster_index_type i = 0; i < archive.getClusterCount(); i++) {
+        if (archive.getClusterOffset(i) > archive.getClusterOffset(last)) {
+            last = i;
+        }
+    }
+    ASSERT_GT(stats.describe(last).compressedSize, 0U);
+    // A cluster loaded in two parts, the blob 1 being in both.
+    ClusterRecord second = first;
+    first.addBlob(0, "text/html", 100);
+    first.addBlob(1, "text/html", 200);
+    first.addBlob(1, "text/html", 200);
+    second.addBlob(1, "text/html", 200);
+    second.addBlob(2, "image/png", 50);
+    stats.add(first);
+    stats.add(second);
+    ClusterRecord other = stats.describe(1);
+    other.addBlob(0, "image/png", 10);
+    stats.add(other);
+    stats.finish();
+    ASSERT_EQ(stats.clusterCount(), 2U);
+
+    std::ostringstream out;
+    stats.report(out);
+    ASSERT_EQ(out.str().find("[INFO] Clusters: 2 clusters, 4 blobs, 360 bytes"), 0U);
+    ASSERT_NE(out.str().find("text/html"), std::string::npos);
+}
+
+TEST(zimfilechecks, link_graph)
+{
+    // 0 -> 1 -> 2 -> 0, 3 -> 4, 5 alone.
+    LinkGraph graph(6);
+    graph.addEdges(1, {2});
+    graph.addEdges(0, {1});
+    graph.addEdges(3, {4});
+    graph.addEdges(2, {0, 7});
+    for (uint32_t node = 1; node < 6; node++) {
+        graph.addItem(node, 100 * node);
+    }
+    ASSERT_EQ(graph.nodeCount(), 6U);
+    ASSERT_EQ(graph.edgeCount(), 5U);
+    ASSERT_FALSE(graph.isItem(0));
+    ASSERT_TRUE(graph.isItem(5));
+    ASSERT_EQ(graph.itemSize(5), 500U);
+
+    ASSERT_EQ(graph.markReachable({0}), 3U);
+    ASSERT_TRUE(graph.isReachable(0));
+    ASSERT_TRUE(graph.isReachable(2));
+    ASSERT_FALSE(graph.isReachable(3));
+    ASSERT_FALSE(graph.isReachable(4));
+    ASSERT_FALSE(graph.isReachable(5));
+
+    ASSERT_EQ(graph.markReachable({3, 5, 3}), 3U);
+    ASSERT_FALSE(graph.isReachable(0));
+    ASSERT_TRUE(graph.isReachable(4));
+    ASSERT_EQ(graph.markReachable({}), 0U);
+    ASSERT_THROW(graph.markReachable({0, 6}), std::out_of_range);
+
+    std::stringstream stream;
+    graph.save(stream);
+    LinkGraph loaded;
+    loaded.load(stream);
+    ASSERT_EQ(loaded.nodeCount(), 6U);
+    ASSERT_EQ(loaded.edgeCount(), 5U);
+    ASSERT_TRUE(loaded.isItem(1));
+    ASSERT_EQ(loaded.itemSize(1), 100U);
+    ASSERT_FALSE(loaded.isItem(0));
+    ASSERT_EQ(loaded.markReachable({1}), 3U);
+    ASSERT_TRUE(loaded.isReachable(0));
+}
+
+TEST(zimfilechecks, unreachable_new_namespace)
+{
+    // The archives written by libzim 7 use the new namespace scheme: the main
+    // entry is the W/mainPage redirection, out of the user entries.
+    const std::string fn = "zimcheck-test-unreachable.zim";
+    {
+        zim::writer::Creator creator;
+        creator.startZimCreation(fn);
+        creator.addItem(zim::writer::StringItem::create("index.html", "text/html", "Index",
+            "<html><body><a href=\"a.html\">a</a><a href=\"old.html\">old</a></body></html>"));
+        creator.addItem(zim::writer::StringItem::create("a.html", "text/html", "A",
+            "<html><body><img src=\"image.png\"></body></html>"));
+        creator.addItem(zim::writer::StringItem::create("b.html", "text/html", "B",
+            "<html><body>Not linked</body></html>"));
+        creator.addItem(zim::writer::StringItem::create("c.html", "text/html", "C",
+            "<html><body>Only from the redirection</body></html>"));
+        creator.addItem(zim::writer::StringItem::create("image.png", "image/png", "", "png"));
+        creator.addItem(zim::writer::StringItem::create("favicon.png", "image/png", "", "png"));
+        creator.addRedirection("old.html", "Old", "c.html");
+        creator.setMainPath("index.html");
+        creator.finishZimCreation();
+    }
+
+    zim::Archive archive(fn);
+    ASSERT_TRUE(archive.hasNewNamespaceScheme());
+    ASSERT_GE(archive.getMainEntry().getIndex(), archive.getEntryCount());
+    ErrorLogger logger;
+    ProgressBar progress(1);
+    ArticleCheckOptions options;
+    options.unreachable_check = true;
+    test_articles(archive, logger, progress, options);
+    std::remove(fn.c_str());
+
+    ASSERT_FALSE(logger.getTestResult(TestType::UNREACHABLE));
+    std::vector<std::string> msgs;
+    logger.forEachReportMsg(TestType::UNREACHABLE, [&msgs](const std::string& msg) {
+        msgs.push_back(msg);
+    });
+    ASSERT_EQ(msgs.size(), 2U);
+    ASSERT_EQ(msgs[0].find("1 items ("), 0U);
+    ASSERT_EQ(msgs[1].find("Entry b.html ("), 0U);
+}
+
+TEST(zimfilechecks, redirect_table)
+{
+    // 3 -> 2 -> 1 -> 0, 4 -> 4, 7 -> 5 -> 6 -> 5, 9 -> 8 -> (missing).
+    RedirectTable redirects(10);
+    redirects.setTarget(3, 2);
+    redirects.setTarget(2, 1);
+    redirects.setTarget(1, 0);
+    redirects.setTarget(4, 4);
+    redirects.setTarget(7, 5);
+    redirects.setTarget(6, 5);
+    redirects.setTarget(5, 6);
+    redirects.setTarget(9, 8);
+    redirects.setTarget(8, 100);
+    ASSERT_EQ(redirects.redirectCount(), 9U);
+    redirects.resolve();
+
+    ASSERT_EQ(redirects.getFinalTarget(0), RedirectTable::NONE);
+    ASSERT_EQ(redirects.getFinalTarget(1), 0U);
+    ASSERT_EQ(redirects.getChainLength(1), 1U);
+    ASSERT_EQ(redirects.getFinalTarget(3), 0U);
+    ASSERT_EQ(redirects.getChainLength(3), 3U);
+    ASSERT_TRUE(redirects.isTargeted(2));
+    ASSERT_FALSE(redirects.isTargeted(3));
+
+    ASSERT_EQ(redirects.getFinalTarget(4), RedirectTable::LOOP);
+    ASSERT_EQ(redirects.getFinalTarget(6), RedirectTable::LOOP);
+    ASSERT_EQ(redirects.getFinalTarget(7), RedirectTable::LOOP);
+    ASSERT_EQ(redirects.getChainLength(7), 3U);
+    const std::vector<std::vector<uint32_t>> loops{{4}, {5, 6}};
+    ASSERT_EQ(redirects.getLoops(), loops);
+
+    ASSERT_EQ(redirects.getFinalTarget(8), RedirectTable::DANGLING);
+    ASSERT_EQ(redirects.getFinalTarget(9), RedirectTable::DANGLING);
+    ASSERT_EQ(redirects.getChainLength(9), 2U);
+}
+
+TEST(zimfilechecks, test_redirects)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+    {
+        zim::Archive archive(fn);
+        ErrorLogger logger;
+        test_redirects(archive, logger, 1);
+        ASSERT_TRUE(logger.overalStatus());
+        ASSERT_EQ(logger.getReportMsgCount(TestType::REDIRECT), 0U);
+        ASSERT_EQ(logger.getReportMsgCount(TestType::REDIRECT_CHAIN), 0U);
+    }
+
+    // A copy with a loop (5 -> 6 -> 5), a redirection to the loop (0 -> 5)
+    // and a redirection to a missing entry (27).
+    std::ifstream in(fn, std::ios::binary);
+    std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint32_t entryCount;
+    uint64_t pathPointers;
+    std::memcpy(&entryCount, &data[24], 4);
+    std::memcpy(&pathPointers, &data[32], 8);
+    const auto setTarget = [&](uint32_t entry, uint32_t target) {
+        uint64_t dirent;
+        std::memcpy(&dirent, &data[pathPointers + 8 * entry], 8);
+        ASSERT_EQ(data.compare(dirent, 2, "\xff\xff"), 0); // Already a redirection.
+        std::memcpy(&data[dirent + 8], &target, 4);
+    };
+    setTarget(5, 6);
+    setTarget(6, 5);
+    setTarget(0, 5);
+    setTarget(27, entryCount + 10);
+    const std::string brokenFn = "zimcheck-test-redirects.zim";
+    std::ofstream(brokenFn, std::ios::binary) << data;
+    {
+        zim::Archive archive(brokenFn);
+        ErrorLogger logger;
+        test_redirects(archive, logger, 1);
+        ASSERT_FALSE(logger.overalStatus());
+        std::vector<std::string> msgs;
+        logger.forEachReportMsg(TestType::REDIRECT, [&msgs](const std::string& msg) {
+            msgs.push_back(msg);
+        });
+        ASSERT_EQ(msgs.size(), 3U);
+        ASSERT_EQ(msgs[0], "Redirection loop: A/Main_Page.html -> A/index.htm -> A/Main_Page.html");
+        // The chain and the whole loop.
+        ASSERT_EQ(msgs[1], "Redirection to a loop: -/favicon -> A/Main_Page.html -> A/index.htm"
+                           " -> A/Main_Page.html");
+        ASSERT_EQ(msgs[2].find("Redirection to a missing entry: A/"), 0U);
+        const std::string missing = " -> #" + std::to_string(entryCount + 10);
+        ASSERT_EQ(msgs[2].substr(msgs[2].size() - missing.size()), missing);
+        ASSERT_EQ(logger.getReportMsgCount(TestType::REDIRECT_CHAIN), 0U);
+    }
+    std::remove(brokenFn.c_str());
+}
+
+TEST(zimfilechecks, near_duplicates)
+{
+    std::ostringstream text, other;
+    for (int i = 0; i < 500; i++) {
+        text << "word" << (i * 7919) % 1009 << (i % 10 ? " " : ".\n");
+        other << "other" << (i * 104729) % 1013 << ' ';
+    }
+    const std::string page = "<html><body><p>" + text.str() + "</p></body></html>";
+    const uint64_t signature = textSignature(page);
+    ASSERT_NE(signature, 0U);
+    // Only the visible text matters.
+    ASSERT_EQ(textSignature("<html><head><style>p { color: red }</style></head><body><!-- comment -->"
+                            "<div class=\"a\">" + text.str() + "</div><script>var x = 1;</script></body></html>"),
+              signature);
+    ASSERT_EQ(textSignature("<p>A short text</p>"), 0U);
+    std::string changed = page;
+    changed.replace(changed.find("word"), 4, "changed");
+    const uint64_t changedSignature = textSignature(changed);
+    ASSERT_NE(changedSignature, signature);
+    ASSERT_LE(signatureDistance(changedSignature, signature), 3U);
+    ASSERT_GT(signatureDistance(textSignature(other.str()), signature), 10U);
+
+    NearDuplicateFinder finder(0.95);
+    ASSERT_EQ(finder.maxDistance(), 3U);
+    const uint64_t a = 0x0123456789abcdefULL;
+    finder.add(a, 10);
+    finder.add(~a, 11);
+    finder.add(a ^ 0x8000000000000001ULL, 12); // 2 bits in 2 different bands.
+    finder.add(~a ^ 0x7, 13);                 // 3 bits in the same band.
+    finder.add(a ^ 0xf0, 14);                 // 4 bits.
+    finder.add(a, 15);
+    finder.add(0x5555555555555555ULL, 16);
+    // Many signatures sharing a band are not all compared together.
+    for (uint32_t i = 0; i < 1000; i++) {
+        finder.add((uint64_t(i) * 0x9e3779b97f4a7c15ULL) << 16, 100 + i);
+    }
+    const std::vector<std::vector<uint32_t>> groups{{10, 12, 15}, {11, 13}};
+    ASSERT_EQ(finder.findGroups(), groups);
+
+    NearDuplicateFinder identical(1);
+    ASSERT_EQ(identical.maxDistance(), 0U);
+    identical.add(a, 1);
+    identical.add(a ^ 1, 2);
+    identical.add(a, 3);
+    ASSERT_EQ(identical.findGroups(), (std::vector<std::vector<uint32_t>>{{1, 3}}));
+
+    // The groups are ordered by their first added item, not by their second.
+    NearDuplicateFinder interleaved(1);
+    interleaved.add(a, 1);
+    interleaved.add(~a, 2);
+    interleaved.add(~a, 3);
+    interleaved.add(a, 4);
+    ASSERT_EQ(interleaved.findGroups(), (std::vector<std::vector<uint32_t>>{{1, 4}, {2, 3}}));
+}
+
+TEST(zimfilechecks, link_cache)
+{
+    LinkCache cache(128);
+    LinkTarget target;
+    const auto get = [&cache, &target](const std::string& baseUrl, const std::string& link) {
+        return cache.get(baseUrl, link.data(), link.size(), target);
+    };
+    const auto put = [&cache](const std::string& baseUrl, const std::string& link, const LinkTarget& target) {
+        cache.put(baseUrl, link.data(), link.size(), target);
+    };
+
+    ASSERT_FALSE(get("A", "b.html"));
+    put("A", "b.html", LinkTarget{false, true, "A/b.html"});
+    ASSERT_TRUE(get("A", "b.html"));
+    ASSERT_FALSE(target.outOfBounds);
+    ASSERT_TRUE(target.found);
+    ASSERT_EQ(target.path, "A/b.html");
+    // The same link in another directory is another target.
+    ASSERT_FALSE(get("I", "b.html"));
+    // The base url and the link are not mixed up, whatever they contain.
+    put("A\n", "c.html", LinkTarget{false, false, "A/c.html"});
+    ASSERT_FALSE(get("A", "\nc.html"));
+    ASSERT_TRUE(get("A\n", "c.html"));
+    ASSERT_EQ(cache.hits(), 2U);
+    ASSERT_EQ(cache.misses(), 3U);
+
+    // The cache stays bounded.
+    for (int i = 0; i < 100000; i++) {
+        put("A", std::to_string(i), LinkTarget{false, false, std::to_string(i)});
+    }
+    int cached = 0;
+    for (int i = 0; i < 100000; i++) {
+        cached += get("A", std::to_string(i));
+    }
+    ASSERT_LE(cached, 128 + 64);
+}
+
+TEST(zimfilechecks, error_logger_fail_fast)
+{
+    CancellationToken cancellation;
+    ErrorLogger logger;
+    logger.setFailFast(&cancellation, {TestType::URL_INTERNAL, TestType::MIME});
+    ErrorLogger shard;
+    logger.shareFailFast(shard);
+
+    logger.setTestResult(TestType::URL_EXTERNAL, false);
+    ASSERT_FALSE(logger.isCancelled());
+    logger.setTestResult(TestType::MIME, true);
+    ASSERT_FALSE(logger.isCancelled());
+
+    shard.setTestResult(TestType::URL_INTERNAL, false);
+    ASSERT_TRUE(cancellation.isCancelled());
+    ASSERT_TRUE(logger.isCancelled());
+    ASSERT_TRUE(shard.isCancelled());
+
+    ASSERT_FALSE(ErrorLogger().isCancelled());
+}
+
+TEST(zimfilechecks, error_logger_spill)
+{
+    ErrorLogger logger;
+    ErrorLogger spilled;
+    spilled.setMaxMsgMemory(1000);
+    for (int i = 0; i < 100; i++) {
+        const auto type = i % 2 ? TestType::EMPTY : TestType::REDUNDANT;
+        logger.addReportMsg(type, "message " + std::to_string(i));
+        spilled.addReportMsg(type, "message " + std::to_string(i));
+    }
+    ASSERT_GT(spilled.getSpilledMsgCount(TestType::EMPTY), 0U);
+    ASSERT_EQ(spilled.getReportMsgCount(TestType::EMPTY), 50U);
+    ASSERT_EQ(getReport(spilled), getReport(logger));
+
+    ErrorLogger merged;
+    merged.merge(spilled);
+    ASSERT_EQ(getReport(merged), getReport(logger));
+
+    // A worker logger gets its part of the memory of the messages.
+    ErrorLogger worker;
+    spilled.shareLimits(worker, 4);
+    for (int i = 0; i < 20; i++) {
+        worker.addReportMsg(TestType::EMPTY, "message " + std::to_string(i));
+    }
+    ASSERT_GT(worker.getSpilledMsgCount(TestType::EMPTY), 0U);
+    ASSERT_EQ(worker.getReportMsgCount(TestType::EMPTY), 20U);
+
+    std::stringstream stream;
+    spilled.save(stream);
+    ErrorLogger loaded;
+    loaded.load(stream);
+    ASSERT_EQ(getReport(loaded), getReport(logger));
+}
+
+TEST(zimfilechecks, error_logger_json_sink)
+{
+    std::ostringstream out;
+    JsonLinesSink sink(out);
+    ErrorLogger logger;
+    logger.setMaxReportMsgs(2);
+    logger.setReportSink(&sink);
+
+    logger.setTestResult(TestType::URL_INTERNAL, false);
+    // All the findings reach the sink, whatever the limit of the messages
+    // kept in memory: they are only counted.
+    for (int i = 0; i < 3; i++) {
+        logger.addReportMsg(TestType::URL_INTERNAL, "link \"" + std::to_string(i) + "\"\n");
+    }
+    ASSERT_EQ(logger.getReportMsgCount(TestType::URL_INTERNAL), 3U);
+    ASSERT_EQ(logger.getStreamedMsgCount(TestType::URL_INTERNAL), 3U);
+    ASSERT_EQ(logger.getDroppedMsgCount(TestType::URL_INTERNAL), 0U);
+    ASSERT_EQ(logger.getReportMsgCount(TestType::EMPTY), 0U);
+    size_t kept = 0;
+    logger.forEachReportMsg(TestType::URL_INTERNAL, [&kept](const std::string&) { kept++; });
+    ASSERT_EQ(kept, 0U);
+
+    // The shards don't drop the messages either.
+    ErrorLogger shard;
+    logger.shareLimits(shard);
+    ASSERT_EQ(shard.getMaxReportMsgs(), 0U);
+    shard.addReportMsg(TestType::URL_INTERNAL, "other");
+    shard.addReportMsg(TestType::URL_INTERNAL, "another");
+    shard.addReportMsg(TestType::URL_INTERNAL, "yet another");
+    logger.merge(shard);
+    ASSERT_EQ(logger.getReportMsgCount(TestType::URL_INTERNAL), 6U);
+    ASSERT_EQ(logger.getDroppedMsgCount(TestType::URL_INTERNAL), 0U);
+
+    sink.finish(logger);
+    const std::string finding = "{\"type\":\"finding\",\"check\":\"url_internal\",\"level\":\"ERROR\",\"message\":";
+    ASSERT_EQ(out.str(),
+        finding + "\"link \\\"0\\\"\\n\"}\n"
+        + finding + "\"link \\\"1\\\"\\n\"}\n"
+        + finding + "\"link \\\"2\\\"\\n\"}\n"
+        + finding + "\"other\"}\n"
+        + finding + "\"another\"}\n"
+        + finding + "\"yet another\"}\n"
+        "{\"type\":\"summary\",\"status\":\"fail\",\"checks\":["
+        "{\"check\":\"checksum\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"integrity\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"empty\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"metadata\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"favicon\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"main_page\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"redundant\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"url_internal\",\"status\":\"fail\",\"count\":6,\"dropped\":0},"
+        "{\"check\":\"url_external\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"mime\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"unreachable\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"redirect\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"redirect_chain\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"near_duplicate\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"title_index\",\"status\":\"pass\",\"count\":0,\"dropped\":0},"
+        "{\"check\":\"other\",\"status\":\"pass\",\"count\":0,\"dropped\":0}]}\n");
+}
+
+namespace
+{
+
+// The lines written to the stream, as the reader of a pipe would see them:
+// only when the stream is flushed.
+class FlushedLines : public std::stringbuf
+{
+  public:
+    std::vector<std::string> lines;
+
+  protected:
+    int sync()
+    {
+        lines.push_back(str());
+        str("");
+        return 0;
+    }
+};
+
+} // unnamed namespace
+
+TEST(zimfilechecks, json_sink_flush)
+{
+    FlushedLines flushed;
+    std::ostream out(&flushed);
+    JsonLinesSink sink(out, "a.zim");
+    sink.addFinding(TestType::EMPTY, "empty");
+    ASSERT_EQ(flushed.lines, std::vector<std::string>({
+        "{\"type\":\"finding\",\"file\":\"a.zim\",\"check\":\"empty\",\"level\":\"ERROR\",\"message\":\"empty\"}\n"}));
+    sink.addLine("{}");
+    ASSERT_EQ(flushed.lines.size(), 2U);
+    ASSERT_EQ(flushed.lines[1], "{}\n");
+}
+
+TEST(zimfilechecks, checkpoint)
+{
+    const std::string checkpointFn = "zimcheck-test-checkpoint";
+    std::remove(checkpointFn.c_str());
+
+    ErrorLogger logger;
+    logger.setMaxReportMsgs(1);
+    logger.setTestResult(TestType::REDUNDANT, false);
+    logger.addReportMsg(TestType::REDUNDANT, "a and b");
+    logger.addReportMsg(TestType::REDUNDANT, "a and c");
+    ContentHashTable table;
+    table.insert(contentHash("a"), 1, 1);
+
+    Checkpoint checkpoint(checkpointFn, false, 100);
+    ASSERT_TRUE(checkpoint.isDue());
+    checkpoint.save("id", 42, logger, table);
+    ASSERT_EQ(checkpoint.getSaveCount(), 1U);
+
+    uint64_t nextChunk = 0;
+    ErrorLogger loadedLogger;
+    ContentHashTable loadedTable;
+    // Not resuming, the checkpoint is ignored.
+    ASSERT_FALSE(checkpoint.load("id", nextChunk, loadedLogger, loadedTable));
+
+    Checkpoint resumed(checkpointFn, true, 100);
+    ASSERT_THROW(resumed.load("other id", nextChunk, loadedLogger, loadedTable), std::runtime_error);
+    ASSERT_TRUE(resumed.load("id", nextChunk, loadedLogger, loadedTable));
+    ASSERT_EQ(nextChunk, 42U);
+    ASSERT_EQ(getReport(loadedLogger), getReport(logger));
+    ASSERT_FALSE(loadedLogger.getTestResult(TestType::REDUNDANT));
+    ASSERT_EQ(loadedLogger.getDroppedMsgCount(TestType::REDUNDANT), 1U);
+    ASSERT_EQ(loadedTable.size(), 1U);
+    ASSERT_EQ(loadedTable.insert(contentHash("a"), 1, 2), 1U);
+
+    // The findings restored with a sink already reached it, they are only counted.
+    std::ostringstream out;
+    JsonLinesSink sink(out);
+    ErrorLogger sinkLogger;
+    sinkLogger.setReportSink(&sink);
+    sinkLogger.merge(loadedLogger, false);
+    ASSERT_TRUE(out.str().empty());
+    ASSERT_EQ(sinkLogger.getReportMsgCount(TestType::REDUNDANT), 2U);
+    ASSERT_FALSE(sinkLogger.getTestResult(TestType::REDUNDANT));
+
+    // A logger with a sink only saves the counts of its findings.
+    ErrorLogger countingLogger;
+    countingLogger.setReportSink(&sink);
+    countingLogger.merge(logger);
+    std::ostringstream saved;
+    countingLogger.save(saved);
+    ASSERT_EQ(saved.str().find("a and b"), std::string::npos);
+    std::istringstream savedIn(saved.str());
+    ErrorLogger restoredLogger;
+    restoredLogger.load(savedIn);
+    ASSERT_EQ(restoredLogger.getReportMsgCount(TestType::REDUNDANT), 2U);
+    ASSERT_EQ(restoredLogger.getStreamedMsgCount(TestType::REDUNDANT), 1U);
+    ASSERT_FALSE(restoredLogger.getTestResult(TestType::REDUNDANT));
+
+    resumed.finish();
+    ASSERT_FALSE(resumed.load("id", nextChunk, loadedLogger, loadedTable));
+
+    // The clusters added to the cache before the checkpoint are kept on resume.
+    const std::string cacheFn = "zimcheck-test-checkpoint-cache";
+    std::remove(cacheFn.c_str());
+    {
+        ClusterCache cache(cacheFn);
+        ClusterInfo info;
+        info.insert(std::make_pair(0, BlobInfo{5, Hash128{6, 7}, false, {}, "image/png", 0}));
+        cache.add(Hash128{1, 2}, info);
+        checkpoint.save("id", 1, logger, table, nullptr, &cache);
+        // Interrupted: the cache is not committed.
+    }
+    {
+        ClusterCache cache(cacheFn);
+        ASSERT_EQ(cache.size(), 0U);
+        ASSERT_TRUE(resumed.load("id", nextChunk, loadedLogger, loadedTable, nullptr, &cache));
+        cache.commit();
+    }
+    ClusterCache cache(cacheFn);
+    ASSERT_EQ(cache.size(), 1U);
+    ClusterInfo info;
+    ASSERT_TRUE(cache.find(Hash128{1, 2}, info));
+    ASSERT_EQ(info.at(0).sniffedMimetype, "image/png");
+    cache.commit();
+    resumed.finish();
+    std::remove(cacheFn.c_str());
+}
+
+TEST(zimfilechecks, thread_pool)
+{
+    for (unsigned int threadCount : {0U, 1U, 4U}) {
+        std::atomic<int> done(0);
+        std::vector<int> jobResults(8, 0);
+        {
+            ThreadPool pool(threadCount);
+            ASSERT_EQ(pool.size(), threadCount);
+            for (int job = 0; job < 8; job++) {
+                pool.submitJob([&, job]() {
+                    // A job waiting for its own tasks must not block a worker.
+                    std::atomic<int> tasksDone(0);
+                    for (int task = 0; task < 100; task++) {
+                        pool.submit([&]() { tasksDone++; done++; });
+                    }
+                    pool.helpUntil([&]() { return tasksDone == 100; });
+                    jobResults[job] = tasksDone;
+                });
+            }
+            pool.wait();
+            ASSERT_EQ(done, 800);
+        }
+        ASSERT_EQ(jobResults, std::vector<int>(8, 100));
+    }
+
+    // The tasks submitted first run before the ones already waiting.
+    ThreadPool pool(1);
+    std::atomic<bool> started(false);
+    std::atomic<bool> release(false);
+    std::vector<int> order;
+    pool.submit([&]() {
+        started = true;
+        while (!release) {
+            std::this_thread::yield();
+        }
+    });
+    while (!started) {
+        std::this_thread::yield();
+    }
+    for (int task = 1; task <= 3; task++) {
+        pool.submit([&order, task]() { order.push_back(task); });
+    }
+    pool.submitFirst([&order]() { order.push_back(0); });
+    release = true;
+    pool.wait();
+    ASSERT_EQ(order, std::vector<int>({0, 1, 2, 3}));
+}
+
+TEST(zimfilechecks, thread_budget)
+{
+    // A pool of N - 1 workers and the thread helping it run the tasks on N
+    // threads.
+    for (unsigned int threadCount : {1U, 3U}) {
+        std::mutex mutex;
+        std::set<std::thread::id> threads;
+        std::atomic<int> done(0);
+        ThreadPool pool(threadCount - 1);
+        for (int task = 0; task < 200; task++) {
+            pool.submit([&]() {
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    threads.insert(std::this_thread::get_id());
+                }
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+                done++;
+            });
+        }
+        pool.helpUntil([&]() { return done == 200; });
+        ASSERT_LE(threads.size(), threadCount);
+        if (threadCount == 1) {
+            ASSERT_EQ(threads, std::set<std::thread::id>{std::this_thread::get_id()});
+        }
+    }
+
+    // The article checks count the threads running them.
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+    zim::Archive archive(fn);
+    ProgressBar progress(1);
+    for (unsigned int threadCount : {1U, 2U}) {
+        ErrorLogger logger;
+        Timings timings;
+        test_articles(archive, logger, progress, allArticleChecks(threadCount),
+                      nullptr, nullptr, nullptr, nullptr, &timings);
+        ASSERT_GE(timings.threadCount(), 1U);
+        ASSERT_LE(timings.threadCount(), threadCount);
+    }
+}
+
+TEST(zimfilechecks, test_articles_read_ahead)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+    zim::Archive archive(fn);
+    ProgressBar progress(1);
+
+    // With idle workers, the next cluster is loaded before it is needed (a
+    // few runs, as it depends on the scheduling).
+    uint64_t readAhead = 0;
+    for (int run = 0; run < 20 && readAhead == 0; run++) {
+        ErrorLogger logger;
+        Timings timings;
+        test_articles(archive, logger, progress, allArticleChecks(4),
+                      nullptr, nullptr, nullptr, nullptr, &timings);
+        ASSERT_GT(timings.clusterLoadCount(), 1U);
+        readAhead = timings.readAheadCount();
+    }
+    ASSERT_GT(readAhead, 0U);
+}
+
+TEST(zimfilechecks, mime_sniffer)
+{
+    const std::string png("\x89PNG\r\n\x1a\n\0\0\0\rIHDR", 16);
+    const std::string webp("RIFF\x10\0\0\0WEBPVP8 ", 16);
+    const std::string mp4("\0\0\0\x18" "ftypmp42", 12);
+    ASSERT_EQ(sniffMimetype(png.data(), png.size()), "image/png");
+    ASSERT_EQ(sniffMimetype(png.data(), 4), "");
+    ASSERT_EQ(sniffMimetype("\xff\xd8\xff\xe0", 4), "image/jpeg");
+    ASSERT_EQ(sniffMimetype("GIF89a", 6), "image/gif");
+    ASSERT_EQ(sniffMimetype(webp.data(), webp.size()), "image/webp");
+    ASSERT_EQ(sniffMimetype(mp4.data(), mp4.size()), "video/mp4");
+    ASSERT_EQ(sniffMimetype("%PDF-1.4", 8), "application/pdf");
+    ASSERT_EQ(sniffMimetype("<!DOCTYPE html>", 15), "");
+    ASSERT_EQ(sniffMimetype("BMW", 3), "");
+    ASSERT_EQ(sniffMimetype("", 0), "");
+
+    ASSERT_TRUE(isMimetypeCoherent("image/png", "image/png"));
+    ASSERT_TRUE(isMimetypeCoherent("image/jpg", "image/jpeg"));
+    ASSERT_TRUE(isMimetypeCoherent("Audio/Ogg; codecs=opus", "audio/ogg"));
+    ASSERT_TRUE(isMimetypeCoherent("application/epub+zip", "application/zip"));
+    ASSERT_TRUE(isMimetypeCoherent("application/octet-stream", "image/png"));
+    ASSERT_TRUE(isMimetypeCoherent("text/html", ""));
+    ASSERT_TRUE(isMimetypeCoherent("audio/mpeg", ""));
+    ASSERT_FALSE(isMimetypeCoherent("image/png", "image/jpeg"));
+    ASSERT_FALSE(isMimetypeCoherent("text/html", "image/gif"));
+    ASSERT_FALSE(isMimetypeCoherent("image/png", ""));
+    ASSERT_FALSE(isMimetypeCoherent("application/pdf", ""));
+}
+
+TEST(zimfilechecks, sampling)
+{
+    const Sampling sampling{10, 42};
+    size_t sampled = 0;
+    for (zim::cluster_index_type cluster = 0; cluster < 10000; cluster++) {
+        const bool inSample = isClusterSampled(sampling, cluster);
+        ASSERT_EQ(inSample, isClusterSampled(sampling, cluster));
+        sampled += inSample;
+    }
+    ASSERT_GT(sampled, 800U);
+    ASSERT_LT(sampled, 1200U);
+
+    SampleEstimator estimator(0.1);
+    for (size_t i = 0; i < 100; i++) {
+        ClusterSample sample;
+        sample.items = 10;
+        sample.failed[size_t(TestType::URL_INTERNAL)] = i % 2;
+        estimator.addCluster(sample);
+    }
+    ASSERT_EQ(estimator.getClusterCount(), 100U);
+    ASSERT_EQ(estimator.getItemCount(), 1000U);
+
+    const auto links = estimator.estimate(TestType::URL_INTERNAL);
+    ASSERT_EQ(links.failed, 50U);
+    ASSERT_DOUBLE_EQ(links.rate, 0.05);
+    ASSERT_LT(links.low, 0.05);
+    ASSERT_GT(links.high, 0.05);
+    ASSERT_GT(links.low, 0.03);
+    ASSERT_LT(links.high, 0.07);
+
+    // Nothing found: the upper bound is 3 / items.
+    const auto empty = estimator.estimate(TestType::EMPTY);
+    ASSERT_EQ(empty.failed, 0U);
+    ASSERT_DOUBLE_EQ(empty.rate, 0);
+    ASSERT_DOUBLE_EQ(empty.high, 0.003);
+}
+
+TEST(zimfilechecks, progress_bar)
+{
+    std::ostringstream json;
+    auto cerrBuf = std::cerr.rdbuf(json.rdbuf());
+    ProgressBar progress(0.001);
+    progress.set_progress_report(true, ProgressBar::Format::JSON);
+    std::vector<std::pair<uint64_t, uint64_t>> calls;
+    bool calledByReporter = true;
+    const auto mainThread = std::this_thread::get_id();
+    progress.set_callback([&](uint64_t done, uint64_t total) {
+        calls.push_back(std::make_pair(done, total));
+        calledByReporter = calledByReporter && std::this_thread::get_id() != mainThread;
+    });
+    // More than 2^32 items, reported by several threads.
+    const uint64_t total = 4000 + (uint64_t(1) << 32);
+    progress.reset(total);
+    progress.report(uint64_t(1) << 32);
+    std::vector<std::thread> workers;
+    for (int t = 0; t < 4; t++) {
+        workers.emplace_back([&progress]() {
+            for (int i = 0; i < 1000; i++) {
+                progress.report(1, 10);
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    // Past the end, neither the items nor the bytes are counted.
+    progress.report(1, uint64_t(1) << 40);
+    progress.finish();
+    std::cerr.rdbuf(cerrBuf);
+
+    // The callback is called by the reporter thread (not by report()), with
+    // an increasing counter, up to the total.
+    ASSERT_TRUE(calledByReporter);
+    ASSERT_FALSE(calls.empty());
+    for (size_t i = 1; i < calls.size(); i++) {
+        ASSERT_GT(calls[i].first, calls[i-1].first);
+        ASSERT_EQ(calls[i].second, total);
+    }
+    ASSERT_EQ(calls.back().first, total);
+    // The last JSON line is the end of the task.
+    const std::string out = json.str();
+    ASSERT_FALSE(out.empty());
+    ASSERT_EQ(out.back(), '\n');
+    const auto lastLine = out.substr(out.rfind('\n', out.size() - 2) + 1);
+    ASSERT_EQ(lastLine.find("{\"type\":\"progress\",\"done\":" + std::to_string(total)
+                            + ",\"total\":" + std::to_string(total) + ","), 0U);
+    std::istringstream lines(out);
+    std::string line;
+    while (std::getline(lines, line)) {
+        ASSERT_EQ(line.find("{\"type\":\"progress\""), 0U);
+    }
+}
+
+TEST(zimfilechecks, progress_bar_last_report)
+{
+    // The task is done (or finished) before the reporter thread waits: the
+    // last line and the last counter are still given.
+    for (int i = 0; i < 100; i++) {
+        std::ostringstream text;
+        auto coutBuf = std::cout.rdbuf(text.rdbuf());
+        ProgressBar progress(60);
+        progress.set_progress_report(true);
+        uint64_t last = 0;
+        progress.set_callback([&last](uint64_t done, uint64_t) { last = done; });
+        progress.reset(i % 2 ? 3 : 0);
+        progress.report(3);
+        progress.finish();
+        std::cout.rdbuf(coutBuf);
+        ASSERT_EQ(last, 3U) << i;
+        ASSERT_EQ(text.str().find("\r3"), 0U) << i;
+        ASSERT_EQ(text.str().back(), '\n') << i;
+    }
+}
+
+TEST(zimfilechecks, timings)
+{
+    Timings timings;
+    {
+        PhaseTimer timer(&timings, Phase::DECOMPRESSION, 100);
+        timer.addEntries(2);
+    }
+    {
+        PhaseTimer timer(nullptr, Phase::LOOKUP, 100, 1);
+    }
+    Timings other;
+    other.add(Phase::DECOMPRESSION, 1000, 50, 1);
+    other.add(Phase::LOOKUP, 2000);
+    timings.merge(other);
+
+    const PhaseStats& decompression = timings.get(Phase::DECOMPRESSION);
+    ASSERT_EQ(decompression.calls, 2U);
+    ASSERT_EQ(decompression.bytes, 150U);
+    ASSERT_EQ(decompression.entries, 3U);
+    ASSERT_GE(decompression.nanoseconds, 1000U);
+    ASSERT_EQ(timings.get(Phase::LOOKUP).calls, 1U);
+    ASSERT_EQ(timings.get(Phase::LOOKUP).nanoseconds, 2000U);
+    ASSERT_EQ(timings.get(Phase::MIME).calls, 0U);
+
+    // Only the phases run are written.
+    std::ostringstream json;
+    other.writeJson(json);
+    ASSERT_EQ(json.str(),
+        "[{\"phase\":\"decompression\",\"nanoseconds\":1000,\"bytes\":50,\"entries\":1,\"calls\":1,\"mb_per_s\":47.6837}"
+        ",{\"phase\":\"lookup\",\"nanoseconds\":2000,\"bytes\":0,\"entries\":0,\"calls\":1,\"mb_per_s\":0}]");
+}
+
+TEST(zimfilechecks, md5)
+{
+    const auto md5 = [](const std::string& data, size_t step) {
+        Md5 hash;
+        for (size_t i = 0; i < data.size(); i += step) {
+            hash.update(data.data() + i, std::min(step, data.size() - i));
+        }
+        unsigned char digest[16];
+        hash.finish(digest);
+        return toHex(digest, 16);
+    };
+    ASSERT_EQ(md5("", 1), "d41d8cd98f00b204e9800998ecf8427e");
+    ASSERT_EQ(md5("abc", 1), "900150983cd24fb0d6963f7d28e17f72");
+    const std::string digits = "12345678901234567890123456789012345678901234567890123456789012345678901234567890";
+    for (size_t step : {1, 7, 64, 100}) {
+        ASSERT_EQ(md5(digits, step), "57edf4a22be3c955ac49da2e2107b67a");
+    }
+}
+
+TEST(zimfilechecks, file_checksum)
+{
+    std::string fn = "data/zimfiles/wikibooks_be_all_nopic_2017-02.zim";
+
+    const FileChecksum checksum = computeFileChecksum(fn);
+    ASSERT_TRUE(checksum.isValid());
+    ASSERT_EQ(checksum.stored, "2fb62a7110deffd3b192d922dffa02c1");
+    ASSERT_EQ(checksum.bytes, 152849U);
+
+    ASSERT_THROW(computeFileChecksum("data/zimfiles/missing.zim"), std::runtime_error);
+}